@@ -0,0 +1,208 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/// Micro benchmark of the per ACK path of one session, composed at runtime and at compile time.
+/// usage: ackpathbench [acks] [rounds]
+/// Each case drives one session on a SimClock through a bottleneck of 10 pieces per ms and a 10ms RTT: every
+/// received piece is acked into the session and the requests it releases are sent at once. The runtime case
+/// reaches the algorithm through a CongestionCtlAlgo pointer (DynamicCongestionCtl), the static one is the
+/// BasicSessionStreamController MakeSessionStreamController() builds. Both take the same virtual entry call.
+/// Build with -DCMAKE_BUILD_TYPE=Release to get meaningful numbers.
+
+#include "spdlog/spdlog.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include "demotransportcontroller.hpp"
+#include "utils/simclock.hpp"
+#include "utils/tscclock.hpp"
+
+namespace
+{
+    const Duration kBaseRtt = Duration::FromMilliseconds(10);
+    const Duration kServiceTime = Duration::FromMicroseconds(100);
+
+    /// the requests are not sent anywhere, the bench feeds the session the pieces itself
+    class NullStreamHandler : public SessionStreamCtlHandler
+    {
+    public:
+        void OnPiecePktTimeout(const basefw::ID& peerid, const std::vector<int32_t>& spns) override
+        {
+        }
+
+        bool DoSendDataRequest(const basefw::ID& peerid, const std::vector<int32_t>& spns) override
+        {
+            return true;
+        }
+    };
+
+    struct PendingPiece
+    {
+        SeqNumber seq;
+        DataNumber piece;
+        Timepoint recvtic;
+    };
+
+    class AckPathDriver
+    {
+    public:
+        AckPathDriver(SessionStreamController& session, SimClock& clock)
+                : m_session(session), m_clock(clock)
+        {
+        }
+
+        /// delivers acks pieces, returns the number of requests sent meanwhile
+        uint64_t Run(uint64_t acks)
+        {
+            uint64_t sent = 0;
+            for (uint64_t i = 0; i < acks; ++i)
+            {
+                if (m_pending.empty())
+                {
+                    sent += SendRequests(1);
+                }
+                PendingPiece next = m_pending.front();
+                m_pending.pop_front();
+                m_clock.AdvanceTo(next.recvtic);
+                ScopedEventTime eventTime;
+                m_session.OnDataPktReceived(next.seq, next.piece, next.recvtic);
+                sent += SendRequests(m_session.CanRequestPktCnt());
+            }
+            return sent;
+        }
+
+    private:
+        uint64_t SendRequests(uint32_t cnt)
+        {
+            if (cnt == 0)
+            {
+                return 0;
+            }
+            Timepoint now = EventClock::Now();
+            std::vector<SeqNumber> seqs;
+            std::vector<DataNumber> pieces;
+            for (uint32_t i = 0; i < cnt; ++i)
+            {
+                // the bottleneck serves one piece per kServiceTime
+                Timepoint arrival = now + kBaseRtt;
+                if (m_lastRecvtic.IsInitialized())
+                {
+                    arrival = std::max(arrival, m_lastRecvtic + kServiceTime);
+                }
+                m_lastRecvtic = arrival;
+                seqs.push_back(m_nextSeq);
+                pieces.push_back(m_nextPiece);
+                m_pending.push_back({ m_nextSeq++, m_nextPiece++, arrival });
+            }
+            m_session.OnDataRequestPktSent(seqs, pieces, now);
+            return cnt;
+        }
+
+        SessionStreamController& m_session;
+        SimClock& m_clock;
+        std::deque<PendingPiece> m_pending;
+        SeqNumber m_nextSeq{ 1 };
+        DataNumber m_nextPiece{ 0 };
+        Timepoint m_lastRecvtic{ Timepoint::Zero() };
+    };
+
+    uint64_t ThreadCpuNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    struct CaseResult
+    {
+        double nsPerAck{ 0 };
+        double requestsPerAck{ 0 };
+    };
+
+    /// CPU ns per ack of one session
+    CaseResult RunCase(const std::shared_ptr<SessionStreamController>& session, uint64_t acks)
+    {
+        SimClock clock;
+        ScopedClockOverride clockOverride(&clock);
+        auto handler = std::make_shared<NullStreamHandler>();
+        session->StartSessionStreamCtl(basefw::ID("00000000000000000000000000000001"), handler);
+        AckPathDriver driver(*session, clock);
+        // warm up, slow start is over and the containers have grown
+        driver.Run(acks / 10);
+        uint64_t start = ThreadCpuNs();
+        uint64_t sent = driver.Run(acks);
+        uint64_t end = ThreadCpuNs();
+        session->StopSessionStreamCtl();
+        CaseResult result;
+        result.nsPerAck = double(end - start) / double(acks);
+        result.requestsPerAck = double(sent) / acks;
+        return result;
+    }
+
+    void PrintCase(const std::string& name, const CaseResult& result, double ticksPerNs)
+    {
+        printf("%-24s %10.1f ns/ack %10.0f ticks/ack %8.3f requests/ack\n", name.c_str(), result.nsPerAck,
+                result.nsPerAck * ticksPerNs, result.requestsPerAck);
+    }
+
+    /// the two compositions take turns, the best of the rounds is kept to leave out the noise of the machine
+    void Compare(const char* ccName, CongestionCtlType type, uint64_t acks, uint32_t rounds, double ticksPerNs)
+    {
+        CongestionCtlConfig ccConfig;
+        ccConfig.type = type;
+        ccConfig.coupled.group = std::make_shared<CoupledCongestionGroup>();
+        CaseResult before;
+        CaseResult after;
+        for (uint32_t i = 0; i < rounds; ++i)
+        {
+            auto runtime = RunCase(
+                    std::make_shared<BasicSessionStreamController<DynamicCongestionCtl>>(ccConfig.pacer, ccConfig),
+                    acks);
+            auto composed = RunCase(MakeSessionStreamController(ccConfig), acks);
+            if (i == 0 || runtime.nsPerAck < before.nsPerAck)
+            {
+                before = runtime;
+            }
+            if (i == 0 || composed.nsPerAck < after.nsPerAck)
+            {
+                after = composed;
+            }
+        }
+        PrintCase(std::string(ccName) + " runtime", before, ticksPerNs);
+        PrintCase(std::string(ccName) + " static", after, ticksPerNs);
+        printf("%-24s %10.2fx\n", "speed up", after.nsPerAck > 0 ? before.nsPerAck / after.nsPerAck : 0);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t acks = 2 * 1000 * 1000;
+    if (argc > 1)
+    {
+        acks = std::strtoull(argv[1], nullptr, 10);
+    }
+    uint32_t rounds = 5;
+    if (argc > 2)
+    {
+        rounds = uint32_t(std::strtoul(argv[2], nullptr, 10));
+    }
+    auto logger = spdlog::stdout_color_mt("ackpathlogger");
+    logger->set_level(spdlog::level::off);
+    spdlog::set_default_logger(logger);
+
+    // TSC ticks count cycles at the nominal frequency
+    TscClock* tscClock = TscClock::GetClock();
+    double ticksPerNs = tscClock->IsTscEnabled() ? tscClock->TicksPerMicrosecond() / 1000.0 : 0;
+    printf("acks: %llu, rounds: %u, tsc enabled: %d\n", (unsigned long long) acks, rounds,
+            tscClock->IsTscEnabled());
+
+    Compare("reno", CongestionCtlType::reno, acks, rounds, ticksPerNs);
+    Compare("cubic", CongestionCtlType::cubic, acks, rounds, ticksPerNs);
+    Compare("bbr2", CongestionCtlType::bbr2, acks, rounds, ticksPerNs);
+    Compare("ours", CongestionCtlType::ours, acks, rounds, ticksPerNs);
+    return 0;
+}
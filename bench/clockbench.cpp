@@ -0,0 +1,105 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/// Micro benchmark of the time sources used on the per packet path.
+/// usage: clockbench [iterations]
+/// Build with -DCMAKE_BUILD_TYPE=Release to get meaningful numbers.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include "demo/utils/eventclock.hpp"
+#include "demo/utils/tscclock.hpp"
+
+namespace
+{
+    volatile int64_t g_sink = 0;
+
+    double RunCase(const char* name, uint64_t iterations, const std::function<int64_t()>& fn)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int64_t acc = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            acc += fn();
+        }
+        auto end = std::chrono::steady_clock::now();
+        g_sink = acc;
+        double nsPerOp = std::chrono::duration<double, std::nano>(end - start).count() / double(iterations);
+        printf("%-48s %10.2f ns/op\n", name, nsPerOp);
+        return nsPerOp;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t iterations = 10 * 1000 * 1000;
+    if (argc > 1)
+    {
+        iterations = std::strtoull(argv[1], nullptr, 10);
+    }
+    printf("iterations: %llu\n", (unsigned long long) iterations);
+
+    QuicClock* defaultClock = DefaultClock::GetClock();
+    TscClock* tscClock = TscClock::GetClock();
+    printf("tsc enabled: %d, ticks/us: %.2f\n", tscClock->IsTscEnabled(), tscClock->TicksPerMicrosecond());
+
+    RunCase("Clock::GetClock()->Now()", iterations, []()
+    {
+        return Clock::GetClock()->Now().ToDebuggingValue();
+    });
+    RunCase("DefaultClock::ApproximateNow()", iterations, [defaultClock]()
+    {
+        return defaultClock->ApproximateNow().ToDebuggingValue();
+    });
+    RunCase("TscClock::Now()", iterations, [tscClock]()
+    {
+        return tscClock->Now().ToDebuggingValue();
+    });
+    RunCase("Clock::GetClock()->CreateTimeFromMicroseconds()", iterations, []()
+    {
+        return Clock::GetClock()->CreateTimeFromMicroseconds(12345).ToDebuggingValue();
+    });
+    RunCase("EventClock::FromMicroseconds()", iterations, []()
+    {
+        return EventClock::FromMicroseconds(12345).ToDebuggingValue();
+    });
+    {
+        ScopedEventTime eventTime;
+        RunCase("EventClock::Now() inside an event scope", iterations, []()
+        {
+            return EventClock::Now().ToDebuggingValue();
+        });
+    }
+
+    /// One received piece: a tic_us conversion plus the Now() calls of the RTT update and the alarm check
+    printf("\nper received piece:\n");
+    double before = RunCase("old path: 1 conversion + 2 x Now()", iterations, []()
+    {
+        auto recvtic = Clock::GetClock()->CreateTimeFromMicroseconds(12345);
+        auto rttNow = Clock::GetClock()->Now();
+        auto alarmNow = Clock::GetClock()->Now();
+        return recvtic.ToDebuggingValue() + rttNow.ToDebuggingValue() + alarmNow.ToDebuggingValue();
+    });
+    double after = RunCase("new path: scoped event time, cached reads", iterations, []()
+    {
+        ScopedEventTime eventTime;
+        auto recvtic = EventClock::FromMicroseconds(12345);
+        auto rttNow = EventClock::Now();
+        auto alarmNow = EventClock::Now();
+        return recvtic.ToDebuggingValue() + rttNow.ToDebuggingValue() + alarmNow.ToDebuggingValue();
+    });
+    {
+        ScopedClockOverride tsc(tscClock);
+        RunCase("new path with TscClock installed", iterations, []()
+        {
+            ScopedEventTime eventTime;
+            auto recvtic = EventClock::FromMicroseconds(12345);
+            auto rttNow = EventClock::Now();
+            auto alarmNow = EventClock::Now();
+            return recvtic.ToDebuggingValue() + rttNow.ToDebuggingValue() + alarmNow.ToDebuggingValue();
+        });
+    }
+    printf("speed up: %.2fx\n", after > 0 ? before / after : 0);
+    return 0;
+}
@@ -0,0 +1,585 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/// Stress test of DemoTransportCtl with many controllers and many sessions per controller.
+/// usage: stressbench [--controllers 1,10,100] [--sessions 2,8,32] [--events n] [--rate events/s]
+///                    [--threads n] [--loss 0.01] [--alarm-ratio 0.01] [--seed 1]
+/// Every (controllers, sessions) pair is one run: the controllers are dealt to the threads, each thread pushes
+/// randomized receive, send and alarm events into its controllers on a SimClock ticking --rate times per second
+/// per controller, and the run reports the CPU cost per event type, heap allocations and memory per controller.
+/// Build with -DCMAKE_BUILD_TYPE=Release to get meaningful numbers.
+
+#include "spdlog/spdlog.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <malloc.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "demotransportcontroller.hpp"
+
+namespace
+{
+    /// heap accounting, the demo allocates on almost every event so allocations per event expose the copies
+    std::atomic<uint64_t> g_allocCalls{ 0 };
+    std::atomic<int64_t> g_liveBytes{ 0 };
+}
+
+void* operator new(size_t size)
+{
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    g_allocCalls.fetch_add(1, std::memory_order_relaxed);
+    g_liveBytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed);
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr)
+    {
+        g_liveBytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+        free(ptr);
+    }
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    operator delete(ptr);
+}
+
+namespace
+{
+    enum EventType
+    {
+        kReceive = 0,
+        kSend,
+        kAlarm,
+        kEventTypes
+    };
+
+    const char* const kEventNames[kEventTypes] = { "receive", "send", "alarm" };
+
+    struct StressOptions
+    {
+        std::vector<uint32_t> controllers{ 1, 10, 100 };
+        std::vector<uint32_t> sessions{ 2, 8, 32 };
+        uint64_t events{ 2000000 };/** per run, over all controllers*/
+        double rate{ 2000 };/** event ticks per second of simulated time, per controller*/
+        uint32_t threads{ 1 };
+        double loss{ 0.01 };/** requested pieces that never come back*/
+        double alarmRatio{ 0.01 };
+        uint64_t seed{ 1 };
+    };
+
+    struct EventStats
+    {
+        uint64_t count[kEventTypes]{};
+        uint64_t ns[kEventTypes]{};
+        uint64_t allocs[kEventTypes]{};
+        uint64_t idle{ 0 };/** ticks where the picked controller had nothing to do*/
+        uint64_t cpuNs{ 0 };
+
+        void Merge(const EventStats& other)
+        {
+            for (int i = 0; i < kEventTypes; ++i)
+            {
+                count[i] += other.count[i];
+                ns[i] += other.ns[i];
+                allocs[i] += other.allocs[i];
+            }
+            idle += other.idle;
+            cpuNs += other.cpuNs;
+        }
+
+        uint64_t Total() const
+        {
+            return count[kReceive] + count[kSend] + count[kAlarm];
+        }
+    };
+
+    uint64_t ThreadCpuNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    uint64_t MonotonicNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+    }
+
+    /// resident set size now, in bytes
+    uint64_t CurrentRss()
+    {
+        std::ifstream statm("/proc/self/statm");
+        uint64_t size = 0, resident = 0;
+        statm >> size >> resident;
+        return resident * uint64_t(sysconf(_SC_PAGESIZE));
+    }
+
+    uint64_t PeakRss()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return uint64_t(usage.ru_maxrss) * 1024;
+    }
+
+    std::vector<uint32_t> ParseList(const std::string& value)
+    {
+        std::vector<uint32_t> list;
+        std::stringstream in(value);
+        std::string item;
+        while (std::getline(in, item, ','))
+        {
+            list.push_back(std::stoul(item));
+        }
+        return list;
+    }
+
+    std::string MakePeerId(uint32_t controller, uint32_t session)
+    {
+        char buf[48];
+        snprintf(buf, sizeof(buf), "%032x%08x", controller + 1, session + 1);
+        return buf;
+    }
+
+    /** @brief The SDK side of one download task: answers the controller's callbacks without any network.
+     *  Every session gets a fixed RTT, each sent piece comes back after that RTT plus a random jitter, so pieces
+     *  arrive reordered, and a --loss share of them never comes back. The task list never runs dry.
+     *  Like the SDK, nothing is called back into the controller from inside one of its callbacks.
+     * */
+    class StressTask : public MPDTransCtlHandler,
+                       public std::enable_shared_from_this<StressTask>
+    {
+    public:
+        struct Piece
+        {
+            uint64_t dueUs;
+            fw::ID session;
+            uint32_t seq;
+            int32_t piece;
+
+            bool operator>(const Piece& other) const
+            {
+                return dueUs > other.dueUs;
+            }
+        };
+
+        struct Request
+        {
+            fw::ID session;
+            std::vector<int32_t> pieces;
+        };
+
+        bool DoSendDataRequest(const fw::ID& sessionid, const std::vector<int32_t>& datapieces) override
+        {
+            m_requests.push_back(Request{ sessionid, datapieces });
+            return true;
+        }
+
+        bool DoRequestDatapiecesTask(uint32_t piecesnum) override
+        {
+            // the application layer hands out what it has buffered, never an unbounded batch
+            piecesnum = std::min(piecesnum, kMaxTaskBatch);
+            for (uint32_t i = 0; i < piecesnum; ++i)
+            {
+                m_newPieces.push_back(m_nextPiece++);
+            }
+            return true;
+        }
+
+        void Start(const std::shared_ptr<DemoTransportCtlConfig>& config, uint32_t index, uint32_t sessionNum,
+                std::mt19937_64& rng)
+        {
+            m_controller = DemoTransportCtlFactory().MakeTransportController(config);
+            TransportDownloadTaskInfo taskInfo;
+            taskInfo.m_filelength = uint64_t(1) << 40;
+            taskInfo.m_byterate = 1024 * 1024 / 8;
+            m_controller->StartTransportController(taskInfo, shared_from_this());
+            std::uniform_int_distribution<uint64_t> rtt(20000, 100000);
+            for (uint32_t i = 0; i < sessionNum; ++i)
+            {
+                fw::ID sessionId(MakePeerId(index, i));
+                m_sessionRttUs[sessionId] = rtt(rng);
+                m_controller->OnSessionCreate(sessionId);
+            }
+            m_controller->OnDownloadTaskStart();
+            DeliverNewPieces();
+        }
+
+        void Stop()
+        {
+            m_controller->OnDownloadTaskStop();
+        }
+
+        bool HasRequests() const
+        {
+            return !m_requests.empty();
+        }
+
+        bool HasArrivals(uint64_t nowUs) const
+        {
+            return !m_inflight.empty() && m_inflight.top().dueUs <= nowUs;
+        }
+
+        /// push one event into the controller, only the controller's own work is timed
+        void Step(EventType type, uint64_t nowUs, std::mt19937_64& rng, double loss, EventStats& stats)
+        {
+            uint64_t allocStart = g_allocCalls.load(std::memory_order_relaxed);
+            uint64_t start = 0;
+            switch (type)
+            {
+                case kReceive:
+                {
+                    Piece piece = m_inflight.top();
+                    m_inflight.pop();
+                    start = MonotonicNs();
+                    m_controller->OnDataPiecesReceived(piece.session, piece.seq, piece.piece, nowUs);
+                    break;
+                }
+                case kSend:
+                {
+                    Request request = std::move(m_requests.front());
+                    m_requests.pop_front();
+                    uint64_t rttUs = m_sessionRttUs[request.session];
+                    std::uniform_int_distribution<uint64_t> jitter(0, rttUs / 4);
+                    std::vector<uint32_t> seqs;
+                    for (auto piece: request.pieces)
+                    {
+                        seqs.push_back(m_nextSeq);
+                        if (std::uniform_real_distribution<double>(0, 1)(rng) >= loss)
+                        {
+                            m_inflight.push(Piece{ nowUs + rttUs + jitter(rng), request.session, m_nextSeq, piece });
+                        }
+                        ++m_nextSeq;
+                    }
+                    allocStart = g_allocCalls.load(std::memory_order_relaxed);
+                    start = MonotonicNs();
+                    m_controller->OnDataSent(request.session, request.pieces, seqs, nowUs);
+                    break;
+                }
+                default:
+                    start = MonotonicNs();
+                    m_controller->OnLossDetectionAlarm();
+                    break;
+            }
+            DeliverNewPieces();
+            stats.ns[type] += MonotonicNs() - start;
+            stats.allocs[type] += g_allocCalls.load(std::memory_order_relaxed) - allocStart;
+            ++stats.count[type];
+        }
+
+    private:
+        static constexpr uint32_t kMaxTaskBatch = 1024;
+
+        void DeliverNewPieces()
+        {
+            if (!m_newPieces.empty())
+            {
+                std::vector<int32_t> pieces;
+                pieces.swap(m_newPieces);
+                m_controller->OnPieceTaskAdding(pieces);
+            }
+        }
+
+        std::shared_ptr<MPDTransportController> m_controller;
+        std::map<fw::ID, uint64_t> m_sessionRttUs;
+        std::deque<Request> m_requests;/** requests not yet reported as sent*/
+        std::priority_queue<Piece, std::vector<Piece>, std::greater<Piece>> m_inflight;/** by arrival time*/
+        std::vector<int32_t> m_newPieces;
+        int32_t m_nextPiece{ 0 };
+        uint32_t m_nextSeq{ 0 };
+    };
+
+    constexpr uint32_t StressTask::kMaxTaskBatch;
+
+    struct RunResult
+    {
+        uint32_t controllers;
+        uint32_t sessions;
+        EventStats stats;
+        int64_t setupHeapPerController;/** live heap once the sessions are created, bytes*/
+        int64_t heapPerController;/** live heap after the run, bytes*/
+        int64_t rssPerController;
+    };
+
+    /** drive the tasks of one thread until it has pushed its share of events.
+     *  The clock ticks --rate times per second per controller, every tick picks a random controller and pushes
+     *  an alarm with --alarm-ratio probability, else a due arrival or a pending send, whichever the dice says;
+     *  a tick that finds nothing to do is idle.
+     * */
+    EventStats DriveTasks(std::vector<std::shared_ptr<StressTask>>& tasks, SimClock& clock, uint64_t events,
+            const StressOptions& options, std::mt19937_64& rng)
+    {
+        std::uniform_int_distribution<size_t> pickTask(0, tasks.size() - 1);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        auto step = Duration::FromMicroseconds(std::max<int64_t>(int64_t(1e6 / options.rate / tasks.size()), 1));
+        EventStats stats;
+        uint64_t cpuStart = ThreadCpuNs();
+        // stalled controllers only move on alarms, give up rather than spin if there are none
+        while (stats.Total() < events && stats.idle < 100 * events)
+        {
+            clock.AdvanceTime(step);
+            auto& task = tasks[pickTask(rng)];
+            uint64_t nowUs = clock.NowMicroseconds();
+            double dice = uniform(rng);
+            if (dice < options.alarmRatio)
+            {
+                task->Step(kAlarm, nowUs, rng, options.loss, stats);
+            }
+            else if (task->HasRequests() && (dice < 0.5 || !task->HasArrivals(nowUs)))
+            {
+                task->Step(kSend, nowUs, rng, options.loss, stats);
+            }
+            else if (task->HasArrivals(nowUs))
+            {
+                task->Step(kReceive, nowUs, rng, options.loss, stats);
+            }
+            else
+            {
+                ++stats.idle;
+            }
+        }
+        stats.cpuNs = ThreadCpuNs() - cpuStart;
+        return stats;
+    }
+
+    RunResult RunOnce(uint32_t controllerNum, uint32_t sessionNum, const StressOptions& options)
+    {
+        RunResult result{ controllerNum, sessionNum, EventStats(), 0, 0, 0 };
+        uint32_t threadNum = std::max<uint32_t>(1, std::min(options.threads, controllerNum));
+        auto config = std::make_shared<DemoTransportCtlConfig>();
+        malloc_trim(0);
+        int64_t heapStart = g_liveBytes.load();
+        int64_t rssStart = CurrentRss();
+
+        // every thread creates, drives and stops its own controllers, they never move between threads
+        std::vector<std::vector<std::shared_ptr<StressTask>>> tasks(threadNum);
+        for (uint32_t i = 0; i < controllerNum; ++i)
+        {
+            tasks[i % threadNum].push_back(std::make_shared<StressTask>());
+        }
+        std::vector<EventStats> stats(threadNum);
+        std::vector<std::thread> threads;
+        std::atomic<uint32_t> started{ 0 };
+        std::atomic<bool> go{ false };
+        for (uint32_t t = 0; t < threadNum; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                SimClock clock;
+                ScopedClockOverride clockOverride(&clock);
+                std::mt19937_64 rng(options.seed * 1000 + t);
+                for (size_t i = 0; i < tasks[t].size(); ++i)
+                {
+                    tasks[t][i]->Start(config, uint32_t(i * threadNum + t), sessionNum, rng);
+                }
+                ++started;
+                while (!go)
+                {
+                    std::this_thread::yield();
+                }
+                uint64_t share = options.events / threadNum + (t < options.events % threadNum);
+                stats[t] = DriveTasks(tasks[t], clock, share, options, rng);
+            });
+        }
+        while (started < threadNum)
+        {
+            std::this_thread::yield();
+        }
+        result.setupHeapPerController = (g_liveBytes.load() - heapStart) / controllerNum;
+        go = true;
+        for (auto& thread: threads)
+        {
+            thread.join();
+        }
+        for (const auto& threadStats: stats)
+        {
+            result.stats.Merge(threadStats);
+        }
+        // measured before the controllers go away, so what piled up during the run counts
+        result.heapPerController = (g_liveBytes.load() - heapStart) / controllerNum;
+        result.rssPerController = (int64_t(CurrentRss()) - rssStart) / controllerNum;
+        for (auto& threadTasks: tasks)
+        {
+            for (auto& task: threadTasks)
+            {
+                // the controllers were driven on SimClocks, stopping them reads no time
+                task->Stop();
+            }
+        }
+        return result;
+    }
+
+    void PrintUsage()
+    {
+        std::cerr << "usage: stressbench [--controllers n1,n2...] [--sessions m1,m2...] [--events n] [--rate events/s]"
+                     " [--threads n] [--loss ratio] [--alarm-ratio ratio] [--seed n]" << std::endl;
+    }
+
+    /// slope of log(cost) over log(x) by least squares, 1 is linear in x, 0 is flat
+    double ScalingExponent(const std::vector<double>& xs, const std::vector<double>& costs)
+    {
+        double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (size_t i = 0; i < xs.size(); ++i)
+        {
+            if (xs[i] <= 0 || costs[i] <= 0)
+            {
+                continue;
+            }
+            double x = std::log(xs[i]);
+            double y = std::log(costs[i]);
+            n += 1;
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        double denom = n * sxx - sx * sx;
+        return n > 1 && denom != 0 ? (n * sxy - sx * sy) / denom : 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    StressOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (i + 1 >= argc)
+        {
+            PrintUsage();
+            return -1;
+        }
+        std::string value(argv[++i]);
+        if (arg == "--controllers")
+        {
+            options.controllers = ParseList(value);
+        }
+        else if (arg == "--sessions")
+        {
+            options.sessions = ParseList(value);
+        }
+        else if (arg == "--events")
+        {
+            options.events = std::stoull(value);
+        }
+        else if (arg == "--rate")
+        {
+            options.rate = std::stod(value);
+        }
+        else if (arg == "--threads")
+        {
+            options.threads = std::stoul(value);
+        }
+        else if (arg == "--loss")
+        {
+            options.loss = std::stod(value);
+        }
+        else if (arg == "--alarm-ratio")
+        {
+            options.alarmRatio = std::stod(value);
+        }
+        else if (arg == "--seed")
+        {
+            options.seed = std::stoull(value);
+        }
+        else
+        {
+            PrintUsage();
+            return -1;
+        }
+    }
+    if (options.controllers.empty() || options.sessions.empty() || options.rate <= 0
+        || std::count(options.controllers.begin(), options.controllers.end(), 0U)
+        || std::count(options.sessions.begin(), options.sessions.end(), 0U))
+    {
+        PrintUsage();
+        return -1;
+    }
+
+    // the demo logs every added task at error level
+    auto logger = spdlog::stdout_color_mt("stresslogger");
+    logger->set_level(spdlog::level::off);
+    spdlog::set_default_logger(logger);
+
+    printf("events/run: %llu, rate: %.0f events/s, threads: %u, loss: %.3f, alarm ratio: %.3f\n",
+            (unsigned long long) options.events, options.rate, options.threads, options.loss, options.alarmRatio);
+    printf("%6s %6s %12s %6s %10s %10s %10s %10s %10s %10s %12s %12s\n", "ctls", "sess", "events/s/cpu", "idle",
+            "ns/recv", "ns/send", "ns/alarm", "alloc/recv", "alloc/alrm", "setup KB", "heap/ctl KB", "rss/ctl KB");
+    std::vector<RunResult> results;
+    for (auto controllerNum: options.controllers)
+    {
+        for (auto sessionNum: options.sessions)
+        {
+            auto result = RunOnce(controllerNum, sessionNum, options);
+            const auto& stats = result.stats;
+            auto perEvent = [](uint64_t total, uint64_t count)
+            {
+                return count ? double(total) / count : 0.0;
+            };
+            printf("%6u %6u %12.0f %5.0f%% %10.0f %10.0f %10.0f %10.1f %10.1f %10.1f %12.1f %12.1f\n", controllerNum,
+                    sessionNum, stats.cpuNs ? stats.Total() * 1e9 / stats.cpuNs : 0.0,
+                    100.0 * stats.idle / std::max<uint64_t>(stats.idle + stats.Total(), 1),
+                    perEvent(stats.ns[kReceive], stats.count[kReceive]),
+                    perEvent(stats.ns[kSend], stats.count[kSend]),
+                    perEvent(stats.ns[kAlarm], stats.count[kAlarm]),
+                    perEvent(stats.allocs[kReceive], stats.count[kReceive]),
+                    perEvent(stats.allocs[kAlarm], stats.count[kAlarm]),
+                    result.setupHeapPerController / 1024.0, result.heapPerController / 1024.0, result.rssPerController / 1024.0);
+            fflush(stdout);
+            results.push_back(result);
+        }
+    }
+    printf("peak rss: %.1f MB\n", PeakRss() / 1024.0 / 1024.0);
+
+    // how the cost of one event grows with the sessions of its controller, per controller count
+    if (options.sessions.size() > 1)
+    {
+        printf("\ncost growth with sessions per controller (exponent of M, 0 flat, 1 linear):\n");
+        for (size_t c = 0; c < options.controllers.size(); ++c)
+        {
+            printf("  %u controllers:", options.controllers[c]);
+            for (int type = 0; type < kEventTypes; ++type)
+            {
+                std::vector<double> xs, costs;
+                for (size_t s = 0; s < options.sessions.size(); ++s)
+                {
+                    const auto& stats = results[c * options.sessions.size() + s].stats;
+                    xs.push_back(options.sessions[s]);
+                    costs.push_back(stats.count[type] ? double(stats.ns[type]) / stats.count[type] : 0);
+                }
+                printf(" %s %.2f", kEventNames[type], ScalingExponent(xs, costs));
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,505 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include "congestioncontrol.hpp"
+
+/// config of Bbr2CongestionControl, windows are in packets
+struct Bbr2CongestionCtlConfig
+{
+    uint32_t init_cwnd{ 10 };
+    uint32_t min_cwnd{ 4 };
+    uint32_t max_cwnd{ 2000 };
+    uint32_t max_burst{ 8 };/** packets requested at once, the pacer spreads the requests*/
+    double startup_cwnd_gain{ 2.0 };/** STARTUP grows the window like slow start up to this times BDP*/
+    double cruise_cwnd_gain{ 1.0 };
+    double probe_up_cwnd_gain{ 1.25 };
+    double probe_down_cwnd_gain{ 0.9 };
+    double probe_rtt_cwnd_gain{ 0.5 };
+    double startup_pacing_gain{ 2.77 };/** 2/ln2, the rate doubles each round*/
+    double drain_pacing_gain{ 0.35 };/** the inverse of the STARTUP gain, the queue drains in about one round*/
+    double probe_up_pacing_gain{ 1.25 };
+    double probe_down_pacing_gain{ 0.9 };
+    double loss_thresh{ 0.02 };/** loss rate of a round above which losses are congestive, 1% random loss is not*/
+    uint32_t loss_min_cnt{ 3 };/** fewer losses in a round are never congestive, small BDPs make the rate noisy*/
+    double beta{ 0.7 };/** cut of the inflight bounds on congestive loss*/
+    double headroom{ 0.15 };/** share of inflight_hi left free in CRUISE*/
+    uint32_t full_bw_rounds{ 3 };/** STARTUP ends after this many rounds without 25% bandwidth growth*/
+    uint32_t full_loss_cnt{ 6 };/** STARTUP also ends on this many losses in a lossy round*/
+    uint32_t bw_window_rounds{ 10 };/** the max bandwidth filter spans this many rounds*/
+    uint32_t probe_rtt_interval_ms{ 5000 };/** min RTT older than this triggers PROBE_RTT*/
+    uint32_t probe_rtt_duration_ms{ 200 };
+    uint32_t probe_bw_wait_min_ms{ 2000 };/** CRUISE lasts a random time in [min, max] before probing up*/
+    uint32_t probe_bw_wait_max_ms{ 3000 };
+    uint32_t probe_bw_max_rounds{ 63 };/** probe at least every this many rounds, for high BDP paths*/
+};
+
+/** @brief BBRv2 style model based congestion control on a window only transport.
+ *  The model is a windowed max of the delivery rate samples (btlBw) and an expiring min RTT, their product is
+ *  the BDP. STARTUP grows the window until the bandwidth stops growing or the losses of a round are above
+ *  loss_thresh, DRAIN lets the queue built by STARTUP go, PROBE_BW cycles DOWN, CRUISE, REFILL and UP to find
+ *  more bandwidth, and PROBE_RTT shrinks the window for a moment to refresh the min RTT.
+ *  Losses only bound the window when the loss rate of a round is above loss_thresh: inflight_hi caps the
+ *  probing, inflight_lo cuts the window for the rest of the cycle. Random loss below the threshold is ignored.
+ *  The gains act on the window and on the pacing rate, which is the max bandwidth times the gain of the mode.
+ * */
+class Bbr2CongestionControl final : public WindowCongestionCtlAlgo
+{
+public:
+    enum class Mode : uint8_t
+    {
+        startup,
+        drain,
+        probeBwDown,
+        probeBwCruise,
+        probeBwRefill,
+        probeBwUp,
+        probeRtt
+    };
+
+    explicit Bbr2CongestionControl(const Bbr2CongestionCtlConfig& ccConfig)
+            : WindowCongestionCtlAlgo(ccConfig.init_cwnd, ccConfig.max_burst), m_config(ccConfig),
+              m_maxBw(ccConfig.bw_window_rounds, 0, 0)
+    {
+        SPDLOG_DEBUG("init_cwnd:{}, loss_thresh:{}, bw_window_rounds:{}", ccConfig.init_cwnd, ccConfig.loss_thresh,
+                ccConfig.bw_window_rounds);
+    }
+
+    ~Bbr2CongestionControl() override
+    {
+        SPDLOG_DEBUG("");
+    }
+
+    CongestionCtlType GetCCtype() override
+    {
+        return CongestionCtlType::bbr2;
+    }
+
+    Duration GetRtprop() override
+    {
+        return m_probeRttMin;
+    }
+
+    /// the max bandwidth times the gain of the mode, the window per RTT until there is a model
+    double GetPacingRate() override
+    {
+        if (MaxBw() <= 0)
+        {
+            return WindowPacingRate(m_config.startup_pacing_gain);
+        }
+        return PacingGain() * MaxBw();
+    }
+
+    Mode GetMode() const
+    {
+        return m_mode;
+    }
+
+    /// bandwidth delay product in packets, the initial window until there is a model
+    uint32_t Bdp() const
+    {
+        if (MaxBw() <= 0 || m_probeRttMin.IsInfinite())
+        {
+            return m_config.init_cwnd;
+        }
+        return std::max(uint32_t(std::ceil(MaxBw() * m_probeRttMin.ToMicroseconds() / 1000.0)), m_config.min_cwnd);
+    }
+
+protected:
+    void OnPacketSent(const InflightPacket& sentpkt) override
+    {
+        if (!m_rngSeeded)
+        {
+            // seeded from the first send, so the sessions of one task do not probe in lockstep
+            m_rng.seed(uint32_t(sentpkt.sendtic.ToDebuggingValue()) ^ (sentpkt.seq * 2654435761U));
+            m_rngSeeded = true;
+        }
+    }
+
+    void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) override
+    {
+        Timepoint now = ackEvent.recvtic;
+        bool roundStart = false;
+        if (uint64_t(ackEvent.ackPacket.delivered) >= m_nextRoundDelivered)
+        {
+            m_nextRoundDelivered = m_delivered;
+            ++m_roundCount;
+            roundStart = true;
+        }
+        if (rateSample > 0)
+        {
+            UpdateMaxBw(rateSample);
+        }
+        UpdateMinRtt(rttstats.latest_rtt(), now);
+
+        if (roundStart)
+        {
+            OnRoundStart(now);
+        }
+        ++m_roundDelivered;
+        switch (m_mode)
+        {
+            case Mode::drain:
+                if (m_inflight <= Bdp())
+                {
+                    EnterProbeBwDown(now);
+                }
+                break;
+            case Mode::probeBwDown:
+                if (m_inflight <= TargetCwnd(m_config.probe_down_cwnd_gain))
+                {
+                    EnterProbeBwCruise(now);
+                }
+                break;
+            case Mode::probeBwCruise:
+                if (now >= m_probeWaitUntil || m_roundCount - m_cycleStartRound >= m_config.probe_bw_max_rounds)
+                {
+                    EnterProbeBwRefill();
+                }
+                break;
+            case Mode::probeRtt:
+                CheckProbeRttDone(now);
+                break;
+            default:
+                break;
+        }
+        UpdateCwnd(true);
+    }
+
+    void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) override
+    {
+        m_roundLost += lossEvent.lossPackets.size();
+        uint32_t inflightAtLoss = m_inflight + lossEvent.lossPackets.size();
+        if (IsLossTooHigh())
+        {
+            m_priorInflightHi = m_inflightHi;
+            m_priorInflightLo = m_inflightLo;
+            switch (m_mode)
+            {
+                case Mode::startup:
+                    if (m_roundLost >= m_config.full_loss_cnt)
+                    {
+                        // the pipe is full, the queue overflowed
+                        m_fullBwReached = true;
+                        m_inflightHi = std::max(Bdp(), inflightAtLoss);
+                        EnterDrain();
+                    }
+                    break;
+                case Mode::probeBwUp:
+                    // probed too far, remember where and stop probing
+                    m_inflightHi = std::max(uint32_t(inflightAtLoss * m_config.beta), uint32_t(Bdp() * m_config.beta));
+                    m_inflightHi = std::max(m_inflightHi, m_config.min_cwnd);
+                    EnterProbeBwDown(lossEvent.losttic);
+                    break;
+                default:
+                    if (m_loCutRound != m_roundCount)
+                    {
+                        // one cut per round, a batch of timeouts is one congestion event
+                        m_loCutRound = m_roundCount;
+                        uint32_t base = m_inflightLo == kUnbounded ? m_cwnd : m_inflightLo;
+                        m_inflightLo = std::max(uint32_t(base * m_config.beta), m_config.min_cwnd);
+                    }
+                    break;
+            }
+        }
+        UpdateCwnd(false);
+        SPDLOG_DEBUG("lost:{}, roundLost:{}, roundDelivered:{}, inflight_hi:{}, inflight_lo:{}, cwnd:{}",
+                lossEvent.lossPackets.size(), m_roundLost, m_roundDelivered, m_inflightHi, m_inflightLo, m_cwnd);
+    }
+
+    /// the bounds go back to where they were, the mode the loss moved to ends on its own
+    void UndoCwndReduction(uint32_t priorCwnd) override
+    {
+        m_inflightHi = std::max(m_inflightHi, m_priorInflightHi);
+        m_inflightLo = std::max(m_inflightLo, m_priorInflightLo);
+        m_cwnd = std::max(m_cwnd, priorCwnd);
+        SPDLOG_DEBUG("undo, inflight_hi:{}, inflight_lo:{}, cwnd:{}", m_inflightHi, m_inflightLo, m_cwnd);
+    }
+
+    /// the model of the old path is dropped, STARTUP measures the new one from the current window
+    void OnPathReset() override
+    {
+        m_maxBw.Clear();
+        m_probeRttMin = Duration::Infinite();
+        m_probeRttStamp = Timepoint::Zero();
+        m_fullBwReached = false;
+        m_fullBw = 0;
+        m_fullBwCnt = 0;
+        m_inflightHi = kUnbounded;
+        m_inflightLo = kUnbounded;
+        m_mode = Mode::startup;
+        SPDLOG_DEBUG("path change, enter STARTUP, cwnd:{}", m_cwnd);
+    }
+
+private:
+    static constexpr uint32_t kUnbounded = std::numeric_limits<uint32_t>::max();
+
+    double MaxBw() const
+    {
+        return m_maxBw.GetBest();
+    }
+
+    /// max of the samples of the last bw_window_rounds rounds
+    void UpdateMaxBw(double sample)
+    {
+        m_maxBw.Update(sample, m_roundCount);
+        m_bwEstimate = MaxBw();
+    }
+
+    void UpdateMinRtt(Duration rtt, Timepoint now)
+    {
+        if (rtt <= Duration::Zero())
+        {
+            return;
+        }
+        bool expired = m_probeRttStamp.IsInitialized()
+                       && now > m_probeRttStamp + Duration::FromMilliseconds(m_config.probe_rtt_interval_ms);
+        if (m_probeRttMin.IsInfinite() || rtt <= m_probeRttMin)
+        {
+            m_probeRttMin = rtt;
+            m_probeRttStamp = now;
+        }
+        else if (expired && m_mode != Mode::probeRtt)
+        {
+            EnterProbeRtt();
+        }
+    }
+
+    bool IsLossTooHigh() const
+    {
+        // early in a round few packets are delivered yet, the last full round is the better denominator
+        uint64_t total = m_roundLost + std::max(m_roundDelivered, m_lastRoundDelivered);
+        return m_roundLost >= m_config.loss_min_cnt && double(m_roundLost) / total > m_config.loss_thresh;
+    }
+
+    void OnRoundStart(Timepoint now)
+    {
+        if (m_mode == Mode::startup && !m_fullBwReached)
+        {
+            CheckFullBw();
+            if (m_fullBwReached)
+            {
+                EnterDrain();
+            }
+        }
+        else if (m_mode == Mode::probeBwRefill)
+        {
+            EnterProbeBwUp();
+        }
+        else if (m_mode == Mode::probeBwUp)
+        {
+            // raise the cap only while the window is actually limited by it, the growth doubles per round
+            if (m_inflightHi != kUnbounded && m_inflight + m_config.max_burst >= m_inflightHi)
+            {
+                m_inflightHi += m_probeUpGrowth;
+                m_probeUpGrowth = std::min(m_probeUpGrowth * 2, m_config.max_cwnd);
+            }
+            // a full round at the probing window without bandwidth growth, the pipe is full
+            if (m_inflight >= TargetCwnd(m_config.probe_up_cwnd_gain) && MaxBw() < m_probeUpStartBw * 1.25)
+            {
+                if (++m_probeUpFullRounds >= 2)
+                {
+                    EnterProbeBwDown(now);
+                }
+            }
+        }
+        m_lastRoundDelivered = m_roundDelivered;
+        m_roundLost = 0;
+        m_roundDelivered = 0;
+    }
+
+    void CheckFullBw()
+    {
+        if (MaxBw() >= m_fullBw * 1.25)
+        {
+            m_fullBw = MaxBw();
+            m_fullBwCnt = 0;
+            return;
+        }
+        if (++m_fullBwCnt >= m_config.full_bw_rounds)
+        {
+            m_fullBwReached = true;
+            SPDLOG_DEBUG("full bw reached, bw:{}", m_fullBw);
+        }
+    }
+
+    void EnterDrain()
+    {
+        m_mode = Mode::drain;
+        SPDLOG_DEBUG("enter DRAIN, bdp:{}, inflight:{}", Bdp(), m_inflight);
+    }
+
+    void EnterProbeBwDown(Timepoint now)
+    {
+        m_mode = Mode::probeBwDown;
+        m_cycleStartRound = m_roundCount;
+        std::uniform_int_distribution<uint32_t> wait(m_config.probe_bw_wait_min_ms,
+                std::max(m_config.probe_bw_wait_min_ms, m_config.probe_bw_wait_max_ms));
+        m_probeWaitUntil = now + Duration::FromMilliseconds(wait(m_rng));
+        SPDLOG_DEBUG("enter PROBE_BW_DOWN, bdp:{}, inflight_hi:{}", Bdp(), m_inflightHi);
+    }
+
+    void EnterProbeBwCruise(Timepoint now)
+    {
+        m_mode = Mode::probeBwCruise;
+        if (!m_probeWaitUntil.IsInitialized())
+        {
+            m_probeWaitUntil = now;
+        }
+    }
+
+    void EnterProbeBwRefill()
+    {
+        // the short term bound is from the last cycle, start the probe from the model alone
+        m_mode = Mode::probeBwRefill;
+        m_inflightLo = kUnbounded;
+    }
+
+    void EnterProbeBwUp()
+    {
+        m_mode = Mode::probeBwUp;
+        m_probeUpGrowth = 1;
+        m_probeUpFullRounds = 0;
+        m_probeUpStartBw = MaxBw();
+    }
+
+    void EnterProbeRtt()
+    {
+        m_mode = Mode::probeRtt;
+        m_probeRttDone = Timepoint::Zero();
+        SPDLOG_DEBUG("enter PROBE_RTT, min rtt:{}", m_probeRttMin.ToDebuggingValue());
+    }
+
+    void CheckProbeRttDone(Timepoint now)
+    {
+        if (!m_probeRttDone.IsInitialized())
+        {
+            if (m_inflight <= TargetCwnd(m_config.probe_rtt_cwnd_gain))
+            {
+                m_probeRttDone = now + Duration::FromMilliseconds(m_config.probe_rtt_duration_ms);
+                m_probeRttDoneRound = m_roundCount + 1;
+            }
+            return;
+        }
+        if (now >= m_probeRttDone && m_roundCount >= m_probeRttDoneRound)
+        {
+            // whatever the path showed while drained is the min RTT now
+            m_probeRttStamp = now;
+            if (m_probeRttMin.IsInfinite())
+            {
+                m_probeRttMin = Duration::FromMilliseconds(1);
+            }
+            if (!m_fullBwReached)
+            {
+                m_mode = Mode::startup;
+            }
+            else
+            {
+                EnterProbeBwDown(now);
+                EnterProbeBwCruise(now);
+            }
+            SPDLOG_DEBUG("exit PROBE_RTT, min rtt:{}", m_probeRttMin.ToDebuggingValue());
+        }
+    }
+
+    double PacingGain() const
+    {
+        switch (m_mode)
+        {
+            case Mode::startup:
+                return m_config.startup_pacing_gain;
+            case Mode::drain:
+                return m_config.drain_pacing_gain;
+            case Mode::probeBwDown:
+                return m_config.probe_down_pacing_gain;
+            case Mode::probeBwUp:
+                return m_config.probe_up_pacing_gain;
+            default:
+                return 1.0;
+        }
+    }
+
+    uint32_t TargetCwnd(double gain) const
+    {
+        return std::max(uint32_t(std::ceil(Bdp() * gain)), m_config.min_cwnd);
+    }
+
+    void UpdateCwnd(bool acked)
+    {
+        uint32_t cwnd = m_cwnd;
+        switch (m_mode)
+        {
+            case Mode::startup:
+                // slow start, bounded by the model once there is one
+                if (acked && (MaxBw() <= 0 || cwnd < TargetCwnd(m_config.startup_cwnd_gain)))
+                {
+                    cwnd += 1;
+                }
+                break;
+            case Mode::drain:
+                cwnd = Bdp();
+                break;
+            case Mode::probeBwDown:
+                cwnd = TargetCwnd(m_config.probe_down_cwnd_gain);
+                break;
+            case Mode::probeBwCruise:
+                cwnd = TargetCwnd(m_config.cruise_cwnd_gain);
+                if (m_inflightHi != kUnbounded)
+                {
+                    cwnd = std::min(cwnd, uint32_t(m_inflightHi * (1 - m_config.headroom)));
+                }
+                break;
+            case Mode::probeBwRefill:
+                cwnd = TargetCwnd(1.0);
+                break;
+            case Mode::probeBwUp:
+                cwnd = TargetCwnd(m_config.probe_up_cwnd_gain);
+                break;
+            case Mode::probeRtt:
+                cwnd = TargetCwnd(m_config.probe_rtt_cwnd_gain);
+                break;
+        }
+        if (m_mode != Mode::probeRtt)
+        {
+            cwnd = std::min(cwnd, m_inflightHi);
+            cwnd = std::min(cwnd, m_inflightLo);
+        }
+        m_cwnd = std::max(m_config.min_cwnd, std::min(cwnd, m_config.max_cwnd));
+    }
+
+    Bbr2CongestionCtlConfig m_config;
+    Mode m_mode{ Mode::startup };
+
+    RoundMaxBwFilter m_maxBw;
+    Duration m_probeRttMin{ Duration::Infinite() };
+    Timepoint m_probeRttStamp{ Timepoint::Zero() };
+    Timepoint m_probeRttDone{ Timepoint::Zero() };
+    uint64_t m_probeRttDoneRound{ 0 };
+
+    uint64_t m_roundCount{ 0 };
+    uint64_t m_nextRoundDelivered{ 0 };
+    uint64_t m_roundLost{ 0 };/** since the round started*/
+    uint64_t m_roundDelivered{ 0 };
+    uint64_t m_lastRoundDelivered{ 0 };
+
+    bool m_fullBwReached{ false };
+    double m_fullBw{ 0 };
+    uint32_t m_fullBwCnt{ 0 };
+
+    uint32_t m_inflightHi{ kUnbounded };/** long term bound, where probing last met congestive loss*/
+    uint32_t m_inflightLo{ kUnbounded };/** short term bound, cut on congestive loss until the next probe*/
+    uint32_t m_priorInflightHi{ kUnbounded };/** the bounds before the last loss that was too high*/
+    uint32_t m_priorInflightLo{ kUnbounded };
+    uint64_t m_loCutRound{ uint64_t(-1) };
+    uint64_t m_cycleStartRound{ 0 };
+    Timepoint m_probeWaitUntil{ Timepoint::Zero() };
+    uint32_t m_probeUpGrowth{ 1 };
+    uint32_t m_probeUpFullRounds{ 0 };
+    double m_probeUpStartBw{ 0 };
+
+    std::minstd_rand m_rng;
+    bool m_rngSeeded{ false };
+};
@@ -0,0 +1,174 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+#include "deliveryratesampler.hpp"
+
+/// config of ChangePointDetector, the thresholds are on the natural log of the samples
+struct ChangePointDetectorConfig
+{
+    uint32_t window_ms{ 500 };/** the tests take the min RTT and the max delivery rate of each window*/
+    double rtt_delta{ 0.15 };/** RTT drift tolerated per window, 0.15 is about 16%*/
+    double rtt_lambda{ 1.0 };/** the RTT test fires once the drift beyond the tolerance sums up to this*/
+    double rate_delta{ 0.2 };
+    double rate_lambda{ 2.0 };
+    uint32_t min_samples{ 4 };/** windows a test takes after a reset before it may fire*/
+    uint32_t holdoff_ms{ 2000 };/** no new change is reported this long after one, while the session re-probes*/
+};
+
+/** @brief Two sided Page-Hinkley test for a shift in the mean of a sample stream.
+ *  Each sample adds x - mean - delta to the up sum and mean - x - delta to the down sum, the mean being the one of
+ *  all the samples since the last reset. The test fires when a sum rises lambda above its own minimum, i.e. when
+ *  the samples have stayed away from the mean by more than delta for long enough. Noise around a steady mean keeps
+ *  both sums falling.
+ * */
+class PageHinkleyTest
+{
+public:
+    PageHinkleyTest(double delta, double lambda, uint32_t minSamples)
+            : m_delta(delta), m_lambda(lambda), m_minSamples(minSamples)
+    {
+    }
+
+    /// 1 for an upward shift, -1 for a downward one, 0 for none
+    int AddSample(double x)
+    {
+        ++m_cnt;
+        m_mean += (x - m_mean) / m_cnt;
+        m_upSum += x - m_mean - m_delta;
+        m_downSum += m_mean - x - m_delta;
+        m_upMin = std::min(m_upMin, m_upSum);
+        m_downMin = std::min(m_downMin, m_downSum);
+        if (m_cnt < m_minSamples)
+        {
+            return 0;
+        }
+        if (m_upSum - m_upMin > m_lambda)
+        {
+            return 1;
+        }
+        if (m_downSum - m_downMin > m_lambda)
+        {
+            return -1;
+        }
+        return 0;
+    }
+
+    void Reset()
+    {
+        m_cnt = 0;
+        m_mean = 0;
+        m_upSum = m_upMin = 0;
+        m_downSum = m_downMin = 0;
+    }
+
+private:
+    double m_delta;
+    double m_lambda;
+    uint32_t m_minSamples;
+
+    uint32_t m_cnt{ 0 };
+    double m_mean{ 0 };
+    double m_upSum{ 0 };
+    double m_upMin{ 0 };
+    double m_downSum{ 0 };
+    double m_downMin{ 0 };
+};
+
+/** @brief Online change-point detection on the RTT and delivery rate of a session.
+ *  A link cut, a handover or Wi-Fi roaming moves the base RTT or the capacity at once, while the min RTT filter
+ *  and the bandwidth estimates follow only over seconds. The samples are taken per window: the min RTT of a window
+ *  only rises when the queue never drains in it, the max delivery rate that is not app limited only falls when the
+ *  path delivers less. A rise of the rate is not reported, the algorithms probe for more capacity anyway.
+ *  Page-Hinkley tests on the log of both tell such a jump from queueing noise, the log makes one threshold fit
+ *  every path. When one fires both tests restart on the new path, and nothing more is reported for holdoff_ms so
+ *  that the ramp up after the reset is not taken for another change.
+ * */
+class ChangePointDetector
+{
+public:
+    explicit ChangePointDetector(const ChangePointDetectorConfig& config = ChangePointDetectorConfig())
+            : m_config(config),
+              m_rttTest(config.rtt_delta, config.rtt_lambda, config.min_samples),
+              m_rateTest(config.rate_delta, config.rate_lambda, config.min_samples)
+    {
+    }
+
+    /// true if the path changed, the caller then drops what it learnt about the old one
+    bool OnAck(Duration rtt, const RateSample& rs, Timepoint now)
+    {
+        if (rtt > Duration::Zero())
+        {
+            m_windowMinRtt = std::min(m_windowMinRtt, rtt);
+        }
+        if (rs.valid && !rs.isAppLimited)
+        {
+            m_windowMaxRate = std::max(m_windowMaxRate, rs.deliveryRate);
+        }
+        if (!m_windowStart.IsInitialized())
+        {
+            m_windowStart = now;
+        }
+        if (now - m_windowStart < Duration::FromMilliseconds(m_config.window_ms))
+        {
+            return false;
+        }
+        Duration minRtt = m_windowMinRtt;
+        double maxRate = m_windowMaxRate;
+        m_windowStart = now;
+        m_windowMinRtt = Duration::Infinite();
+        m_windowMaxRate = 0;
+        if (m_holdoffUntil.IsInitialized() && now < m_holdoffUntil)
+        {
+            return false;
+        }
+
+        int rttShift = 0;
+        int rateShift = 0;
+        if (!minRtt.IsInfinite())
+        {
+            rttShift = m_rttTest.AddSample(std::log(double(minRtt.ToMicroseconds())));
+        }
+        if (maxRate > 0)
+        {
+            rateShift = m_rateTest.AddSample(std::log(maxRate));
+        }
+        if (rateShift > 0)
+        {
+            // a higher rate is what probing finds anyway, the test only learns the new level
+            m_rateTest.Reset();
+            rateShift = 0;
+        }
+        if (rttShift == 0 && rateShift == 0)
+        {
+            return false;
+        }
+        SPDLOG_DEBUG("path change, rtt shift:{}, rate shift:{}, min rtt:{}, max rate:{}", rttShift, rateShift,
+                minRtt.ToDebuggingValue(), maxRate);
+        m_rttTest.Reset();
+        m_rateTest.Reset();
+        m_holdoffUntil = now + Duration::FromMilliseconds(m_config.holdoff_ms);
+        ++m_changeCnt;
+        return true;
+    }
+
+    uint32_t ChangeCnt() const
+    {
+        return m_changeCnt;
+    }
+
+private:
+    ChangePointDetectorConfig m_config;
+    PageHinkleyTest m_rttTest;
+    PageHinkleyTest m_rateTest;
+    Timepoint m_windowStart{ Timepoint::Zero() };
+    Duration m_windowMinRtt{ Duration::Infinite() };
+    double m_windowMaxRate{ 0 };
+    Timepoint m_holdoffUntil{ Timepoint::Zero() };
+    uint32_t m_changeCnt{ 0 };
+};
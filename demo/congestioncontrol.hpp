@@ -3,21 +3,45 @@
 
 #pragma once
 
+#include <cmath>
 #include <cstdint>
 #include <chrono>
+#include <set>
 #include "utils/thirdparty/quiche/rtt_stats.h"
 #include "basefw/base/log.h"
 #include "utils/rttstats.h"
 #include "utils/transporttime.h"
 #include "utils/defaultclock.hpp"
-#include "sessionstreamcontroller.hpp"
 #include "packettype.h"
+#include "deliveryratesampler.hpp"
+
+/// windowed max (Kathleen Nichols' filter) of bandwidth samples in packets per ms, the window is in rounds
+using RoundMaxBwFilter = basefw::quic::WindowedFilter<double, basefw::quic::MaxFilter<double>, uint64_t, uint64_t>;
+
+/// windowed max of bandwidth samples in packets per ms, over a time window
+using TimeMaxBwFilter = basefw::quic::WindowedFilter<double, basefw::quic::MaxFilter<double>, Timepoint, Duration>;
 
 enum class CongestionCtlType : uint8_t
 {
     none = 0,
     reno = 1,
-    ours =2
+    ours =2,
+    bbr2 = 3,
+    cubic = 4,
+    copa = 5,
+    lia = 6,
+    olia = 7,
+    balia = 8,
+    ledbat = 9,
+    vivace = 10
+};
+
+/// how a congestion control sees its path, a session whose path is not active only sends single piece probes
+enum class PathState : uint8_t
+{
+    active = 0,
+    probing = 1,/** the session stalled, probes go out with an exponential backoff*/
+    dead = 2/** the probes failed, its pieces go to the other sessions, the probes go on at the longest interval*/
 };
 
 struct LossEvent
@@ -27,11 +51,13 @@ struct LossEvent
     // There may be multiple timeout events at one time
     std::vector<InflightPacket> lossPackets;
     Timepoint losttic{ Timepoint::Infinite() };
+    bool congestive{ true };/** false if the LossClassifier found the loss random, not from a full queue*/
 
     std::string DebugInfo() const
     {
         std::stringstream ss;
         ss << "valid: " << valid << " "
+           << "congestive: " << congestive << " "
            << "lossPackets:{";
         for (const auto& pkt: lossPackets)
         {
@@ -53,6 +79,7 @@ struct AckEvent
     Timepoint sendtic{ Timepoint::Infinite() };
     Timepoint losttic{ Timepoint::Infinite() };
     Timepoint recvtic{ Timepoint::Infinite() };
+    RateSample rateSample;/** taken by the session's DeliveryRateSampler on this ack*/
 
     std::string DebugInfo() const
     {
@@ -91,20 +118,39 @@ public:
     {
     };
 
+    /** @brief a packet declared lost by DetectLoss arrived after all
+     * @param lostpkt the send record of the packet
+     * @param recvtic when it arrived
+     * @param rttStats RTT statics module
+     * */
+    virtual void OnSpuriousLoss(const InflightPacket& lostpkt, Timepoint recvtic, RttStats& rttStats)
+    {
+    }
+
     virtual ~LossDetectionAlgo() = default;
 
 };
 
+/** @brief Time threshold loss detection, a packet is lost once it is late by the reorder factor times the RTT.
+ *  The factor starts at 5/4. A packet that arrives after it was declared lost shows that the path reorders or
+ *  delays more than that: like the RACK reordering window (RFC 8985) the factor widens by a step, once per
+ *  smoothed RTT, up to one RTT more than at the start, and falls back to 5/4 after kReorderResetEvents loss events
+ *  without a spurious one. The steps are small, a delay spike is over before a wider window could help and each
+ *  step delays the detection of the losses that are real.
+ * */
 class DefaultLossDetectionAlgo : public LossDetectionAlgo
 {/// Check loss event based on RTO
 public:
     void DetectLoss(const InFlightPacketMap& downloadingmap, Timepoint eventtime, const AckEvent& ackEvent,
             uint64_t maxacked, LossEvent& losses, RttStats& rttStats) override
     {
-        SPDLOG_TRACE("inflight: {} eventtime: {} ackEvent: {} session_id: {}",
-            downloadingmap.DebugInfo(), eventtime.ToDebuggingValue(),
-            ackEvent.DebugInfo(), losses.sess_id.ToLogStr()
-        );
+        if (BASEFW_LOG_ENABLED(spdlog::level::trace))
+        {
+            SPDLOG_TRACE("inflight: {} eventtime: {} ackEvent: {} session_id: {}",
+                downloadingmap.DebugInfo(), eventtime.ToDebuggingValue(),
+                ackEvent.DebugInfo(), losses.sess_id.ToLogStr()
+            );
+        }
         /** RFC 9002 Section 6
          * */
         Duration maxrtt = std::max(rttStats.previous_srtt(), rttStats.latest_rtt());
@@ -113,7 +159,7 @@ public:
             SPDLOG_DEBUG(" {}", maxrtt == Duration::Zero());
             maxrtt = rttStats.SmoothedOrInitialRtt();
         }
-        Duration loss_delay = maxrtt + (maxrtt * (5.0 / 4.0));
+        Duration loss_delay = maxrtt + (maxrtt * m_reorderFactor);
         loss_delay = std::max(loss_delay, Duration::FromMicroseconds(1));
         SPDLOG_TRACE(" maxrtt: {}, loss_delay: {}", maxrtt.ToDebuggingValue(), loss_delay.ToDebuggingValue());
         for (const auto& pkt_itor: downloadingmap.inflightPktMap)
@@ -127,6 +173,12 @@ public:
         if (!losses.lossPackets.empty())
         {
             losses.valid = true;
+            if (m_reorderFactor > kInitReorderFactor && ++m_eventsSinceSpurious >= kReorderResetEvents)
+            {
+                m_reorderFactor = kInitReorderFactor;
+                m_eventsSinceSpurious = 0;
+                SPDLOG_DEBUG("no spurious loss for a while, reorder factor back to {}", m_reorderFactor);
+            }
         }
         losses.losttic = eventtime;
         SPDLOG_DEBUG("losses: {}, session_id: {}",
@@ -134,11 +186,43 @@ public:
         );
     }
 
+    void OnSpuriousLoss(const InflightPacket& lostpkt, Timepoint recvtic, RttStats& rttStats) override
+    {
+        m_eventsSinceSpurious = 0;
+        Duration srtt = rttStats.SmoothedOrInitialRtt();
+        if (m_lastWidenTic.IsInitialized() && recvtic < m_lastWidenTic + srtt)
+        {
+            // the other late packets of the same burst
+            return;
+        }
+        m_lastWidenTic = recvtic;
+        m_reorderFactor += kReorderFactorStep;
+        if (m_reorderFactor > kMaxReorderFactor)
+        {
+            m_reorderFactor = kMaxReorderFactor;
+        }
+        SPDLOG_DEBUG("spurious loss of seq:{}, delay:{}, reorder factor:{}", lostpkt.seq,
+                (recvtic - lostpkt.sendtic).ToDebuggingValue(), m_reorderFactor);
+    }
+
+    double ReorderFactor() const
+    {
+        return m_reorderFactor;
+    }
+
     ~DefaultLossDetectionAlgo() override
     {
     }
 
 private:
+    static constexpr double kInitReorderFactor = 5.0 / 4.0;
+    static constexpr double kReorderFactorStep = 1.0 / 8.0;
+    static constexpr double kMaxReorderFactor = kInitReorderFactor + 1.0;
+    static constexpr uint32_t kReorderResetEvents = 16;
+
+    double m_reorderFactor{ kInitReorderFactor };/** loss delay is (1 + m_reorderFactor) times the RTT*/
+    uint32_t m_eventsSinceSpurious{ 0 };
+    Timepoint m_lastWidenTic{ Timepoint::Zero() };
 };
 
 
@@ -166,12 +250,416 @@ public:
 
     virtual Duration GetRtprop() = 0;
 
-    virtual bool IsSleepEnough(Timepoint now) = 0;
+    virtual PathState GetPathState()
+    {
+        return PathState::active;
+    }
+
+    /// called on each alarm, true if the path is not active and the next probe is due now
+    virtual bool IsProbeDue(Timepoint now)
+    {
+        return false;
+    }
+
+    /// packets per ms the requests should be spread at, 0 if the algorithm does not pace
+    virtual double GetPacingRate()
+    {
+        return 0;
+    }
+
+    /// true if the algorithm holds requests back while its window has room, what is delivered then is app limited
+    virtual bool IsHoldingBack()
+    {
+        return false;
+    }
+
+    /// bottleneck capacity in packets per ms measured from packet train dispersion, on each new sample
+    virtual void OnCapacityEstimate(double capacity)
+    {
+    }
+
+    /// the RTT or the rate of the path jumped, what was learnt about the old path is dropped and probed again
+    virtual void OnPathChange()
+    {
+    }
+
+    /// a packet already reported lost in a LossEvent arrived, ackEvent is its ack; it is no longer in flight
+    virtual void OnSpuriousLoss(const AckEvent& ackEvent)
+    {
+    }
 
 //    virtual uint32_t GetFreeCWND() = 0;
 
 };
 
+/** @brief Base of the window based algorithms, the ones that only set a congestion window.
+ *  It counts the packets in flight and the delivered ones, passes on the delivery rate sample of each ack and
+ *  lets a request fill the free window up to maxBurst packets. Each sent packet carries the window and inflight
+ *  at its send time in InflightPacket::ccState, the lost and acked packets of the events still have it. Rates are in packets per ms, like
+ *  OursCongestionControl::GetProbeBw().
+ *  Until the first delivery rate sample, the reported bandwidth is the packet train capacity estimate, and
+ *  AboveCapacityBdp() lets slow start stop at twice the BDP of that capacity before it overflows the queue.
+ *  A derived class that cuts its window on loss calls EnterRecovery() after the cut. Until a packet sent after
+ *  that is acked, Proportional Rate Reduction (RFC 6937) replaces the free window: each ack releases
+ *  new packets in proportion to the delivered ones, so inflight comes down to the new window over about one RTT
+ *  instead of the session going silent until it drains below it.
+ *  The pacing rate spreads the window over the smoothed RTT, twice as fast in slow start so that the window can
+ *  still double each round and 1.2 times after it, as the Linux pacing ratios, ahead of the acks but not in bursts.
+ * */
+class WindowCongestionCtlAlgo : public CongestionCtlAlgo
+{
+public:
+    explicit WindowCongestionCtlAlgo(uint32_t initCwnd, uint32_t maxBurst)
+            : m_cwnd(initCwnd), m_maxBurst(maxBurst)
+    {
+    }
+
+    void OnDataSent(InflightPacket& sentpkt) override
+    {
+        ++m_inflight;
+        m_lastSentTic = sentpkt.sendtic;
+        sentpkt.ccState.cwnd = m_cwnd;
+        sentpkt.ccState.inflight = m_inflight;
+        if (m_inRecovery)
+        {
+            ++m_prrOut;
+            m_prrSendCnt -= std::min<uint32_t>(m_prrSendCnt, 1);
+        }
+        OnPacketSent(sentpkt);
+    }
+
+    void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override
+    {
+        if (lossEvent.valid)
+        {
+            m_inflight -= std::min<uint32_t>(m_inflight, lossEvent.lossPackets.size());
+            m_lost += lossEvent.lossPackets.size();
+            m_inflightBeforeLoss = m_inflight + lossEvent.lossPackets.size();
+            uint32_t priorCwnd = m_cwnd;
+            OnPacketsLost(lossEvent, rttstats);
+            if (m_cwnd < priorCwnd)
+            {
+                // the latest cut, undone if all the packets it was taken for arrive after all
+                m_undoCwnd = priorCwnd;
+                m_undoPkts.clear();
+                for (const auto& lostpkt: lossEvent.lossPackets)
+                {
+                    m_undoPkts.emplace(lostpkt.seq, lostpkt.pieceId);
+                }
+            }
+            if (m_inRecovery && m_inflight == 0)
+            {
+                // nothing left to be acked, no ack would release the next packets
+                ExitRecovery();
+            }
+        }
+        if (ackEvent.valid)
+        {
+            m_inflight -= std::min<uint32_t>(m_inflight, 1);
+            ++m_delivered;
+            m_srtt = rttstats.smoothed_rtt();
+            // the min over the last 10s, a path whose RTT went up is followed
+            if (!rttstats.windowed_min_rtt().IsZero())
+            {
+                m_minRtt = rttstats.windowed_min_rtt();
+            }
+            if (m_inRecovery)
+            {
+                OnRecoveryAck(ackEvent);
+            }
+            // an app limited sample only tells the rate the session was given, unless it is higher
+            const RateSample& rs = ackEvent.rateSample;
+            double rateSample = 0;
+            if (rs.valid && (!rs.isAppLimited || rs.deliveryRate >= m_bwEstimate))
+            {
+                rateSample = rs.deliveryRate;
+                m_hasRateSample = true;
+            }
+            OnPacketAcked(ackEvent, rateSample, rttstats);
+        }
+    }
+
+    uint32_t GetCWND() override
+    {
+        return m_cwnd;
+    }
+
+    uint32_t GetSendNum() override
+    {
+        if (m_inRecovery)
+        {
+            return std::min(m_prrSendCnt, m_maxBurst);
+        }
+        return m_cwnd > m_inflight ? std::min(m_cwnd - m_inflight, m_maxBurst) : 0;
+    }
+
+    double GetProbeBw() override
+    {
+        return m_bwEstimate;
+    }
+
+    /// the window based algorithms find their own share, the scheduler's hint is only kept
+    void SetLogicBw(double bw, bool isMax) override
+    {
+        m_isMaxBw = isMax;
+    }
+
+    Duration GetRtprop() override
+    {
+        return m_minRtt;
+    }
+
+    double GetPacingRate() override
+    {
+        return WindowPacingRate(InSlowStart() ? kSlowStartPacingGain : kPacingGain);
+    }
+
+    void OnCapacityEstimate(double capacity) override
+    {
+        m_capacity = capacity;
+        if (!m_hasRateSample)
+        {
+            m_bwEstimate = capacity;
+        }
+    }
+
+    /// the bandwidth estimate stays until the new path gives a sample, the window is left to the derived class
+    void OnPathChange() override
+    {
+        m_minRtt = Duration::Infinite();
+        m_capacity = 0;
+        m_hasRateSample = false;
+        m_undoPkts.clear();
+        OnPathReset();
+    }
+
+    /// the packet was counted out of inflight with its loss, it is only delivered now
+    void OnSpuriousLoss(const AckEvent& ackEvent) override
+    {
+        ++m_delivered;
+        m_lost -= std::min<uint64_t>(m_lost, 1);
+        if (m_undoPkts.erase(std::make_pair(ackEvent.ackPacket.seq, ackEvent.ackPacket.pieceId)) == 0
+            || !m_undoPkts.empty())
+        {
+            return;
+        }
+        // none of the packets the last cut was taken for was lost, the path was only late
+        SPDLOG_DEBUG("undo cwnd reduction, cwnd:{}, prior cwnd:{}", m_cwnd, m_undoCwnd);
+        UndoCwndReduction(m_undoCwnd);
+        if (m_inRecovery)
+        {
+            ExitRecovery();
+        }
+    }
+
+protected:
+    virtual void OnPacketSent(const InflightPacket& sentpkt)
+    {
+    }
+
+    virtual void OnPathReset()
+    {
+    }
+
+    /// the pacing rate is twice the window per RTT while this is true
+    virtual bool InSlowStart() const
+    {
+        return false;
+    }
+
+    /// gain times the window per smoothed RTT in packets per ms, 0 before the first RTT sample
+    double WindowPacingRate(double gain) const
+    {
+        if (m_srtt <= Duration::Zero() || m_srtt.IsInfinite())
+        {
+            return 0;
+        }
+        return gain * m_cwnd * 1000.0 / m_srtt.ToMicroseconds();
+    }
+
+    /// rateSample is the delivery rate measured by this ack in packets per ms, 0 if there is none or it is
+    /// app limited and below m_bwEstimate
+    virtual void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) = 0;
+
+    virtual void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) = 0;
+
+    /** @brief the last cut of m_cwnd was spurious, the window is put back to priorCwnd, its value before the cut.
+     *  A derived class that cut more than m_cwnd keeps the rest of its state of before the cut and puts it back
+     *  here too.
+     * */
+    virtual void UndoCwndReduction(uint32_t priorCwnd)
+    {
+        m_cwnd = std::max(m_cwnd, priorCwnd);
+    }
+
+    /// called from OnPacketsLost after m_cwnd is cut, the new m_cwnd is the ssthresh PRR converges to
+    void EnterRecovery()
+    {
+        m_inRecovery = true;
+        m_recoveryPoint = m_lastSentTic;
+        m_prrSsthresh = std::max<uint32_t>(m_cwnd, 1);
+        m_prrRecoverFs = std::max<uint32_t>(m_inflightBeforeLoss, 1);
+        m_prrDelivered = 0;
+        m_prrOut = 0;
+        // the first lost packet goes out again at once, as a fast retransmit
+        m_prrSendCnt = 1;
+        SPDLOG_DEBUG("enter recovery, ssthresh:{}, recoverfs:{}, inflight:{}", m_prrSsthresh, m_prrRecoverFs,
+                m_inflight);
+    }
+
+    bool InRecovery() const
+    {
+        return m_inRecovery;
+    }
+
+    /// the window holds twice the BDP of the measured capacity, the queue fills beyond it
+    bool AboveCapacityBdp(double cwnd) const
+    {
+        if (m_capacity <= 0 || m_minRtt.IsInfinite())
+        {
+            return false;
+        }
+        return cwnd >= 2 * m_capacity * m_minRtt.ToMicroseconds() / 1000.0;
+    }
+
+    uint32_t m_cwnd;
+    uint32_t m_maxBurst;
+    uint32_t m_inflight{ 0 };
+    uint64_t m_delivered{ 0 };
+    uint64_t m_lost{ 0 };
+    Duration m_minRtt{ Duration::Infinite() };
+    Duration m_srtt{ Duration::Zero() };
+    double m_bwEstimate{ 0.1 };/** reported to the scheduler, set by the derived class*/
+    bool m_isMaxBw{ false };
+    double m_capacity{ 0 };/** packet train capacity estimate, 0 if none yet*/
+    bool m_hasRateSample{ false };
+
+private:
+    static constexpr double kSlowStartPacingGain = 2.0;
+    static constexpr double kPacingGain = 1.2;
+
+    void OnRecoveryAck(const AckEvent& ackEvent)
+    {
+        if (ackEvent.sendtic > m_recoveryPoint)
+        {
+            ExitRecovery();
+            return;
+        }
+        ++m_prrDelivered;
+        int64_t sndcnt;
+        if (m_inflight > m_prrSsthresh)
+        {
+            // proportional part, send ssthresh/RecoverFS packets for each one delivered
+            sndcnt = int64_t(std::ceil(double(m_prrDelivered) * m_prrSsthresh / m_prrRecoverFs)) - int64_t(m_prrOut);
+        }
+        else
+        {
+            // PRR-SSRB, inflight is below ssthresh already: grow back to it, at most one more than delivered
+            int64_t limit = std::max<int64_t>(int64_t(m_prrDelivered) - int64_t(m_prrOut), 1) + 1;
+            sndcnt = std::min<int64_t>(int64_t(m_prrSsthresh) - int64_t(m_inflight), limit);
+        }
+        m_prrSendCnt = uint32_t(std::max<int64_t>(sndcnt, 0));
+    }
+
+    void ExitRecovery()
+    {
+        m_inRecovery = false;
+        m_prrSendCnt = 0;
+        SPDLOG_DEBUG("exit recovery, cwnd:{}, inflight:{}", m_cwnd, m_inflight);
+    }
+
+    Timepoint m_lastSentTic{ Timepoint::Zero() };
+    uint32_t m_inflightBeforeLoss{ 0 };
+    bool m_inRecovery{ false };
+    Timepoint m_recoveryPoint{ Timepoint::Zero() };/** recovery ends when a packet sent after this is acked*/
+    uint32_t m_prrSsthresh{ 0 };
+    uint32_t m_prrRecoverFs{ 0 };/** packets in flight when the recovery started*/
+    uint64_t m_prrDelivered{ 0 };
+    uint64_t m_prrOut{ 0 };
+    uint32_t m_prrSendCnt{ 0 };/** packets this ack released*/
+    uint32_t m_undoCwnd{ 0 };/** m_cwnd before the last cut*/
+    std::set<std::pair<SeqNumber, DataNumber>> m_undoPkts;/** lost packets of the last cut that did not arrive yet*/
+};
+
+/** @brief HyStart++ (RFC 9406) delay based slow start exit, for the window based algorithms.
+ *  The min RTT of each round is compared with the one of the last round, when it grows by more than RTT/8
+ *  (4 to 16 ms) the queue is building: the growth slows down to 1/4 (conservative slow start) and after a few
+ *  rounds slow start ends, instead of overshooting the bottleneck queue by a whole window.
+ * */
+class HystartPlusPlus
+{
+public:
+    /// the window increase for one acked packet in slow start
+    double OnAck(bool roundStart, Duration rtt)
+    {
+        if (roundStart)
+        {
+            m_lastRoundMinRtt = m_currentRoundMinRtt;
+            m_currentRoundMinRtt = Duration::Infinite();
+            m_rttSampleCnt = 0;
+            if (m_cssRounds > 0 && ++m_cssRounds > kCssRounds)
+            {
+                // the queue kept growing through conservative slow start
+                SPDLOG_DEBUG("hystart exit slow start");
+                m_exit = true;
+                return 0;
+            }
+        }
+        if (rtt > Duration::Zero())
+        {
+            m_currentRoundMinRtt = std::min(m_currentRoundMinRtt, rtt);
+            ++m_rttSampleCnt;
+        }
+        if (m_cssRounds > 0)
+        {
+            if (m_rttSampleCnt >= kMinRttSamples && m_currentRoundMinRtt < m_cssBaselineMinRtt)
+            {
+                // the delay increase was spurious, back to slow start
+                m_cssRounds = 0;
+            }
+            return 1.0 / kCssGrowthDivisor;
+        }
+        if (m_rttSampleCnt >= kMinRttSamples && !m_currentRoundMinRtt.IsInfinite() && !m_lastRoundMinRtt.IsInfinite())
+        {
+            Duration eta = std::max(Duration::FromMilliseconds(4),
+                    std::min(m_lastRoundMinRtt * 0.125, Duration::FromMilliseconds(16)));
+            if (m_currentRoundMinRtt >= m_lastRoundMinRtt + eta)
+            {
+                SPDLOG_DEBUG("hystart enter css, rtt:{}, last:{}", m_currentRoundMinRtt.ToDebuggingValue(),
+                        m_lastRoundMinRtt.ToDebuggingValue());
+                m_cssBaselineMinRtt = m_currentRoundMinRtt;
+                m_cssRounds = 1;
+            }
+        }
+        return 1;
+    }
+
+    /// slow start should end now
+    bool ShouldExit() const
+    {
+        return m_exit;
+    }
+
+    /// a loss ended slow start, a later slow start begins afresh
+    void Reset()
+    {
+        m_cssRounds = 0;
+        m_exit = false;
+    }
+
+private:
+    static constexpr uint32_t kMinRttSamples = 8;
+    static constexpr uint32_t kCssGrowthDivisor = 4;
+    static constexpr uint32_t kCssRounds = 5;
+
+    Duration m_lastRoundMinRtt{ Duration::Infinite() };
+    Duration m_currentRoundMinRtt{ Duration::Infinite() };
+    Duration m_cssBaselineMinRtt{ Duration::Infinite() };
+    uint32_t m_rttSampleCnt{ 0 };
+    uint32_t m_cssRounds{ 0 };/** rounds in conservative slow start, 0 when not in it*/
+    bool m_exit{ false };
+};
+
 /// config or setting for specific cc algo
 /// used for pass parameters to CongestionCtlAlgo
 struct RenoCongestionCtlConfig
@@ -179,13 +667,15 @@ struct RenoCongestionCtlConfig
     uint32_t minCwnd{ 1 };
     uint32_t maxCwnd{ 64 };
     uint32_t ssThresh{ 32 };/** slow start threshold*/
+    uint32_t maxBurst{ 8 };/** packets requested at once*/
 };
 
-class RenoCongestionControl : public CongestionCtlAlgo
+class RenoCongestionControl final : public WindowCongestionCtlAlgo
 {
 public:
 
     explicit RenoCongestionControl(const RenoCongestionCtlConfig& ccConfig)
+            : WindowCongestionCtlAlgo(1, ccConfig.maxBurst)
     {
         m_ssThresh = ccConfig.ssThresh;
         m_minCwnd = ccConfig.minCwnd;
@@ -203,39 +693,31 @@ public:
         return CongestionCtlType::reno;
     }
 
-    void OnDataSent(InflightPacket& sentpkt) override
+protected:
+    void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) override
     {
-        SPDLOG_TRACE("");
-        pktWndMap[sentpkt.pieceId] = GetCWND();
-    }
-
-    void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override
-    {
-        SPDLOG_TRACE("ackevent:{}, lossevent:{}", ackEvent.DebugInfo(), lossEvent.DebugInfo());
-        if (lossEvent.valid)
-        {
-            OnDataLoss(lossEvent);
-        }
-
-        if (ackEvent.valid)
+        if (rateSample > 0)
         {
-            OnDataRecv(ackEvent);
+            m_bwEstimate = m_bwEstimate * 0.875 + rateSample * 0.125;
         }
-
+        OnDataRecv(ackEvent);
     }
 
-    /////
-    uint32_t GetCWND() override
+    void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) override
     {
-        SPDLOG_TRACE(" {}", m_cwnd);
-        return m_cwnd;
+        OnDataLoss(lossEvent);
     }
 
-//    virtual uint32_t GetFreeCWND() = 0;
+    void UndoCwndReduction(uint32_t priorCwnd) override
+    {
+        m_cwnd = BoundCwnd(std::max(m_cwnd, priorCwnd));
+        m_ssThresh = std::max(m_ssThresh, m_priorSsThresh);
+        m_cwndCnt = 0;
+    }
 
 private:
 
-    bool InSlowStart()
+    bool InSlowStart() const override
     {
         bool rt = false;
         if (m_cwnd < m_ssThresh)
@@ -250,28 +732,6 @@ private:
         return rt;
     }
 
-    bool LostCheckRecovery(Timepoint largestLostSentTic)
-    {
-        SPDLOG_DEBUG("largestLostSentTic:{},lastLagestLossPktSentTic:{}",
-                largestLostSentTic.ToDebuggingValue(), lastLagestLossPktSentTic.ToDebuggingValue());
-        /** If the largest sent tic of this loss event,is bigger than the last sent tic of the last lost pkt
-         * (plus a 10ms correction), this session is in Recovery phase.
-         * */
-        if (lastLagestLossPktSentTic.IsInitialized() &&
-            (largestLostSentTic + Duration::FromMilliseconds(10) > lastLagestLossPktSentTic))
-        {
-            SPDLOG_DEBUG("In Recovery");
-            return true;
-        }
-        else
-        {
-            // a new timelost
-            lastLagestLossPktSentTic = largestLostSentTic;
-            SPDLOG_DEBUG("new loss");
-            return false;
-        }
-    }
-
     void ExitSlowStart()
     {
         SPDLOG_DEBUG("m_ssThresh:{}, m_cwnd:{}", m_ssThresh, m_cwnd);
@@ -282,12 +742,17 @@ private:
     void OnDataRecv(const AckEvent& ackEvent)
     {
         SPDLOG_DEBUG("ackevent:{},m_cwnd:{}", ackEvent.DebugInfo(), m_cwnd);
+        if (InRecovery())
+        {
+            /// PRR paces the requests, the window only grows again after recovery
+            return;
+        }
         if (InSlowStart())
         {
             /// add 1 for each ack event
             m_cwnd += 1;
 
-            if (m_cwnd >= m_ssThresh)
+            if (m_cwnd >= m_ssThresh || AboveCapacityBdp(m_cwnd))
             {
                 ExitSlowStart();
             }
@@ -314,25 +779,31 @@ private:
     void OnDataLoss(const LossEvent& lossEvent)
     {
         SPDLOG_DEBUG("lossevent:{}", lossEvent.DebugInfo());
-        Timepoint maxsentTic{ Timepoint::Zero() };
 
         uint32_t maxWnd = 0;
         for (const auto& lostpkt: lossEvent.lossPackets)
         {
-            maxsentTic = std::max(maxsentTic, lostpkt.sendtic);
-            maxWnd = std::max(maxWnd, pktWndMap[lostpkt.pieceId]);
-            SPDLOG_DEBUG("[custom] lostpkt: {}, cwnd: {}", lostpkt.pieceId, pktWndMap[lostpkt.pieceId]);
+            maxWnd = std::max(maxWnd, lostpkt.ccState.cwnd);
+            SPDLOG_DEBUG("[custom] lostpkt: {}, cwnd: {}", lostpkt.pieceId, lostpkt.ccState.cwnd);
         }
 
         float loss_rate = 0.01;
-        if (lossEvent.lossPackets.size() < std::max(int(m_cwnd* loss_rate), 3)) {
+        if (!lossEvent.congestive || lossEvent.lossPackets.size() < std::max(int(m_cwnd* loss_rate), 3)) {
             //m_maxCwnd = maxWnd - lossEvent.lossPackets.size();
             return;
         }
 
-        /** In Recovery phase, cwnd will decrease 1 pkt for each lost pkt
-         *  Otherwise, cwnd will cut half.
+        /** Losses of the packets sent before the last cut are the same congestion event, PRR is still
+         *  bringing inflight down to the window of that cut.
+         * */
+        if (InRecovery())
+        {
+            return;
+        }
+
+        /** Cut half, PRR then spreads the reduction over the next RTT
          * */
+        m_priorSsThresh = m_ssThresh;
         if (InSlowStart())
         {
             // loss in slow start, just cut half
@@ -340,15 +811,14 @@ private:
             m_cwnd = BoundCwnd(m_cwnd);
 
         }
-        else //if (!LostCheckRecovery(maxsentTic))
+        else
         {
-            // Not In slow start and not inside Recovery state
-            // Cut half
+            // Not In slow start, cut half
             m_cwnd = m_cwnd / 2;
             m_cwnd = BoundCwnd(m_cwnd);
             m_ssThresh = m_cwnd;
-            // enter Recovery state
         }
+        EnterRecovery();
         SPDLOG_DEBUG("after Loss, m_cwnd={}", m_cwnd);
     }
 
@@ -358,30 +828,41 @@ private:
         return std::max(m_minCwnd, std::min(trySetCwnd, m_maxCwnd));
     }
 
-    uint32_t m_cwnd{ 1 };
     uint32_t m_cwndCnt{ 0 }; /** in congestion avoid phase, used for counting ack packets*/
-    Timepoint lastLagestLossPktSentTic{ Timepoint::Zero() };
 
 
     uint32_t m_minCwnd{ 1 };
     uint32_t m_maxCwnd{ 128 };
     uint32_t m_ssThresh{ 32 };/** slow start threshold*/
-
-    std::map<DataNumber, uint32_t> pktWndMap;
+    uint32_t m_priorSsThresh{ 32 };/** m_ssThresh before the last cut*/
 };
 
 struct OursCongestionCtlConfig {
-    uint32_t period;
-    double peak_gain;
+    uint32_t period{ 4 };
+    double peak_gain{ 0.25 };
+    double alpha{ 0.1 };/** EWMA weight of the newest packet interval in btlBw*/
+    uint32_t probe_fail_cnt{ 3 };/** unanswered probes after which a stalled path is dead*/
+    uint32_t max_probe_ms{ 1000 };/** the probe backoff stops doubling here, a dead path is probed this often*/
+    double gain_down{ 0.9 };/** cwnd_gain when the queue builds up*/
+    double gain_up{ 1.1 };/** cwnd_gain growth when the queue drains, capped at 1.0*/
+    uint32_t max_send_w{ 8 };/** max packets requested in one burst*/
+    uint32_t btlbw_window_rtts{ 10 };/** btlBw is the max of the rate samples over this many RTprop*/
 };
 
-class OursCongestionControl : public CongestionCtlAlgo {
+class OursCongestionControl final : public CongestionCtlAlgo {
 public:
 
     explicit OursCongestionControl(const OursCongestionCtlConfig &ccConfig)
         : RTprop(Duration::Infinite()), nextPeriodTime(Timepoint::Zero()) {
         period = ccConfig.period;
         peak_gain = ccConfig.peak_gain;
+        alpha = ccConfig.alpha;
+        probeFailCnt = ccConfig.probe_fail_cnt;
+        maxProbeInterval = Duration::FromMilliseconds(ccConfig.max_probe_ms);
+        gainDown = ccConfig.gain_down;
+        gainUp = ccConfig.gain_up;
+        maxSendW = ccConfig.max_send_w;
+        btlBwWindowRtts = ccConfig.btlbw_window_rtts;
 
         delivered = 0;
         receivedSeq = 0;
@@ -399,9 +880,14 @@ public:
     }
 
     void OnDataSent(InflightPacket& sentpkt) override {
-        sentpkt.delivered = delivered;
         inflight++;
-        sendW = std::max(sendW-1, uint32_t(0));
+        if (pathState != PathState::active) {
+            // only probes are sent now
+            probeSentTime = sentpkt.sendtic;
+        }
+        sendW = sendW > 0 ? sendW - 1 : 0;
+        sentpkt.ccState.cwnd = GetCWND();
+        sentpkt.ccState.inflight = inflight;
     }
 
     void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats) override {
@@ -415,7 +901,12 @@ public:
     }
 
     uint32_t GetSendNum() override {
-        return sendW;
+        return pathState == PathState::active ? sendW : 0;
+    }
+
+    /// waiting for recvW acks before the next burst
+    bool IsHoldingBack() override {
+        return pathState == PathState::active && sendW == 0 && GetCWND() > inflight;
     }
 
     uint32_t GetCWND() override {
@@ -436,6 +927,11 @@ public:
     void SetLogicBw(double bw, bool isMax) override {
         isMaxBw = isMax;
         if (!isMaxBw) cwnd_gain = 1.0;
+        if (pathState != PathState::active) {
+            // the window comes back with the path
+            logicBw = bw;
+            return;
+        }
         if (logicBw == 0 && bw > 0) {
             sendW = 1;
             recvW = 1;
@@ -454,29 +950,92 @@ public:
         return RTprop;
     }
     
-    bool IsSleepEnough(Timepoint now) override {
-        bool result = false;
-        if (stopTime != Timepoint::Zero()) {
-            result = (stopTime + waitTime < now);
-            SPDLOG_DEBUG("stop time: {} wait: {} now: {}", stopTime.ToDebuggingValue(), waitTime.ToDebuggingValue(), now.ToDebuggingValue());
-        }
-        if (result) {
-            stopTime = Timepoint::Zero();
-            isStartUp = true;
-            recvW = 1;
-            recvNum = 0;
-            sendW = 1;
-            lastSentW = sendW;
-            cwnd_gain = 1.0;
-            SPDLOG_DEBUG("restart at time: {}", now.ToDebuggingValue());
+    PathState GetPathState() override {
+        return pathState;
+    }
+
+    /** A stalled session sends one piece per probe interval, which starts at the RTT and doubles up to
+     *  maxProbeInterval each time a probe got no answer within it. After probeFailCnt of them the path is dead,
+     *  it is still probed at the longest interval.
+     * */
+    bool IsProbeDue(Timepoint now) override {
+        if (pathState == PathState::active || now < nextProbeTime) {
+            return false;
+        }
+        if (probeSentTime != Timepoint::Zero()) {
+            probeSentTime = Timepoint::Zero();
+            failedProbes++;
+            probeInterval = std::min(probeInterval * 2, maxProbeInterval);
+            if (pathState == PathState::probing && failedProbes >= probeFailCnt) {
+                pathState = PathState::dead;
+                SPDLOG_DEBUG("path dead after {} probes at time: {}", failedProbes, now.ToDebuggingValue());
+            }
+        }
+        nextProbeTime = now + probeInterval;
+        return true;
+    }
+
+    /// the old RTprop and btlBw no longer hold, they are taken again from the next samples
+    void OnPathChange() override {
+        RTprop = Duration::Infinite();
+        btlBwFilter.Clear();
+        btlBw = kInitBtlBw;
+        cwnd_gain = 1.0;
+        nextPeriodTime = Timepoint::Zero();
+    }
+
+    /// the path only delayed the packet, a stall the loss alarms led to is over
+    void OnSpuriousLoss(const AckEvent& ackEvent) override {
+        delivered++;
+        ticNum = 0;
+        if (pathState != PathState::active) {
+            OnPathAnswered(ackEvent.recvtic);
         }
-        return result;
     }
 
 private:
+    /// the session stops, what it sent at is kept for when the path answers again
+    void EnterProbing(Timepoint now) {
+        pathState = PathState::probing;
+        savedCwndGain = cwnd_gain;
+        savedRecvW = recvW;
+        savedSendW = lastSentW;
+        savedStartUp = isStartUp;
+        sendW = 0;
+        recvNum = 0;
+        failedProbes = 0;
+        probeSentTime = Timepoint::Zero();
+        probeInterval = srtt > Duration::Zero() ? srtt : (RTprop.IsInfinite() ? kInitProbeInterval : RTprop);
+        probeInterval = std::min(std::max(probeInterval, kMinProbeInterval), maxProbeInterval);
+        nextProbeTime = now + probeInterval;
+        SPDLOG_DEBUG("stall at time: {}, probe interval: {}", now.ToDebuggingValue(), probeInterval.ToDebuggingValue());
+    }
+
+    /// a packet came back while stalled, the session goes on at its rate of before the stall if it has a window
+    void OnPathAnswered(Timepoint now) {
+        failedProbes = 0;
+        probeSentTime = Timepoint::Zero();
+        if (GetCWND() == 0) {
+            // the path works, the window is what keeps it stopped
+            pathState = PathState::probing;
+            return;
+        }
+        pathState = PathState::active;
+        cwnd_gain = savedCwndGain;
+        isStartUp = savedStartUp;
+        recvW = std::max(savedRecvW, 1U);
+        recvNum = 0;
+        sendW = std::max(std::min(savedSendW, maxSendW), 1U);
+        lastSentW = sendW;
+        SPDLOG_DEBUG("path back at time: {}, sendW: {}, recvW: {}", now.ToDebuggingValue(), sendW, recvW);
+    }
+
     void OnDataRecv(const AckEvent& ackEvent, RttStats& rttstats) {
-        RTprop = std::min(rttstats.latest_rtt(), RTprop);
+        // min RTT of the last 10s, not of the whole session, the path may have changed
+        RTprop = rttstats.windowed_min_rtt().IsZero() ? std::min(rttstats.latest_rtt(), RTprop)
+                                                      : rttstats.windowed_min_rtt();
         Timepoint now = ackEvent.recvtic;
+        srtt = rttstats.smoothed_rtt();
         
         receivedSeq = ackEvent.ackPacket.seq;
         delivered++;
@@ -494,18 +1053,21 @@ private:
             {
                 avgRecDur = alpha * receivedDur + (1-alpha) * avgRecDur;
                 nowRate = double(1)*1000 / avgRecDur.ToMicroseconds();
-                btlBw = nowRate;
+                // max over the last btlbw_window_rtts RTTs
+                btlBwFilter.SetWindowLength(RTprop * int(btlBwWindowRtts));
+                btlBwFilter.Update(nowRate, now);
+                btlBw = btlBwFilter.GetBest();
             }
 
             if (now >= nextPeriodTime && ackEvent.ackPacket.groupId != lastGroupId) {
                 if (!isMaxBw && rttstats.smoothed_rtt() >= RTprop + 10*Duration::FromMicroseconds(int(1000/btlBw))) {
-                    cwnd_gain = 0.9;
+                    cwnd_gain = gainDown;
                 } else if(!isMaxBw && rttstats.smoothed_rtt() < RTprop + 10*Duration::FromMicroseconds(int(1000/btlBw))) {
                     cwnd_gain = 1.0;
                 } else if (isMaxBw && rttstats.smoothed_rtt() >= RTprop + 10*Duration::FromMicroseconds(int(1000/btlBw))) {
-                    cwnd_gain *= 0.9;
+                    cwnd_gain *= gainDown;
                 } else if (isMaxBw && rttstats.smoothed_rtt() < RTprop + 10*Duration::FromMicroseconds(int(1000/btlBw))) {
-                    cwnd_gain = std::min(1.1*cwnd_gain, 1.0);
+                    cwnd_gain = std::min(gainUp*cwnd_gain, 1.0);
                 }
                 nextPeriodTime = now + RTprop;
                 SPDLOG_DEBUG("Rtt is too long");
@@ -520,10 +1082,14 @@ private:
         last_delivered = ackEvent.ackPacket.delivered;
 
         nowCWND = GetCWND();
+        if (pathState != PathState::active) {
+            OnPathAnswered(now);
+            return;
+        }
         if (nowCWND == 0) {
-            stopTime = ackEvent.recvtic;
-            SPDLOG_DEBUG("stop session at time: {}", stopTime.ToDebuggingValue());
-        } 
+            EnterProbing(now);
+            return;
+        }
         if (nowCWND > inflight+recvNum) recvNum++;
 
         if (sendW != 0) {
@@ -533,7 +1099,7 @@ private:
 
         if (isStartUp){
             if (recvNum != 0 && recvNum % recvW == 0) {
-                sendW = std::min(int(recvW*2), 8);
+                sendW = std::min(recvW*2, maxSendW);
                 lastSentW = sendW;
                 if (recvNum + recvW > period && recvW <= period) {
                     recvW += 1;
@@ -556,7 +1122,7 @@ private:
                     recvNum = nowCWND-inflight;
                 } else {
                     double incRate = nowCWND - inflight < 10 ? 1.5 : 2;
-                    sendW = std::min(std::min(uint32_t(incRate*recvW), 8U), nowCWND - inflight);
+                    sendW = std::min(std::min(uint32_t(incRate*recvW), maxSendW), nowCWND - inflight);
                     recvW = std::min(recvW, nowCWND/2);
                 }
                 recvW = std::max(recvW, 1U);
@@ -619,17 +1185,23 @@ private:
     void OnDataLoss(const LossEvent& lossEvent)
     {
         inflight -= lossEvent.lossPackets.size();
+        if (pathState != PathState::active) {
+            // a lost probe, IsProbeDue backs off
+            return;
+        }
         uint32_t nowCWND = GetCWND();
-        ticNum++;
+        if (lossEvent.congestive) {
+            // only alarms on a full queue or a dead path count towards stopping the session
+            ticNum++;
+        }
         // if (lossEvent.lossPackets.size() >= 3) {
         //     btlBw *= 0.5;
         // }
-        if (ticNum >= 3 && stopTime == Timepoint::Zero()) {
-            stopTime = lossEvent.losttic;
-            SPDLOG_DEBUG("stop session at time: {}", stopTime.ToDebuggingValue());
+        if (ticNum >= 3) {
+            EnterProbing(lossEvent.losttic);
         } else if (inflight < nowCWND) {
             recvNum = 0;
-            sendW = std::min(std::min(nowCWND - inflight, uint32_t(lossEvent.lossPackets.size())), 8U);
+            sendW = std::min(std::min(nowCWND - inflight, uint32_t(lossEvent.lossPackets.size())), maxSendW);
             lastSentW = sendW;
         }
         
@@ -642,7 +1214,8 @@ private:
     Duration RTprop;
     DataNumber delivered;
     DataNumber receivedSeq;
-    double btlBw{0.1};
+    static constexpr double kInitBtlBw = 0.1;
+    double btlBw{kInitBtlBw};
     double oldBw;
     double cwnd_gain;
     uint32_t last_delivered;
@@ -667,6 +1240,24 @@ private:
     Timepoint lastReceivedTime{ Timepoint::Zero() };
     Timepoint lastPktSendTime{ Timepoint::Zero() };
     uint32_t lastGroupId{ 0 };
-    Timepoint stopTime { Timepoint::Zero() };
-    Duration waitTime { Duration::FromMilliseconds(1000) };
+    Duration srtt{ Duration::Zero() };
+    PathState pathState{ PathState::active };
+    Timepoint nextProbeTime{ Timepoint::Zero() };
+    Timepoint probeSentTime{ Timepoint::Zero() };/** of the probe not answered yet, Zero if none*/
+    Duration probeInterval{ Duration::Zero() };
+    Duration maxProbeInterval{ Duration::FromMilliseconds(1000) };
+    uint32_t failedProbes{ 0 };
+    uint32_t probeFailCnt{ 3 };
+    // the rate before the stall, the session goes on with it when the path answers
+    double savedCwndGain{ 1.0 };
+    uint32_t savedRecvW{ 1 };
+    uint32_t savedSendW{ 1 };
+    bool savedStartUp{ true };
+    const Duration kInitProbeInterval{ Duration::FromMilliseconds(200) };
+    const Duration kMinProbeInterval{ Duration::FromMilliseconds(10) };
+    double gainDown{ 0.9 };
+    double gainUp{ 1.1 };
+    uint32_t maxSendW{ 8 };
+    uint32_t btlBwWindowRtts{ 10 };
+    TimeMaxBwFilter btlBwFilter{ Duration::FromMilliseconds(1000), 0, Timepoint::Zero() };
 };
\ No newline at end of file
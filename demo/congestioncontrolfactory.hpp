@@ -0,0 +1,113 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "congestioncontrol.hpp"
+#include "bbr2congestioncontrol.hpp"
+#include "cubiccongestioncontrol.hpp"
+#include "copacongestioncontrol.hpp"
+#include "coupledcongestioncontrol.hpp"
+#include "ledbatcongestioncontrol.hpp"
+#include "vivacecongestioncontrol.hpp"
+#include "pacer.hpp"
+
+/// which algorithm a session uses and the config of each one
+struct CongestionCtlConfig
+{
+    CongestionCtlType type{ CongestionCtlType::ours };
+    OursCongestionCtlConfig ours;
+    RenoCongestionCtlConfig reno;
+    Bbr2CongestionCtlConfig bbr2;
+    CubicCongestionCtlConfig cubic;
+    CopaCongestionCtlConfig copa;
+    LedbatCongestionCtlConfig ledbat;
+    VivaceCongestionCtlConfig vivace;
+    CoupledCongestionCtlConfig coupled;/** for lia, olia and balia, the algo is set from type*/
+    PacerConfig pacer;/** the pacer of the session, it spreads the requests at GetPacingRate()*/
+};
+
+/// the coupled config with its algo set from ccConfig.type
+inline CoupledCongestionCtlConfig CoupledConfigOf(const CongestionCtlConfig& ccConfig)
+{
+    CoupledCongestionCtlConfig coupled = ccConfig.coupled;
+    coupled.algo = ccConfig.type == CongestionCtlType::lia ? CoupledCongestionCtlConfig::Algo::lia
+                   : ccConfig.type == CongestionCtlType::olia ? CoupledCongestionCtlConfig::Algo::olia
+                   : CoupledCongestionCtlConfig::Algo::balia;
+    return coupled;
+}
+
+inline std::unique_ptr<CongestionCtlAlgo> MakeCongestionCtl(const CongestionCtlConfig& ccConfig)
+{
+    switch (ccConfig.type)
+    {
+        case CongestionCtlType::reno:
+            return std::unique_ptr<CongestionCtlAlgo>(new RenoCongestionControl(ccConfig.reno));
+        case CongestionCtlType::bbr2:
+            return std::unique_ptr<CongestionCtlAlgo>(new Bbr2CongestionControl(ccConfig.bbr2));
+        case CongestionCtlType::cubic:
+            return std::unique_ptr<CongestionCtlAlgo>(new CubicCongestionControl(ccConfig.cubic));
+        case CongestionCtlType::copa:
+            return std::unique_ptr<CongestionCtlAlgo>(new CopaCongestionControl(ccConfig.copa));
+        case CongestionCtlType::ledbat:
+            return std::unique_ptr<CongestionCtlAlgo>(new LedbatCongestionControl(ccConfig.ledbat));
+        case CongestionCtlType::vivace:
+            return std::unique_ptr<CongestionCtlAlgo>(new VivaceCongestionControl(ccConfig.vivace));
+        case CongestionCtlType::lia:
+        case CongestionCtlType::olia:
+        case CongestionCtlType::balia:
+            return std::unique_ptr<CongestionCtlAlgo>(new CoupledCongestionControl(CoupledConfigOf(ccConfig)));
+        case CongestionCtlType::ours:
+            return std::unique_ptr<CongestionCtlAlgo>(new OursCongestionControl(ccConfig.ours));
+        default:
+            SPDLOG_WARN("unsupported cc type {}, use ours", int(ccConfig.type));
+            return std::unique_ptr<CongestionCtlAlgo>(new OursCongestionControl(ccConfig.ours));
+    }
+}
+
+inline const char* CongestionCtlTypeName(CongestionCtlType type)
+{
+    switch (type)
+    {
+        case CongestionCtlType::reno:
+            return "reno";
+        case CongestionCtlType::ours:
+            return "ours";
+        case CongestionCtlType::bbr2:
+            return "bbr2";
+        case CongestionCtlType::cubic:
+            return "cubic";
+        case CongestionCtlType::copa:
+            return "copa";
+        case CongestionCtlType::lia:
+            return "lia";
+        case CongestionCtlType::olia:
+            return "olia";
+        case CongestionCtlType::balia:
+            return "balia";
+        case CongestionCtlType::ledbat:
+            return "ledbat";
+        case CongestionCtlType::vivace:
+            return "vivace";
+        default:
+            return "none";
+    }
+}
+
+/// false if the name is not a selectable algorithm
+inline bool ParseCongestionCtlType(const std::string& name, CongestionCtlType& type)
+{
+    for (auto candidate: { CongestionCtlType::ours, CongestionCtlType::reno, CongestionCtlType::bbr2,
+                             CongestionCtlType::cubic, CongestionCtlType::copa, CongestionCtlType::lia,
+                             CongestionCtlType::olia, CongestionCtlType::balia, CongestionCtlType::ledbat,
+                             CongestionCtlType::vivace })
+    {
+        if (name == CongestionCtlTypeName(candidate))
+        {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
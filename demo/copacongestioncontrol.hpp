@@ -0,0 +1,218 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include "congestioncontrol.hpp"
+
+/// config of CopaCongestionControl, windows are in packets
+struct CopaCongestionCtlConfig
+{
+    uint32_t init_cwnd{ 10 };
+    uint32_t min_cwnd{ 4 };
+    uint32_t max_cwnd{ 2000 };
+    uint32_t max_burst{ 8 };/** packets requested at once*/
+    double delta{ 0.5 };/** default mode delta, the standing queue is about 1/delta packets*/
+    uint32_t min_rtt_window_ms{ 10000 };/** RTTmin is the min RTT over this window*/
+    bool competitive{ true };/** switch to competitive mode when the queue never drains*/
+    uint32_t mode_check_rtts{ 5 };/** decide the mode every this many RTTs*/
+    double empty_queue_ratio{ 0.1 };/** the queue counts as empty when dq < ratio * (RTTmax - RTTmin)*/
+};
+
+/** @brief Copa (Arun & Balakrishnan, NSDI 2018) on the window only transport.
+ *  The target rate is 1/(delta * dq) packets per second, dq = RTTstanding - RTTmin is the queueing delay,
+ *  RTTstanding is the min RTT over the last srtt/2 and RTTmin the min RTT over min_rtt_window_ms. Each ack moves
+ *  the window by v/(delta*cwnd) towards the target, the velocity v doubles each RTT the window keeps going the
+ *  same direction. With delta = 0.5 a flow keeps about 2 packets queued at the bottleneck.
+ *  When buffer filling flows share the bottleneck the queue is never empty, and a small fixed delta would hand
+ *  them the link: competitive mode then runs AIMD on 1/delta, +1 per RTT and halved on loss.
+ * */
+class CopaCongestionControl final : public WindowCongestionCtlAlgo
+{
+public:
+    explicit CopaCongestionControl(const CopaCongestionCtlConfig& ccConfig)
+            : WindowCongestionCtlAlgo(ccConfig.init_cwnd, ccConfig.max_burst), m_config(ccConfig),
+              m_cwndF(ccConfig.init_cwnd), m_delta(ccConfig.delta)
+    {
+        SPDLOG_DEBUG("init_cwnd:{}, delta:{}, competitive:{}", ccConfig.init_cwnd, ccConfig.delta,
+                ccConfig.competitive);
+    }
+
+    ~CopaCongestionControl() override
+    {
+        SPDLOG_DEBUG("");
+    }
+
+    CongestionCtlType GetCCtype() override
+    {
+        return CongestionCtlType::copa;
+    }
+
+    Duration GetRtprop() override
+    {
+        return m_rttMin.empty() ? Duration::Infinite() : m_rttMin.front().second;
+    }
+
+    /// Copa paces at 2 cwnd / RTT, so that the window and not the pacer is what limits it
+    double GetPacingRate() override
+    {
+        return WindowPacingRate(2.0);
+    }
+
+    bool IsCompetitive() const
+    {
+        return m_competitiveMode;
+    }
+
+protected:
+    void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) override
+    {
+        Timepoint now = ackEvent.recvtic;
+        Duration rtt = rttstats.latest_rtt();
+        if (rtt <= Duration::Zero())
+        {
+            return;
+        }
+        if (rateSample > 0)
+        {
+            m_bwEstimate = m_bwEstimate * 0.875 + rateSample * 0.125;
+        }
+        Duration srtt = rttstats.smoothed_rtt();
+        PushMin(m_rttMin, now, rtt, Duration::FromMilliseconds(m_config.min_rtt_window_ms));
+        PushMin(m_rttStanding, now, rtt, std::max(srtt * 0.5, Duration::FromMilliseconds(1)));
+        m_rttMaxInCheck = std::max(m_rttMaxInCheck, rtt);
+
+        Duration rttMin = m_rttMin.front().second;
+        Duration rttStanding = m_rttStanding.front().second;
+        Duration dq = rttStanding - rttMin;
+        if (dq < (m_rttMaxInCheck - rttMin) * m_config.empty_queue_ratio)
+        {
+            m_queueEmptied = true;
+        }
+
+        bool roundStart = false;
+        if (uint64_t(ackEvent.ackPacket.delivered) >= m_nextRoundDelivered)
+        {
+            m_nextRoundDelivered = m_delivered;
+            roundStart = true;
+            OnRoundStart();
+        }
+
+        // the rate now and the one the queueing delay asks for, in packets per second
+        double currentRate = m_cwndF * 1e6 / rttStanding.ToMicroseconds();
+        double targetRate = dq > Duration::Zero() ? 1e6 / (m_delta * dq.ToMicroseconds())
+                                                  : std::numeric_limits<double>::max();
+        bool increase = currentRate <= targetRate;
+        if (m_slowStart)
+        {
+            if (increase)
+            {
+                m_cwndF += 1;
+            }
+            else
+            {
+                m_slowStart = false;
+                SPDLOG_DEBUG("exit slow start, cwnd:{}, dq:{}", m_cwndF, dq.ToDebuggingValue());
+            }
+        }
+        if (!m_slowStart)
+        {
+            if (roundStart)
+            {
+                UpdateVelocity(increase);
+            }
+            double step = m_velocity / (m_delta * m_cwndF);
+            m_cwndF = increase ? m_cwndF + step : m_cwndF - step;
+        }
+        m_cwndF = std::max(double(m_config.min_cwnd), std::min(m_cwndF, double(m_config.max_cwnd)));
+        m_cwnd = uint32_t(m_cwndF);
+        SPDLOG_TRACE("cwnd:{}, dq:{}, delta:{}, v:{}", m_cwndF, dq.ToDebuggingValue(), m_delta, m_velocity);
+    }
+
+    void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) override
+    {
+        // the default mode only follows the delay, in competitive mode a loss halves 1/delta once per round
+        if (m_competitiveMode && !m_lossInRound && lossEvent.congestive)
+        {
+            m_lossInRound = true;
+            m_delta = std::min(m_delta * 2, m_config.delta);
+            SPDLOG_DEBUG("loss in competitive mode, delta:{}", m_delta);
+        }
+    }
+
+private:
+    static constexpr uint32_t kVelocityRounds = 3;
+
+    /// min filter over a time window, a monotonic deque of (time, rtt) with increasing rtts
+    static void PushMin(std::deque<std::pair<Timepoint, Duration>>& filter, Timepoint now, Duration rtt,
+            Duration window)
+    {
+        while (!filter.empty() && filter.back().second >= rtt)
+        {
+            filter.pop_back();
+        }
+        filter.emplace_back(now, rtt);
+        while (filter.front().first + window < now)
+        {
+            filter.pop_front();
+        }
+    }
+
+    void OnRoundStart()
+    {
+        if (m_competitiveMode && !m_lossInRound)
+        {
+            m_delta = 1.0 / (1.0 / m_delta + 1);
+        }
+        m_lossInRound = false;
+        if (m_config.competitive && ++m_roundsInCheck >= m_config.mode_check_rtts)
+        {
+            // a queue that never drained in the last RTTs is kept up by someone that does not yield
+            bool competitive = !m_queueEmptied;
+            if (competitive != m_competitiveMode)
+            {
+                m_competitiveMode = competitive;
+                m_delta = m_config.delta;
+                SPDLOG_DEBUG("competitive mode:{}", m_competitiveMode);
+            }
+            m_roundsInCheck = 0;
+            m_queueEmptied = false;
+            m_rttMaxInCheck = Duration::Zero();
+        }
+    }
+
+    /// once per RTT: v doubles after kVelocityRounds rounds in the same direction, resets to 1 on a turn
+    void UpdateVelocity(bool increase)
+    {
+        if (increase != m_lastIncrease)
+        {
+            m_lastIncrease = increase;
+            m_sameDirectionRounds = 0;
+            m_velocity = 1;
+            return;
+        }
+        if (++m_sameDirectionRounds >= kVelocityRounds)
+        {
+            m_velocity = std::min(m_velocity * 2, std::max(m_cwndF, 1.0));
+        }
+    }
+
+    CopaCongestionCtlConfig m_config;
+    double m_cwndF;/** the window with its fraction, m_cwnd is its integer part*/
+    double m_delta;
+    double m_velocity{ 1 };
+    bool m_slowStart{ true };
+    bool m_lastIncrease{ true };
+    uint32_t m_sameDirectionRounds{ 0 };
+
+    std::deque<std::pair<Timepoint, Duration>> m_rttMin;
+    std::deque<std::pair<Timepoint, Duration>> m_rttStanding;
+    uint64_t m_nextRoundDelivered{ 0 };
+
+    bool m_competitiveMode{ false };
+    bool m_queueEmptied{ false };
+    bool m_lossInRound{ false };
+    uint32_t m_roundsInCheck{ 0 };
+    Duration m_rttMaxInCheck{ Duration::Zero() };
+};
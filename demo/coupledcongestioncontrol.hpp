@@ -0,0 +1,420 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <vector>
+#include "congestioncontrol.hpp"
+
+/// what the group knows of one session, owned by its CoupledCongestionControl
+struct CoupledSubflow
+{
+    double cwnd{ 1 };
+    Duration srtt{ Duration::FromMilliseconds(200) };
+    double lossInterval{ 0 };/** OLIA l_r: packets delivered between the last two losses, or since the last one*/
+    uint32_t cluster{ 0 };/** subflows with the same cluster are coupled*/
+
+    /// mean queueing delay of each bin, a ring indexed by bin number
+    std::vector<double> qdelaySum;
+    std::vector<uint32_t> qdelayCnt;
+    std::vector<int64_t> binNo;
+
+    double Rate() const
+    {
+        return cwnd / std::max<double>(srtt.ToMicroseconds(), 1);
+    }
+};
+
+struct CoupledCongestionGroupConfig
+{
+    bool couple_all{ false };/** the sessions are known to share one bottleneck, skip the detection*/
+    uint32_t bin_ms{ 100 };/** queueing delay is averaged per bin before the correlation*/
+    uint32_t window_bins{ 20 };/** correlate this many recent bins*/
+    uint32_t min_common_bins{ 10 };/** bins both subflows must have a sample in*/
+    double correlation_thresh{ 0.6 };/** above it two subflows are suspected to share a bottleneck*/
+    uint32_t recluster_ms{ 500 };
+};
+
+/** @brief The sessions of one DemoTransportCtl, grouped by the bottleneck they are suspected to share.
+ *  Sessions behind one bottleneck see the same queue, so their queueing delays rise and fall together: every
+ *  recluster_ms the Pearson correlation of the binned queueing delay of each pair is computed and pairs above
+ *  correlation_thresh are merged (union find). Only subflows of one cluster are coupled, a session on a disjoint
+ *  path keeps the increase of a single path flow.
+ * */
+class CoupledCongestionGroup
+{
+public:
+    explicit CoupledCongestionGroup(const CoupledCongestionGroupConfig& groupConfig = CoupledCongestionGroupConfig())
+            : m_config(groupConfig)
+    {
+    }
+
+    void Add(CoupledSubflow* subflow)
+    {
+        subflow->qdelaySum.assign(m_config.window_bins, 0);
+        subflow->qdelayCnt.assign(m_config.window_bins, 0);
+        subflow->binNo.assign(m_config.window_bins, -1);
+        subflow->cluster = m_config.couple_all ? 0 : m_nextCluster++;
+        m_subflows.push_back(subflow);
+    }
+
+    void Remove(CoupledSubflow* subflow)
+    {
+        m_subflows.erase(std::remove(m_subflows.begin(), m_subflows.end(), subflow), m_subflows.end());
+    }
+
+    void OnQueueDelaySample(CoupledSubflow* subflow, Timepoint now, Duration qdelay)
+    {
+        int64_t bin = now.ToDebuggingValue() / (int64_t(m_config.bin_ms) * 1000);
+        size_t slot = bin % m_config.window_bins;
+        if (subflow->binNo[slot] != bin)
+        {
+            subflow->binNo[slot] = bin;
+            subflow->qdelaySum[slot] = 0;
+            subflow->qdelayCnt[slot] = 0;
+        }
+        subflow->qdelaySum[slot] += qdelay.ToMicroseconds();
+        subflow->qdelayCnt[slot]++;
+
+        if (!m_config.couple_all && (!m_lastCluster.IsInitialized()
+                                     || now - m_lastCluster >= Duration::FromMilliseconds(m_config.recluster_ms)))
+        {
+            m_lastCluster = now;
+            Recluster(bin);
+        }
+    }
+
+    /// the subflows coupled with this one, itself included
+    template<typename Fn>
+    void ForEachCoupled(const CoupledSubflow* subflow, Fn&& fn) const
+    {
+        for (auto peer: m_subflows)
+        {
+            if (peer->cluster == subflow->cluster)
+            {
+                fn(*peer);
+            }
+        }
+    }
+
+private:
+    /// complete bins only, the current one is still filling
+    double Correlation(const CoupledSubflow& a, const CoupledSubflow& b, int64_t currentBin) const
+    {
+        std::vector<std::pair<double, double>> pairs;
+        for (size_t slot = 0; slot < m_config.window_bins; ++slot)
+        {
+            if (a.binNo[slot] >= 0 && a.binNo[slot] == b.binNo[slot] && a.binNo[slot] < currentBin
+                && a.binNo[slot] + int64_t(m_config.window_bins) > currentBin)
+            {
+                pairs.emplace_back(a.qdelaySum[slot] / a.qdelayCnt[slot], b.qdelaySum[slot] / b.qdelayCnt[slot]);
+            }
+        }
+        if (pairs.size() < m_config.min_common_bins)
+        {
+            return 0;
+        }
+        double meanA = 0, meanB = 0;
+        for (const auto& p: pairs)
+        {
+            meanA += p.first;
+            meanB += p.second;
+        }
+        meanA /= pairs.size();
+        meanB /= pairs.size();
+        double cov = 0, varA = 0, varB = 0;
+        for (const auto& p: pairs)
+        {
+            cov += (p.first - meanA) * (p.second - meanB);
+            varA += (p.first - meanA) * (p.first - meanA);
+            varB += (p.second - meanB) * (p.second - meanB);
+        }
+        return varA > 0 && varB > 0 ? cov / std::sqrt(varA * varB) : 0;
+    }
+
+    void Recluster(int64_t currentBin)
+    {
+        std::vector<size_t> parent(m_subflows.size());
+        std::iota(parent.begin(), parent.end(), 0);
+        auto find = [&parent](size_t i)
+        {
+            while (parent[i] != i)
+            {
+                i = parent[i] = parent[parent[i]];
+            }
+            return i;
+        };
+        for (size_t i = 0; i < m_subflows.size(); ++i)
+        {
+            for (size_t j = i + 1; j < m_subflows.size(); ++j)
+            {
+                if (Correlation(*m_subflows[i], *m_subflows[j], currentBin) > m_config.correlation_thresh)
+                {
+                    parent[find(i)] = find(j);
+                }
+            }
+        }
+        for (size_t i = 0; i < m_subflows.size(); ++i)
+        {
+            m_subflows[i]->cluster = uint32_t(find(i));
+        }
+    }
+
+    CoupledCongestionGroupConfig m_config;
+    std::vector<CoupledSubflow*> m_subflows;
+    uint32_t m_nextCluster{ 0 };
+    Timepoint m_lastCluster{ Timepoint::Zero() };
+};
+
+/// config of CoupledCongestionControl, windows are in packets
+struct CoupledCongestionCtlConfig
+{
+    enum class Algo : uint8_t
+    {
+        lia,
+        olia,
+        balia
+    };
+
+    Algo algo{ Algo::lia };
+    uint32_t init_cwnd{ 10 };
+    uint32_t min_cwnd{ 2 };
+    uint32_t max_cwnd{ 2000 };
+    uint32_t max_burst{ 8 };/** packets requested at once*/
+    uint32_t min_loss_cnt{ 3 };/** a loss event with fewer lost packets does not reduce the window, as Reno*/
+    std::shared_ptr<CoupledCongestionGroup> group;/** shared by the sessions of one task, set by DemoTransportCtl*/
+};
+
+/** @brief One subflow of a coupled multipath congestion control: LIA (RFC 6356), OLIA (Khalili et al.) or BALIA
+ *  (Peng et al.). Slow start (with HyStart++) and the decrease on loss are per subflow, the congestion avoidance increase is
+ *  coupled over the subflows of the same cluster of the group, so that the sessions behind one bottleneck together
+ *  take no more than one single path flow would, and move traffic to the less congested paths.
+ *  Without a group, or alone in its cluster, a subflow behaves like Reno.
+ * */
+class CoupledCongestionControl final : public WindowCongestionCtlAlgo
+{
+public:
+    explicit CoupledCongestionControl(const CoupledCongestionCtlConfig& ccConfig)
+            : WindowCongestionCtlAlgo(ccConfig.init_cwnd, ccConfig.max_burst), m_config(ccConfig),
+              m_group(ccConfig.group)
+    {
+        m_subflow.cwnd = ccConfig.init_cwnd;
+        if (!m_group)
+        {
+            m_group = std::make_shared<CoupledCongestionGroup>();
+        }
+        m_group->Add(&m_subflow);
+        SPDLOG_DEBUG("algo:{}, init_cwnd:{}", int(ccConfig.algo), ccConfig.init_cwnd);
+    }
+
+    ~CoupledCongestionControl() override
+    {
+        m_group->Remove(&m_subflow);
+        SPDLOG_DEBUG("");
+    }
+
+    CongestionCtlType GetCCtype() override
+    {
+        switch (m_config.algo)
+        {
+            case CoupledCongestionCtlConfig::Algo::olia:
+                return CongestionCtlType::olia;
+            case CoupledCongestionCtlConfig::Algo::balia:
+                return CongestionCtlType::balia;
+            default:
+                return CongestionCtlType::lia;
+        }
+    }
+
+protected:
+    void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) override
+    {
+        if (rateSample > 0)
+        {
+            m_bwEstimate = m_bwEstimate * 0.875 + rateSample * 0.125;
+        }
+        m_subflow.srtt = rttstats.smoothed_rtt();
+        if (!m_minRtt.IsInfinite())
+        {
+            Duration qdelay = rttstats.latest_rtt() - m_minRtt;
+            m_group->OnQueueDelaySample(&m_subflow, ackEvent.recvtic, qdelay);
+        }
+        ++m_sinceLoss;
+        m_subflow.lossInterval = std::max(m_lastLossInterval, double(m_sinceLoss));
+
+        bool roundStart = false;
+        if (uint64_t(ackEvent.ackPacket.delivered) >= m_nextRoundDelivered)
+        {
+            m_nextRoundDelivered = m_delivered;
+            roundStart = true;
+        }
+        double& cwnd = m_subflow.cwnd;
+        if (cwnd < m_ssThresh)
+        {
+            // several subflows slow starting into one queue overshoot it together, leave before the losses
+            cwnd += m_hystart.OnAck(roundStart, rttstats.latest_rtt());
+            if (m_hystart.ShouldExit() || AboveCapacityBdp(cwnd))
+            {
+                m_ssThresh = cwnd;
+            }
+        }
+        else
+        {
+            switch (m_config.algo)
+            {
+                case CoupledCongestionCtlConfig::Algo::olia:
+                    cwnd += OliaIncrease();
+                    break;
+                case CoupledCongestionCtlConfig::Algo::balia:
+                    cwnd += BaliaIncrease();
+                    break;
+                default:
+                    cwnd += LiaIncrease();
+                    break;
+            }
+        }
+        cwnd = std::max(double(m_config.min_cwnd), std::min(cwnd, double(m_config.max_cwnd)));
+        m_cwnd = uint32_t(cwnd);
+    }
+
+    void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) override
+    {
+        Timepoint maxsentTic{ Timepoint::Zero() };
+        for (const auto& lostpkt: lossEvent.lossPackets)
+        {
+            maxsentTic = std::max(maxsentTic, lostpkt.sendtic);
+        }
+        if (lossEvent.lossPackets.size() < m_config.min_loss_cnt || !lossEvent.congestive
+            || (m_recoveryStart.IsInitialized() && maxsentTic <= m_recoveryStart))
+        {
+            return;
+        }
+        m_recoveryStart = lossEvent.losttic;
+        m_priorCwnd = m_subflow.cwnd;
+        m_priorSsThresh = m_ssThresh;
+        m_priorLossInterval = m_lastLossInterval;
+        m_lastLossInterval = double(m_sinceLoss);
+        m_sinceLoss = 0;
+
+        double& cwnd = m_subflow.cwnd;
+        double cut = 0.5;
+        if (m_config.algo == CoupledCongestionCtlConfig::Algo::balia)
+        {
+            // BALIA cuts by a_r / 2 with a_r = max_k x_k / x_r: the slower the path, the larger the cut, up to 3/4
+            double maxRate = 0;
+            m_group->ForEachCoupled(&m_subflow, [&maxRate](const CoupledSubflow& peer)
+            {
+                maxRate = std::max(maxRate, peer.Rate());
+            });
+            cut = 0.5 * std::min(maxRate / std::max(m_subflow.Rate(), 1e-9), 1.5);
+        }
+        cwnd = std::max(cwnd * (1 - cut), double(m_config.min_cwnd));
+        m_ssThresh = cwnd;
+        m_hystart.Reset();
+        m_cwnd = uint32_t(cwnd);
+        EnterRecovery();
+        SPDLOG_DEBUG("lost:{}, cwnd:{}, cluster:{}", lossEvent.lossPackets.size(), cwnd, m_subflow.cluster);
+    }
+
+    /// the loss interval OLIA ranks the paths by goes on from before the cut
+    void UndoCwndReduction(uint32_t priorCwnd) override
+    {
+        m_subflow.cwnd = std::max(m_subflow.cwnd, m_priorCwnd);
+        m_ssThresh = std::max(m_ssThresh, m_priorSsThresh);
+        m_sinceLoss += uint64_t(m_lastLossInterval);
+        m_lastLossInterval = m_priorLossInterval;
+        m_cwnd = uint32_t(m_subflow.cwnd);
+    }
+
+private:
+    bool InSlowStart() const override
+    {
+        return m_subflow.cwnd < m_ssThresh;
+    }
+
+    /// RFC 6356: min(alpha / total_cwnd, 1 / cwnd_i) per acked packet
+    double LiaIncrease() const
+    {
+        double total = 0, maxTerm = 0, sumRate = 0;
+        m_group->ForEachCoupled(&m_subflow, [&](const CoupledSubflow& peer)
+        {
+            double rtt = std::max<double>(peer.srtt.ToMicroseconds(), 1);
+            total += peer.cwnd;
+            maxTerm = std::max(maxTerm, peer.cwnd / (rtt * rtt));
+            sumRate += peer.Rate();
+        });
+        double alpha = total * maxTerm / (sumRate * sumRate);
+        return std::min(alpha / total, 1.0 / m_subflow.cwnd);
+    }
+
+    /// (w_r/rtt_r^2) / (sum w_p/rtt_p)^2 + alpha_r / w_r, alpha_r moves window from the largest to the best paths
+    double OliaIncrease() const
+    {
+        double sumRate = 0, bestQuality = 0, maxCwnd = 0;
+        size_t paths = 0;
+        auto quality = [](const CoupledSubflow& peer)
+        {
+            double rtt = std::max<double>(peer.srtt.ToMicroseconds(), 1);
+            return peer.lossInterval * peer.lossInterval / rtt;
+        };
+        m_group->ForEachCoupled(&m_subflow, [&](const CoupledSubflow& peer)
+        {
+            sumRate += peer.Rate();
+            bestQuality = std::max(bestQuality, quality(peer));
+            maxCwnd = std::max(maxCwnd, peer.cwnd);
+            ++paths;
+        });
+        size_t bestNotMax = 0, maxPaths = 0;
+        m_group->ForEachCoupled(&m_subflow, [&](const CoupledSubflow& peer)
+        {
+            bool best = quality(peer) >= bestQuality;
+            bool max = peer.cwnd >= maxCwnd;
+            bestNotMax += best && !max;
+            maxPaths += max;
+        });
+        bool selfBest = quality(m_subflow) >= bestQuality;
+        bool selfMax = m_subflow.cwnd >= maxCwnd;
+        double alpha = 0;
+        if (selfBest && !selfMax)
+        {
+            alpha = 1.0 / (paths * bestNotMax);
+        }
+        else if (selfMax && bestNotMax > 0)
+        {
+            alpha = -1.0 / (paths * maxPaths);
+        }
+        double rtt = std::max<double>(m_subflow.srtt.ToMicroseconds(), 1);
+        return (m_subflow.cwnd / (rtt * rtt)) / (sumRate * sumRate) + alpha / m_subflow.cwnd;
+    }
+
+    /// (x_r / (rtt_r (sum x)^2)) * ((1 + a_r) / 2) * ((4 + a_r) / 5), a_r = max x / x_r
+    double BaliaIncrease() const
+    {
+        double sumRate = 0, maxRate = 0;
+        m_group->ForEachCoupled(&m_subflow, [&](const CoupledSubflow& peer)
+        {
+            sumRate += peer.Rate();
+            maxRate = std::max(maxRate, peer.Rate());
+        });
+        double rate = std::max(m_subflow.Rate(), 1e-9);
+        double a = maxRate / rate;
+        double rtt = std::max<double>(m_subflow.srtt.ToMicroseconds(), 1);
+        return rate / (rtt * sumRate * sumRate) * ((1 + a) / 2) * ((4 + a) / 5);
+    }
+
+    CoupledCongestionCtlConfig m_config;
+    std::shared_ptr<CoupledCongestionGroup> m_group;
+    CoupledSubflow m_subflow;
+    double m_ssThresh{ std::numeric_limits<double>::max() };
+    HystartPlusPlus m_hystart;
+    uint64_t m_nextRoundDelivered{ 0 };
+    Timepoint m_recoveryStart{ Timepoint::Zero() };
+    uint64_t m_sinceLoss{ 0 };
+    double m_lastLossInterval{ 0 };
+    double m_priorCwnd{ 0 };/** the window, m_ssThresh and m_lastLossInterval before the last cut*/
+    double m_priorSsThresh{ 0 };
+    double m_priorLossInterval{ 0 };
+};
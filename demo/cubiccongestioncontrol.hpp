@@ -0,0 +1,189 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "congestioncontrol.hpp"
+
+/// config of CubicCongestionControl, windows are in packets
+struct CubicCongestionCtlConfig
+{
+    uint32_t init_cwnd{ 10 };
+    uint32_t min_cwnd{ 2 };
+    uint32_t max_cwnd{ 2000 };
+    uint32_t max_burst{ 8 };/** packets requested at once*/
+    double c{ 0.4 };/** cubic scaling constant, in packets/s^3*/
+    double beta{ 0.7 };/** window kept on a congestion event*/
+    bool fast_convergence{ true };
+    bool hystart{ true };/** HyStart++ delay based slow start exit*/
+    uint32_t min_loss_cnt{ 3 };/** a loss event with fewer lost packets does not reduce the window*/
+};
+
+/** @brief CUBIC (RFC 9438) with HyStart++ (RFC 9406) on the window only transport.
+ *  After a congestion event the window follows W(t) = C*(t-K)^3 + Wmax, concave up to the old maximum and then
+ *  convex beyond it, so a high BDP path is refilled in K seconds instead of Wmax RTTs as with Reno. The Reno
+ *  friendly estimate keeps it at least as fast as Reno on short RTTs. One reduction per recovery period: losses
+ *  of packets sent before the last reduction are part of the same event.
+ *  Slow start ends on the first congestion event, when HystartPlusPlus sees the queue building or at twice the
+ *  BDP of the packet train capacity.
+ * */
+class CubicCongestionControl final : public WindowCongestionCtlAlgo
+{
+public:
+    explicit CubicCongestionControl(const CubicCongestionCtlConfig& ccConfig)
+            : WindowCongestionCtlAlgo(ccConfig.init_cwnd, ccConfig.max_burst), m_config(ccConfig),
+              m_cwndF(ccConfig.init_cwnd)
+    {
+        SPDLOG_DEBUG("init_cwnd:{}, c:{}, beta:{}, hystart:{}", ccConfig.init_cwnd, ccConfig.c, ccConfig.beta,
+                ccConfig.hystart);
+    }
+
+    ~CubicCongestionControl() override
+    {
+        SPDLOG_DEBUG("");
+    }
+
+    CongestionCtlType GetCCtype() override
+    {
+        return CongestionCtlType::cubic;
+    }
+
+protected:
+    void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) override
+    {
+        if (rateSample > 0)
+        {
+            m_bwEstimate = m_bwEstimate * 0.875 + rateSample * 0.125;
+        }
+        bool roundStart = false;
+        if (uint64_t(ackEvent.ackPacket.delivered) >= m_nextRoundDelivered)
+        {
+            m_nextRoundDelivered = m_delivered;
+            roundStart = true;
+        }
+        if (InSlowStart())
+        {
+            SlowStart(roundStart, rttstats.latest_rtt());
+        }
+        else
+        {
+            CongestionAvoidance(ackEvent.recvtic);
+        }
+        m_cwndF = std::max(double(m_config.min_cwnd), std::min(m_cwndF, double(m_config.max_cwnd)));
+        m_cwnd = uint32_t(m_cwndF);
+    }
+
+    void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) override
+    {
+        Timepoint maxsentTic{ Timepoint::Zero() };
+        for (const auto& lostpkt: lossEvent.lossPackets)
+        {
+            maxsentTic = std::max(maxsentTic, lostpkt.sendtic);
+        }
+        if (lossEvent.lossPackets.size() < m_config.min_loss_cnt || !lossEvent.congestive
+            || (m_recoveryStart.IsInitialized() && maxsentTic <= m_recoveryStart))
+        {
+            // random loss, or still the congestion event already reacted to
+            return;
+        }
+        m_recoveryStart = lossEvent.losttic;
+        m_priorCwndF = m_cwndF;
+        m_priorSsThresh = m_ssThresh;
+        m_priorWMax = m_wMax;
+
+        // fast convergence, release bandwidth for new flows when the maximum keeps shrinking
+        if (m_config.fast_convergence && m_cwndF < m_wMax)
+        {
+            m_wMax = m_cwndF * (1 + m_config.beta) / 2;
+        }
+        else
+        {
+            m_wMax = m_cwndF;
+        }
+        m_cwndF = std::max(m_cwndF * m_config.beta, double(m_config.min_cwnd));
+        m_ssThresh = m_cwndF;
+        m_wEst = m_cwndF;
+        m_epochStart = Timepoint::Zero();
+        m_hystart.Reset();
+        m_cwnd = uint32_t(m_cwndF);
+        EnterRecovery();
+        SPDLOG_DEBUG("lost:{}, wmax:{}, cwnd:{}", lossEvent.lossPackets.size(), m_wMax, m_cwnd);
+    }
+
+    /// the cubic curve starts a new epoch from the window of before the cut
+    void UndoCwndReduction(uint32_t priorCwnd) override
+    {
+        m_cwndF = std::max(m_cwndF, m_priorCwndF);
+        m_ssThresh = std::max(m_ssThresh, m_priorSsThresh);
+        m_wMax = m_priorWMax;
+        m_epochStart = Timepoint::Zero();
+        m_cwnd = uint32_t(m_cwndF);
+    }
+
+private:
+    bool InSlowStart() const override
+    {
+        return m_cwndF < m_ssThresh;
+    }
+
+    void SlowStart(bool roundStart, Duration rtt)
+    {
+        if (!m_config.hystart)
+        {
+            m_cwndF += 1;
+        }
+        else
+        {
+            m_cwndF += m_hystart.OnAck(roundStart, rtt);
+        }
+        if ((m_config.hystart && m_hystart.ShouldExit()) || AboveCapacityBdp(m_cwndF))
+        {
+            SPDLOG_DEBUG("exit slow start, cwnd:{}", m_cwndF);
+            m_ssThresh = m_cwndF;
+        }
+    }
+
+    void CongestionAvoidance(Timepoint now)
+    {
+        if (!m_epochStart.IsInitialized())
+        {
+            m_epochStart = now;
+            if (m_wMax < m_cwndF)
+            {
+                // the window is past the last maximum, e.g. out of slow start, start on the convex side
+                m_wMax = m_cwndF;
+            }
+            m_k = std::cbrt((m_wMax - m_cwndF) / m_config.c);
+            m_wEst = m_cwndF;
+        }
+        double rttSec = m_minRtt.IsInfinite() ? 0.1 : m_minRtt.ToMicroseconds() / 1e6;
+        double t = (now - m_epochStart).ToMicroseconds() / 1e6 + rttSec;
+        double wCubic = m_config.c * std::pow(t - m_k, 3) + m_wMax;
+
+        // the window Reno would have, grown with alpha = 3(1-beta)/(1+beta) packets per RTT
+        m_wEst += 3 * (1 - m_config.beta) / (1 + m_config.beta) / m_cwndF;
+        if (wCubic < m_wEst)
+        {
+            m_cwndF = m_wEst;
+            return;
+        }
+        double target = std::max(m_cwndF, std::min(wCubic, m_cwndF * 1.5));
+        m_cwndF += (target - m_cwndF) / m_cwndF;
+    }
+
+    CubicCongestionCtlConfig m_config;
+    double m_cwndF;/** the window with its fraction, m_cwnd is its integer part*/
+    double m_ssThresh{ std::numeric_limits<double>::max() };
+    double m_wMax{ 0 };
+    double m_wEst{ 0 };
+    double m_priorCwndF{ 0 };/** m_cwndF, m_ssThresh and m_wMax before the last cut*/
+    double m_priorSsThresh{ 0 };
+    double m_priorWMax{ 0 };
+    double m_k{ 0 };
+    Timepoint m_epochStart{ Timepoint::Zero() };
+    Timepoint m_recoveryStart{ Timepoint::Zero() };
+
+    uint64_t m_nextRoundDelivered{ 0 };
+    HystartPlusPlus m_hystart;
+};
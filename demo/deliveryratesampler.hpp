@@ -0,0 +1,111 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+#include "packettype.h"
+
+/// one delivery rate sample, taken on an ack, rates are in packets per ms
+struct RateSample
+{
+    bool valid{ false };
+    double deliveryRate{ 0 };
+    uint64_t delivered{ 0 };/** packets delivered over the interval*/
+    uint64_t priorDelivered{ 0 };/** the total delivered when the acked packet was sent*/
+    Duration interval{ Duration::Zero() };
+    bool isAppLimited{ false };/** the sender ran out of pieces while the acked packet was in flight*/
+
+    std::string DebugInfo() const
+    {
+        std::stringstream ss;
+        ss << "valid: " << valid << " "
+           << "rate: " << deliveryRate << " "
+           << "delivered: " << delivered << " "
+           << "interval: " << interval.ToDebuggingValue() << " "
+           << "applimited: " << isAppLimited << " ";
+        return ss.str();
+    }
+};
+
+/** @brief Delivery rate estimation as in BBR (draft-cheng-iccrg-delivery-rate-estimation), per session.
+ *  Each sent packet is stamped with the delivered count, the time of the last delivery and the send time of the
+ *  packet that was acked last. The ack of the packet then yields delivered / max(send interval, ack interval),
+ *  the max keeps ack compression from showing a rate higher than the one the packets were sent at.
+ *  When the scheduler has no pieces for a session with a free window, OnAppLimited() marks the packets in flight
+ *  and the ones sent until they are acked, their samples only tell the rate the session was given, not the path's.
+ * */
+class DeliveryRateSampler
+{
+public:
+    void OnPacketSent(InflightPacket& sentpkt, uint32_t inflight)
+    {
+        if (inflight == 0 || !m_deliveredTic.IsInitialized())
+        {
+            // nothing in flight, the clocks restart at this send
+            m_firstSentTic = sentpkt.sendtic;
+            m_deliveredTic = sentpkt.sendtic;
+        }
+        sentpkt.delivered = int(m_delivered);
+        sentpkt.deliveredtic = m_deliveredTic;
+        sentpkt.firstsenttic = m_firstSentTic;
+        sentpkt.isAppLimited = m_appLimitedUntil != 0;
+    }
+
+    /// the session had a free window but nothing to send, the packets up to delivered + inflight are app limited
+    void OnAppLimited(uint32_t inflight)
+    {
+        m_appLimitedUntil = std::max<uint64_t>(m_delivered + inflight, 1);
+        SPDLOG_TRACE("app limited until:{}", m_appLimitedUntil);
+    }
+
+    RateSample OnPacketAcked(const InflightPacket& ackpkt, Timepoint recvtic)
+    {
+        ++m_delivered;
+        m_deliveredTic = recvtic;
+        if (m_appLimitedUntil != 0 && m_delivered > m_appLimitedUntil)
+        {
+            m_appLimitedUntil = 0;
+        }
+
+        RateSample rs;
+        if (!ackpkt.deliveredtic.IsInitialized())
+        {
+            return rs;
+        }
+        rs.priorDelivered = uint64_t(ackpkt.delivered);
+        rs.delivered = m_delivered - rs.priorDelivered;
+        rs.isAppLimited = ackpkt.isAppLimited;
+        Duration sendElapsed = ackpkt.sendtic - ackpkt.firstsenttic;
+        Duration ackElapsed = recvtic - ackpkt.deliveredtic;
+        // the next packets measure their send interval from this one
+        m_firstSentTic = ackpkt.sendtic;
+        rs.interval = std::max(sendElapsed, ackElapsed);
+        if (rs.interval > Duration::Zero())
+        {
+            rs.deliveryRate = double(rs.delivered) * 1000.0 / rs.interval.ToMicroseconds();
+            rs.valid = true;
+        }
+        SPDLOG_TRACE("rate sample:{}", rs.DebugInfo());
+        return rs;
+    }
+
+    uint64_t Delivered() const
+    {
+        return m_delivered;
+    }
+
+    bool IsAppLimited() const
+    {
+        return m_appLimitedUntil != 0;
+    }
+
+private:
+    uint64_t m_delivered{ 0 };
+    Timepoint m_deliveredTic{ Timepoint::Zero() };
+    Timepoint m_firstSentTic{ Timepoint::Zero() };
+    uint64_t m_appLimitedUntil{ 0 };/** 0 when not app limited*/
+};
@@ -13,7 +13,18 @@ std::string DemoTransportCtlConfig::DebugInfo()
     ss
             << "{"
             << "period:" << period << " peak_gain:" << peak_gain
-            << " }";
+            << " alpha:" << alpha << " probe_fail_cnt:" << probe_fail_cnt
+            << " max_probe_ms:" << max_probe_ms
+            << " gain_down:" << gain_down << " gain_up:" << gain_up
+            << " max_send_w:" << max_send_w << " botnec_ratio:" << botnec_ratio
+            << " cc:" << CongestionCtlTypeName(cc_type) << " background:" << background
+            << " shared_bottleneck:" << shared_bottleneck << " loss_check_ms:" << loss_check_ms
+            << " pacing_gain_cycle:[";
+    for (size_t i = 0; i < pacing_gain_cycle.size(); ++i)
+    {
+        ss << (i == 0 ? "" : ",") << pacing_gain_cycle[i];
+    }
+    ss << "] }";
     return ss.str();
 }
 
@@ -27,8 +38,22 @@ DemoTransportCtl::DemoTransportCtl(std::shared_ptr<TransPortControllerConfig> ct
     // renoccConfig.maxCwnd = m_transCtlConfig->maxWnd;
     // renoccConfig.ssThresh = m_transCtlConfig->slowStartThreshold;
 
-    oursccConfig.period = m_transCtlConfig->period;
-    oursccConfig.peak_gain = m_transCtlConfig->peak_gain;
+    ccConfig.ours.period = m_transCtlConfig->period;
+    ccConfig.ours.peak_gain = m_transCtlConfig->peak_gain;
+    ccConfig.ours.alpha = m_transCtlConfig->alpha;
+    ccConfig.ours.probe_fail_cnt = m_transCtlConfig->probe_fail_cnt;
+    ccConfig.ours.max_probe_ms = m_transCtlConfig->max_probe_ms;
+    ccConfig.ours.gain_down = m_transCtlConfig->gain_down;
+    ccConfig.ours.gain_up = m_transCtlConfig->gain_up;
+    ccConfig.ours.max_send_w = m_transCtlConfig->max_send_w;
+    // a background task only takes the capacity the foreground ones leave
+    ccConfig.type = m_transCtlConfig->background ? CongestionCtlType::ledbat : m_transCtlConfig->cc_type;
+    // one group per task, the coupled algorithms only couple sessions of the same download
+    CoupledCongestionGroupConfig groupConfig;
+    groupConfig.couple_all = m_transCtlConfig->shared_bottleneck;
+    ccConfig.coupled.group = std::make_shared<CoupledCongestionGroup>(groupConfig);
+    ccConfig.pacer.gain_cycle = m_transCtlConfig->pacing_gain_cycle;
+    rrConfig.botnec_ratio = m_transCtlConfig->botnec_ratio;
 
     SPDLOG_DEBUG("config:{}", m_transCtlConfig->DebugInfo());
 }
@@ -64,7 +89,8 @@ bool DemoTransportCtl::StartTransportController(TransportDownloadTaskInfo tansDl
     m_transctlHandler = transCtlHandler;
 
     m_multipathscheduler.reset(
-            new RRMultiPathScheduler(m_tansDlTkInfo.m_rid, m_sessStreamCtlMap, m_downloadPieces, m_lostPiecesl, m_waitDownloadPieces));
+            new RRMultiPathScheduler(m_tansDlTkInfo.m_rid, m_sessStreamCtlMap, m_downloadPieces, m_lostPiecesl, m_waitDownloadPieces,
+                    rrConfig));
     m_multipathscheduler->StartMultiPathScheduler(shared_from_this());
     return true;
 }
@@ -115,8 +141,8 @@ void DemoTransportCtl::OnSessionCreate(const fw::ID& sessionid)
     auto&& sessionItor = m_sessStreamCtlMap.find(sessionid);
     if (sessionItor == m_sessStreamCtlMap.end())
     {
-        m_sessStreamCtlMap[sessionid] = std::make_shared<SessionStreamController>();
-        m_sessStreamCtlMap[sessionid]->StartSessionStreamCtl(sessionid, oursccConfig, shared_from_this());
+        m_sessStreamCtlMap[sessionid] = MakeSessionStreamController(ccConfig);
+        m_sessStreamCtlMap[sessionid]->StartSessionStreamCtl(sessionid, shared_from_this());
     }
     else
     {
@@ -223,7 +249,8 @@ void DemoTransportCtl::OnDownloadTaskReset()
 void DemoTransportCtl::OnDataPiecesReceived(const fw::ID& sessionid, uint32_t seq, int32_t datapiece, uint64_t tic_us)
 {
     SPDLOG_TRACE("session = {}, seq ={},datapiece = {},tic_us = {}",sessionid.ToLogStr(),seq,datapiece,tic_us);
-    Timepoint recvtic = Clock::GetClock()->CreateTimeFromMicroseconds(tic_us);
+    ScopedEventTime eventTime;
+    Timepoint recvtic = EventClock::FromMicroseconds(tic_us);
     if (m_waitDownloadPieces.find(datapiece) != m_waitDownloadPieces.end()) {
         m_waitDownloadPieces.erase(datapiece);
         SPDLOG_DEBUG("{} piece has receved", datapiece);
@@ -268,7 +295,7 @@ void DemoTransportCtl::OnDataSent(const fw::ID& sessionid, const std::vector<int
     {
         sessStreamItor->second->OnDataRequestPktSent(
                 seqvec,
-                datapiecesvec, Clock::GetClock()->CreateTimeFromMicroseconds(senttime_us));
+                datapiecesvec, EventClock::FromMicroseconds(senttime_us));
     }
     else
     {
@@ -281,16 +308,36 @@ void DemoTransportCtl::OnDataSent(const fw::ID& sessionid, const std::vector<int
 void DemoTransportCtl::OnLossDetectionAlarm()
 {
     SPDLOG_TRACE("DemoTransportCtl::OnLossDetectionAlarm()");
+    ScopedEventTime eventTime;
+    auto alarmTic = EventClock::Now();
+    if (m_lastLossCheckTic.IsInitialized()
+        && alarmTic - m_lastLossCheckTic < Duration::FromMilliseconds(m_transCtlConfig->loss_check_ms))
+    {
+        // a pacing tick, only the paced sessions may have requests to release
+        for (auto&& sessStreamItor: m_sessStreamCtlMap)
+        {
+            if (sessStreamItor.second->IsPaced())
+            {
+                m_multipathscheduler->DoMultiPathSchedule();
+                break;
+            }
+        }
+        m_multipathscheduler->DoTailLossProbe();
+        m_multipathscheduler->DoStallProbe();
+        return;
+    }
+    m_lastLossCheckTic = alarmTic;
     // Step 1: Check loss in each session
     for (auto&& sessStreamItor: m_sessStreamCtlMap)
     {
         sessStreamItor.second->OnLossDetectionAlarm();
-        auto now = Clock::GetClock()->Now();
-        sessStreamItor.second->IsSleepEnough(now);
-        SPDLOG_DEBUG("now: {}", now.ToDebuggingValue());
     }
     // Step 2: Forward message to Multipath Scheduler
     m_multipathscheduler->DoMultiPathSchedule();
+    // Step 3: Probe the sessions that went silent with requests still in flight
+    m_multipathscheduler->DoTailLossProbe();
+    // Step 4: Probe the stalled sessions
+    m_multipathscheduler->DoStallProbe();
 }
 
 // session stream handler
@@ -358,21 +405,22 @@ bool DemoTransportCtl::OnGetByteRate(uint32_t& playbyterate)
     return false;
 }
 
-void DemoTransportCtl::OnRequestDownloadPieces(uint32_t maxpiececnt)
+bool DemoTransportCtl::OnRequestDownloadPieces(uint32_t maxpiececnt)
 {
     if (!isRunning)
     {
-        return;
+        return false;
     }
     // ask for more task pieces
     auto handler = m_transctlHandler.lock();
     if (handler)
     {
-        handler->DoRequestDatapiecesTask(maxpiececnt);
+        return handler->DoRequestDatapiecesTask(maxpiececnt);
     }
     else
     {
         SPDLOG_WARN("Handler = null");
+        return false;
     }
 }
 
@@ -22,6 +22,18 @@ public:
     // uint32_t slowStartThreshold{ 32 };
     uint32_t period{ 4 };
     double peak_gain{ 0.25 };
+    double alpha{ 0.1 };/** see OursCongestionCtlConfig*/
+    uint32_t probe_fail_cnt{ 3 };/** see OursCongestionCtlConfig*/
+    uint32_t max_probe_ms{ 1000 };
+    double gain_down{ 0.9 };
+    double gain_up{ 1.1 };
+    uint32_t max_send_w{ 8 };
+    double botnec_ratio{ 0.85 };/** see RRMultiPathSchedulerConfig*/
+    CongestionCtlType cc_type{ CongestionCtlType::ours };/** the congestion control of every session*/
+    bool background{ false };/** a prefetch task, all its sessions use ledbat whatever cc_type is*/
+    bool shared_bottleneck{ false };/** the sessions are known to share one bottleneck, lia/olia/balia couple all*/
+    uint32_t loss_check_ms{ 100 };/** loss detection period, the alarm comes more often to release paced requests*/
+    std::vector<double> pacing_gain_cycle;/** see PacerConfig*/
 
     std::string DebugInfo();
 };
@@ -117,7 +129,7 @@ public:
 
     bool OnGetByteRate(uint32_t& playbyterate) override;
 
-    void OnRequestDownloadPieces(uint32_t maxpiececnt) override;
+    bool OnRequestDownloadPieces(uint32_t maxpiececnt) override;
 
 private:
 
@@ -129,8 +141,10 @@ private:
     std::set<DataNumber> m_downloadPieces;/// main task download queue
     std::set<DataNumber> m_lostPiecesl;/// lost packets will be stored here till retransmission
     std::set<DataNumber> m_waitDownloadPieces;/// record the pieces which have not received
-    OursCongestionCtlConfig oursccConfig;/// congestion config file
+    CongestionCtlConfig ccConfig;/// congestion config file
+    RRMultiPathSchedulerConfig rrConfig;/// multipath scheduler config
     std::map<basefw::ID, std::shared_ptr<SessionStreamController>> m_sessStreamCtlMap;/// map session id to sessionstream
+    Timepoint m_lastLossCheckTic{ Timepoint::Zero() };/// the alarm that last ran the loss detection
 };
 
 /** @class A demo TransportController used to create DemoTransportCtl
@@ -142,4 +156,17 @@ public:
 
     std::shared_ptr<MPDTransportController>
     MakeTransportController(std::shared_ptr<TransPortControllerConfig> ctlConfig) override;
+};
+
+/** @brief Module settings for DemoTransportCtl, the alarm is finer than the default 100ms so that the pacers of the
+ *  sessions release their requests between the acks. The loss detection still runs every loss_check_ms.
+ * */
+struct DemoTransportModuleSettings : public TransportModuleSettings
+{
+    uint32_t alarm_interval_ms{ 20 };
+
+    uint32_t GetAlarmInterval() override
+    {
+        return alarm_interval_ms;
+    }
 };
\ No newline at end of file
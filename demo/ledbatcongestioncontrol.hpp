@@ -0,0 +1,248 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include "congestioncontrol.hpp"
+
+/// config of LedbatCongestionControl, windows are in packets
+struct LedbatCongestionCtlConfig
+{
+    uint32_t init_cwnd{ 4 };
+    uint32_t min_cwnd{ 2 };
+    uint32_t max_cwnd{ 2000 };
+    uint32_t max_burst{ 4 };/** packets requested at once*/
+    uint32_t target_ms{ 60 };/** queueing delay the transfer may add*/
+    uint32_t base_history{ 10 };/** base delay is the min of this many buckets*/
+    uint32_t base_bucket_ms{ 60000 };
+    uint32_t current_filter{ 4 };/** current delay is the min of this many latest samples*/
+    uint32_t slowdown_rtts{ 2 };/** the window stays at min_cwnd this many RTTs in a slowdown*/
+    uint32_t slowdown_interval{ 9 };/** the next slowdown is this many times the last one's length later*/
+    uint32_t min_loss_cnt{ 3 };/** a loss event with fewer lost packets does not reduce the window, as Reno*/
+};
+
+/** @brief LEDBAT++ (draft-irtf-iccrg-ledbat-plus-plus) for background transfers, which should only use spare
+ *  capacity. Queueing delay is the current RTT (min of the last few samples) minus the base RTT (min over
+ *  base_history buckets). Below target_ms the window grows, scaled by how far below; above it the window shrinks
+ *  multiplicatively, so a foreground flow filling the queue pushes it back within about one RTT. The gain is
+ *  1/min(16, ceil(2*target/base)) so that short RTT paths do not ramp faster than long ones.
+ *  Slow start ends at 3/4 of the target. Every so often a slowdown drops the window to min_cwnd for a couple of
+ *  RTTs, which lets the queue drain and the base delay be measured again, so competing LEDBAT flows do not
+ *  mistake each other's queue for the base delay.
+ * */
+class LedbatCongestionControl final : public WindowCongestionCtlAlgo
+{
+public:
+    explicit LedbatCongestionControl(const LedbatCongestionCtlConfig& ccConfig)
+            : WindowCongestionCtlAlgo(ccConfig.init_cwnd, ccConfig.max_burst), m_config(ccConfig),
+              m_cwndF(ccConfig.init_cwnd)
+    {
+        SPDLOG_DEBUG("init_cwnd:{}, target_ms:{}", ccConfig.init_cwnd, ccConfig.target_ms);
+    }
+
+    ~LedbatCongestionControl() override
+    {
+        SPDLOG_DEBUG("");
+    }
+
+    CongestionCtlType GetCCtype() override
+    {
+        return CongestionCtlType::ledbat;
+    }
+
+    Duration GetRtprop() override
+    {
+        return BaseDelay();
+    }
+
+protected:
+    void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) override
+    {
+        Timepoint now = ackEvent.recvtic;
+        Duration rtt = rttstats.latest_rtt();
+        if (rtt <= Duration::Zero())
+        {
+            return;
+        }
+        if (rateSample > 0)
+        {
+            m_bwEstimate = m_bwEstimate * 0.875 + rateSample * 0.125;
+        }
+        UpdateBaseDelay(now, rtt);
+        m_currentDelays.push_back(rtt);
+        if (m_currentDelays.size() > m_config.current_filter)
+        {
+            m_currentDelays.pop_front();
+        }
+        Duration current = *std::min_element(m_currentDelays.begin(), m_currentDelays.end());
+        Duration base = BaseDelay();
+        double qdelayRatio = double((current - base).ToMicroseconds()) / (m_config.target_ms * 1000.0);
+
+        bool roundStart = false;
+        if (uint64_t(ackEvent.ackPacket.delivered) >= m_nextRoundDelivered)
+        {
+            m_nextRoundDelivered = m_delivered;
+            ++m_roundCount;
+            roundStart = true;
+        }
+        if (roundStart)
+        {
+            OnRoundStart(now);
+        }
+
+        double gain = 1.0 / std::min(16.0, std::ceil(2.0 * m_config.target_ms * 1000.0
+                                                      / std::max<double>(base.ToMicroseconds(), 1)));
+        if (m_slowdownUntilRound > 0)
+        {
+            // hold the window down while the queue drains
+            m_cwndF = m_config.min_cwnd;
+        }
+        else if (m_cwndF < m_ssThresh)
+        {
+            if (qdelayRatio > 0.75)
+            {
+                ExitSlowStart(now, current);
+            }
+            else
+            {
+                m_cwndF += gain;
+            }
+        }
+        else if (qdelayRatio < 1)
+        {
+            m_cwndF += gain * (1 - qdelayRatio) / m_cwndF;
+        }
+        else
+        {
+            // above the target, decrease by up to half a window per RTT
+            m_cwndF += std::max(gain - m_cwndF * (qdelayRatio - 1), -m_cwndF / 2) / m_cwndF;
+        }
+        m_cwndF = std::max(double(m_config.min_cwnd), std::min(m_cwndF, double(m_config.max_cwnd)));
+        m_cwnd = uint32_t(m_cwndF);
+        SPDLOG_TRACE("cwnd:{}, qdelay ratio:{}, gain:{}", m_cwndF, qdelayRatio, gain);
+    }
+
+    void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) override
+    {
+        Timepoint maxsentTic{ Timepoint::Zero() };
+        for (const auto& lostpkt: lossEvent.lossPackets)
+        {
+            maxsentTic = std::max(maxsentTic, lostpkt.sendtic);
+        }
+        if (lossEvent.lossPackets.size() < m_config.min_loss_cnt || !lossEvent.congestive
+            || (m_recoveryStart.IsInitialized() && maxsentTic <= m_recoveryStart))
+        {
+            return;
+        }
+        // once per RTT, the delay has usually made the flow yield before the queue overflows
+        m_recoveryStart = lossEvent.losttic;
+        m_priorCwndF = m_cwndF;
+        m_priorSsThresh = m_ssThresh;
+        m_cwndF = std::max(m_cwndF / 2, double(m_config.min_cwnd));
+        if (m_cwndF < m_ssThresh)
+        {
+            m_ssThresh = m_cwndF;
+        }
+        m_cwnd = uint32_t(m_cwndF);
+        SPDLOG_DEBUG("lost:{}, cwnd:{}", lossEvent.lossPackets.size(), m_cwndF);
+    }
+
+    void UndoCwndReduction(uint32_t priorCwnd) override
+    {
+        m_cwndF = std::max(m_cwndF, m_priorCwndF);
+        m_ssThresh = std::max(m_ssThresh, m_priorSsThresh);
+        m_cwnd = uint32_t(m_cwndF);
+    }
+
+private:
+    bool InSlowStart() const override
+    {
+        return m_cwndF < m_ssThresh;
+    }
+
+    Duration BaseDelay() const
+    {
+        Duration base = Duration::Infinite();
+        for (const auto& bucket: m_baseDelays)
+        {
+            base = std::min(base, bucket.second);
+        }
+        return base;
+    }
+
+    void UpdateBaseDelay(Timepoint now, Duration rtt)
+    {
+        int64_t bucket = now.ToDebuggingValue() / (int64_t(m_config.base_bucket_ms) * 1000);
+        if (m_baseDelays.empty() || m_baseDelays.back().first != bucket)
+        {
+            m_baseDelays.emplace_back(bucket, rtt);
+            if (m_baseDelays.size() > m_config.base_history)
+            {
+                m_baseDelays.pop_front();
+            }
+        }
+        else
+        {
+            m_baseDelays.back().second = std::min(m_baseDelays.back().second, rtt);
+        }
+    }
+
+    void ExitSlowStart(Timepoint now, Duration rtt)
+    {
+        m_ssThresh = m_cwndF;
+        if (!m_slowdownStart.IsInitialized() && !m_nextSlowdownAt.IsInitialized())
+        {
+            // the first slowdown comes two RTTs after the initial slow start
+            m_nextSlowdownAt = now + rtt * 2;
+        }
+        SPDLOG_DEBUG("exit slow start, cwnd:{}", m_cwndF);
+    }
+
+    void OnRoundStart(Timepoint now)
+    {
+        if (m_slowdownUntilRound > 0)
+        {
+            if (m_roundCount >= m_slowdownUntilRound)
+            {
+                // slow start back to where the window was
+                m_slowdownUntilRound = 0;
+                m_ssThresh = m_slowdownCwnd;
+                m_rampingUp = true;
+            }
+            return;
+        }
+        if (m_rampingUp && m_cwndF >= m_ssThresh)
+        {
+            // the slowdown with its ramp up took this long, the next one is 9 times that away
+            m_rampingUp = false;
+            m_nextSlowdownAt = now + (now - m_slowdownStart) * int(m_config.slowdown_interval);
+        }
+        if (m_nextSlowdownAt.IsInitialized() && now >= m_nextSlowdownAt)
+        {
+            m_slowdownCwnd = m_cwndF;
+            m_slowdownStart = now;
+            m_slowdownUntilRound = m_roundCount + m_config.slowdown_rtts;
+            m_nextSlowdownAt = Timepoint::Zero();
+            SPDLOG_DEBUG("slowdown, cwnd:{}", m_cwndF);
+        }
+    }
+
+    LedbatCongestionCtlConfig m_config;
+    double m_cwndF;/** the window with its fraction, m_cwnd is its integer part*/
+    double m_ssThresh{ std::numeric_limits<double>::max() };
+    double m_priorCwndF{ 0 };/** m_cwndF and m_ssThresh before the last cut*/
+    double m_priorSsThresh{ 0 };
+    std::deque<std::pair<int64_t, Duration>> m_baseDelays;/** (bucket, min rtt in it)*/
+    std::deque<Duration> m_currentDelays;
+    Timepoint m_recoveryStart{ Timepoint::Zero() };
+
+    uint64_t m_roundCount{ 0 };
+    uint64_t m_nextRoundDelivered{ 0 };
+    uint64_t m_slowdownUntilRound{ 0 };/** 0 when not in a slowdown*/
+    bool m_rampingUp{ false };/** slow starting back after a slowdown*/
+    double m_slowdownCwnd{ 0 };
+    Timepoint m_slowdownStart{ Timepoint::Zero() };
+    Timepoint m_nextSlowdownAt{ Timepoint::Zero() };/** zero when no slowdown is scheduled*/
+};
@@ -0,0 +1,163 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+#include "packettype.h"
+
+/// config of LossClassifier
+struct LossClassifierConfig
+{
+    uint32_t history_ms{ 2000 };/** RTT samples are kept this long, by the send time of their packet*/
+    uint32_t neighbours{ 8 };/** a lost packet is judged by the RTTs of this many packets sent just before it*/
+    double spike_ratio{ 0.25 };/** queueing delay above this share of its recent max, the queue was filling*/
+    double min_queue_ratio{ 0.1 };/** a queueing delay below this share of the min RTT is never a full queue*/
+    double trend_ratio{ 0.1 };/** the RTT rose by this share of the min RTT over the neighbours, the queue was growing*/
+    uint32_t burst_run{ 3 };/** consecutive sequence numbers of this many requests lost together is a queue overflow*/
+};
+
+/** @brief Tells congestive from random loss, so that a lossy wireless hop does not keep the window down.
+ *  A queue that overflows drops packets when it is full: the packets sent just before a lost one saw a queueing
+ *  delay near its recent max or a rising RTT, and the drops come in runs of consecutive packets. A random loss
+ *  hits a packet whose neighbours crossed a short queue, alone, or the request itself, which loses all the pieces of
+ *  that request: a run only counts the requests it spans. A loss is random only if none of these holds and a
+ *  packet sent after it was acked, without that the path may be down and the loss stays congestive. An event is
+ *  congestive if any of its packets is.
+ * */
+class LossClassifier
+{
+public:
+    explicit LossClassifier(const LossClassifierConfig& config = LossClassifierConfig())
+            : m_config(config)
+    {
+    }
+
+    void OnPacketAcked(const InflightPacket& ackpkt, Duration rtt)
+    {
+        if (rtt <= Duration::Zero())
+        {
+            return;
+        }
+        m_samples.push_back({ ackpkt.sendtic, rtt });
+        m_lastAckedSendtic = std::max(m_lastAckedSendtic, ackpkt.sendtic);
+        Duration history = Duration::FromMilliseconds(m_config.history_ms);
+        while (m_samples.front().sendtic + history < m_lastAckedSendtic)
+        {
+            m_samples.pop_front();
+        }
+    }
+
+    /// true if the lost packets were dropped by a full queue, minRtt is the current min RTT of the session
+    bool IsCongestive(const std::vector<InflightPacket>& lossPackets, Duration minRtt) const
+    {
+        if (lossPackets.empty())
+        {
+            return false;
+        }
+        if (minRtt <= Duration::Zero() || minRtt.IsInfinite() || m_samples.empty())
+        {
+            return true;
+        }
+        if (MaxRun(lossPackets) >= m_config.burst_run)
+        {
+            SPDLOG_DEBUG("burst of {} losses", MaxRun(lossPackets));
+            return true;
+        }
+        Duration maxQdelay = Duration::Zero();
+        for (const auto& sample: m_samples)
+        {
+            maxQdelay = std::max(maxQdelay, sample.rtt - minRtt);
+        }
+        for (const auto& lostpkt: lossPackets)
+        {
+            if (IsCongestive(lostpkt, minRtt, maxQdelay))
+            {
+                return true;
+            }
+        }
+        SPDLOG_DEBUG("random loss of {} packets, max qdelay:{}", lossPackets.size(), maxQdelay.ToDebuggingValue());
+        return false;
+    }
+
+private:
+    struct RttSample
+    {
+        Timepoint sendtic;
+        Duration rtt;
+    };
+
+    bool IsCongestive(const InflightPacket& lostpkt, Duration minRtt, Duration maxQdelay) const
+    {
+        if (lostpkt.sendtic >= m_lastAckedSendtic)
+        {
+            // nothing sent after it came back yet
+            return true;
+        }
+        // the samples are in ack order, which is about send order
+        Duration first = Duration::Zero();
+        Duration last = Duration::Zero();
+        Duration sum = Duration::Zero();
+        uint32_t cnt = 0;
+        for (auto itor = m_samples.rbegin(); itor != m_samples.rend() && cnt < m_config.neighbours; ++itor)
+        {
+            if (itor->sendtic > lostpkt.sendtic)
+            {
+                continue;
+            }
+            if (cnt == 0)
+            {
+                last = itor->rtt;
+            }
+            first = itor->rtt;
+            sum = sum + itor->rtt;
+            ++cnt;
+        }
+        if (cnt == 0)
+        {
+            return true;
+        }
+        Duration qdelay = sum * (1.0 / cnt) - minRtt;
+        bool spike = qdelay.ToMicroseconds() >= m_config.spike_ratio * maxQdelay.ToMicroseconds()
+                     && qdelay.ToMicroseconds() >= m_config.min_queue_ratio * minRtt.ToMicroseconds();
+        bool rising = (last - first).ToMicroseconds() >= m_config.trend_ratio * minRtt.ToMicroseconds();
+        SPDLOG_TRACE("lost seq:{}, qdelay:{}, spike:{}, rising:{}", lostpkt.seq, qdelay.ToDebuggingValue(), spike,
+                rising);
+        return spike || rising;
+    }
+
+    /// longest run of consecutive sequence numbers among the lost packets, in requests
+    static uint32_t MaxRun(const std::vector<InflightPacket>& lossPackets)
+    {
+        std::vector<std::pair<SeqNumber, uint32_t>> seqs;
+        seqs.reserve(lossPackets.size());
+        for (const auto& lostpkt: lossPackets)
+        {
+            seqs.emplace_back(lostpkt.seq, lostpkt.groupId);
+        }
+        std::sort(seqs.begin(), seqs.end());
+        uint32_t maxRun = 1;
+        uint32_t run = 1;
+        for (size_t i = 1; i < seqs.size(); ++i)
+        {
+            if (seqs[i].first != seqs[i - 1].first + 1)
+            {
+                run = 1;
+            }
+            else if (seqs[i].second != seqs[i - 1].second)
+            {
+                ++run;
+            }
+            maxRun = std::max(maxRun, run);
+        }
+        return maxRun;
+    }
+
+    LossClassifierConfig m_config;
+    std::deque<RttSample> m_samples;
+    Timepoint m_lastAckedSendtic{ Timepoint::Zero() };
+};
@@ -22,7 +22,7 @@ public:
 
     virtual bool OnGetByteRate(uint32_t& playbyterate) = 0; // bytes per second
 
-    virtual void OnRequestDownloadPieces(uint32_t maxsubpiececnt) = 0; // ask for more subpieces
+    virtual bool OnRequestDownloadPieces(uint32_t maxsubpiececnt) = 0; // ask for more subpieces, false if none will come
 
     virtual ~MultiPathSchedulerHandler() = default;
 };
@@ -65,6 +65,12 @@ public:
 
     virtual int32_t DoSendSessionSubTask(const fw::ID& sessionid) = 0;
 
+    /// re-request a piece of each session that went silent with packets in flight
+    virtual void DoTailLossProbe() = 0;
+
+    /// send the due probes of the stalled sessions, the queue of a dead one goes to the others
+    virtual void DoStallProbe() = 0;
+
     virtual ~MultiPathSchedulerAlgo() = default;
 
 protected:
@@ -0,0 +1,101 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+
+/// config of Pacer
+struct PacerConfig
+{
+    uint32_t max_burst{ 4 };/** packets the bucket holds, requested back to back after an idle time*/
+    std::vector<double> gain_cycle;/** gains applied to the pacing rate in turn, one smoothed RTT each, empty for none*/
+};
+
+/** @brief Spreads the data requests of a session over time, at the pacing rate of the congestion control.
+ *  A token bucket fills at the pacing rate and holds at most max_burst packets, a request takes one token per
+ *  piece. The bucket is filled on each call, which comes on every received packet and on every alarm, the demo
+ *  controller runs the alarm every few ms so that a paced session does not wait for the next ack. A window only
+ *  limit lets a whole window go at once and its responses come back as a line rate burst that overflows a
+ *  shallow bottleneck queue, the bucket lets out max_burst packets at most.
+ *  An algorithm that does not pace has a pacing rate of 0, only its window limits it then.
+ *  With a gain cycle the rate is multiplied by each gain for one smoothed RTT in turn, like the PROBE_BW cycle of
+ *  BBR, e.g. {1.25, 0.75, 1, 1} probes for more bandwidth and drains the queue it built in the next RTT.
+ * */
+class Pacer
+{
+public:
+    explicit Pacer(const PacerConfig& config = PacerConfig())
+            : m_config(config)
+    {
+    }
+
+    bool CanSend(uint32_t cwnd, uint32_t downloadingPktCnt)
+    {
+        auto rt = cwnd > downloadingPktCnt;
+        SPDLOG_TRACE("cwnd:{},downloadingPktCnt:{},rt: {}", cwnd, downloadingPktCnt, rt);
+        return rt;
+    }
+
+    /// how many of the cnt packets the window allows may be requested now, pacingRate is in packets per ms
+    uint32_t PacedPktCnt(uint32_t cnt, double pacingRate, Timepoint now, uint32_t downloadingPktCnt, Duration srtt)
+    {
+        if (pacingRate <= 0)
+        {
+            return cnt;
+        }
+        double rate = pacingRate * CycleGain(now, srtt);
+        if (!m_lastRefillTic.IsInitialized())
+        {
+            m_tokens = m_config.max_burst;
+        }
+        else if (now > m_lastRefillTic)
+        {
+            m_tokens += rate * (now - m_lastRefillTic).ToMicroseconds() / 1000.0;
+        }
+        m_tokens = std::min(m_tokens, double(m_config.max_burst));
+        m_lastRefillTic = now;
+        uint32_t paced = uint32_t(m_tokens);
+        if (paced == 0 && downloadingPktCnt == 0)
+        {
+            // nothing in flight, no ack would come to try again
+            paced = 1;
+        }
+        SPDLOG_TRACE("cnt:{}, rate:{}, tokens:{}, paced:{}", cnt, rate, m_tokens, paced);
+        return std::min(cnt, paced);
+    }
+
+    void OnPacedSent(uint32_t cnt)
+    {
+        m_tokens = std::max(m_tokens - cnt, 0.0);
+    }
+
+private:
+    double CycleGain(Timepoint now, Duration srtt)
+    {
+        if (m_config.gain_cycle.empty())
+        {
+            return 1.0;
+        }
+        if (!m_phaseStart.IsInitialized())
+        {
+            m_phaseStart = now;
+        }
+        else if (srtt > Duration::Zero() && now - m_phaseStart >= srtt)
+        {
+            m_phase = (m_phase + 1) % m_config.gain_cycle.size();
+            m_phaseStart = now;
+            SPDLOG_TRACE("pacing gain:{}", m_config.gain_cycle[m_phase]);
+        }
+        return m_config.gain_cycle[m_phase];
+    }
+
+    PacerConfig m_config;
+    double m_tokens{ 0 };/** packets that may be requested now*/
+    Timepoint m_lastRefillTic{ Timepoint::Zero() };
+    size_t m_phase{ 0 };
+    Timepoint m_phaseStart{ Timepoint::Zero() };
+};
@@ -0,0 +1,145 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+#include "packettype.h"
+
+/// config of PacketTrainEstimator
+struct PacketTrainEstimatorConfig
+{
+    uint32_t min_train_len{ 3 };/** shorter trains are not used*/
+    uint32_t min_gap_us{ 20 };/** a train arriving faster than this per packet was compressed on the way back*/
+    double max_send_spread{ 0.5 };/** the train was not back to back if it left over more than this share of its dispersion*/
+    uint32_t sample_window{ 9 };/** the estimate is the median of this many latest samples*/
+    uint32_t max_open_trains{ 64 };/** older trains still waiting for packets are dropped*/
+};
+
+/** @brief Capacity estimation from the dispersion of packet trains.
+ *  The pieces of one request are sent back to back and share a groupId. The bottleneck spaces them out by its
+ *  per packet service time, so a train of n packets that arrives over d ms measures (n-1)/d packets per ms even in
+ *  the first RTT. A train with a lost packet is dropped, as is one that left the sender spread out or arrived
+ *  closer than min_gap_us per packet (ack compression). Cross traffic queued between the packets lowers a sample,
+ *  compression raises it, the median of the latest samples discards both.
+ * */
+class PacketTrainEstimator
+{
+public:
+    explicit PacketTrainEstimator(const PacketTrainEstimatorConfig& config = PacketTrainEstimatorConfig())
+            : m_config(config)
+    {
+    }
+
+    void OnPacketSent(const InflightPacket& sentpkt)
+    {
+        auto& train = m_trains[sentpkt.groupId];
+        if (train.sent == 0)
+        {
+            train.firstSendtic = sentpkt.sendtic;
+        }
+        train.lastSendtic = std::max(train.lastSendtic, sentpkt.sendtic);
+        ++train.sent;
+        while (m_trains.size() > m_config.max_open_trains)
+        {
+            m_trains.erase(m_trains.begin());
+        }
+    }
+
+    /// true if the ack completed a train that gave a new sample
+    bool OnPacketAcked(const InflightPacket& ackpkt, Timepoint recvtic)
+    {
+        auto itor = m_trains.find(ackpkt.groupId);
+        if (itor == m_trains.end())
+        {
+            return false;
+        }
+        auto& train = itor->second;
+        if (train.acked == 0)
+        {
+            train.firstRecvtic = recvtic;
+            train.lastRecvtic = recvtic;
+        }
+        train.firstRecvtic = std::min(train.firstRecvtic, recvtic);
+        train.lastRecvtic = std::max(train.lastRecvtic, recvtic);
+        ++train.acked;
+        if (train.acked < train.sent)
+        {
+            return false;
+        }
+        bool sampled = OnTrainDone(train);
+        m_trains.erase(itor);
+        return sampled;
+    }
+
+    void OnPacketLost(const InflightPacket& lostpkt)
+    {
+        m_trains.erase(lostpkt.groupId);
+    }
+
+    /// the samples of the old path are dropped, the trains in flight are kept
+    void ClearSamples()
+    {
+        m_samples.clear();
+    }
+
+    /// bottleneck capacity in packets per ms, 0 before the first sample
+    double CapacityEstimate() const
+    {
+        if (m_samples.empty())
+        {
+            return 0;
+        }
+        std::vector<double> sorted(m_samples.begin(), m_samples.end());
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+
+private:
+    struct Train
+    {
+        uint32_t sent{ 0 };
+        uint32_t acked{ 0 };
+        Timepoint firstSendtic{ Timepoint::Zero() };
+        Timepoint lastSendtic{ Timepoint::Zero() };
+        Timepoint firstRecvtic{ Timepoint::Zero() };
+        Timepoint lastRecvtic{ Timepoint::Zero() };
+    };
+
+    bool OnTrainDone(const Train& train)
+    {
+        if (train.acked < m_config.min_train_len)
+        {
+            return false;
+        }
+        Duration dispersion = train.lastRecvtic - train.firstRecvtic;
+        if (dispersion.ToMicroseconds() < int64_t(m_config.min_gap_us) * (train.acked - 1))
+        {
+            SPDLOG_TRACE("compressed train, dispersion:{}", dispersion.ToDebuggingValue());
+            return false;
+        }
+        Duration sendSpread = train.lastSendtic - train.firstSendtic;
+        if (sendSpread.ToMicroseconds() > m_config.max_send_spread * dispersion.ToMicroseconds())
+        {
+            SPDLOG_TRACE("spread train, send spread:{}", sendSpread.ToDebuggingValue());
+            return false;
+        }
+        double capacity = double(train.acked - 1) * 1000.0 / dispersion.ToMicroseconds();
+        m_samples.push_back(capacity);
+        if (m_samples.size() > m_config.sample_window)
+        {
+            m_samples.pop_front();
+        }
+        SPDLOG_TRACE("train:{} pkts over {}, capacity:{}", train.acked, dispersion.ToDebuggingValue(), capacity);
+        return true;
+    }
+
+    PacketTrainEstimatorConfig m_config;
+    std::map<uint32_t, Train> m_trains;/** groupId -> the train of that request*/
+    std::deque<double> m_samples;
+};
@@ -17,12 +17,24 @@ struct DataPacket
     virtual ~DataPacket() = default;
 };
 
+/// what a congestion control algorithm stamps on a packet when it is sent, it comes back in the ack or loss event
+/// of the packet and goes away with its inflight record
+struct CongestionCtlPacketState
+{
+    uint32_t cwnd{ 0 };/** congestion window when the packet was sent*/
+    uint32_t inflight{ 0 };/** packets in flight when it was sent, itself included*/
+};
+
 struct InflightPacket : DataPacket
 {
     Timepoint sendtic{ Timepoint::Zero() };
+    CongestionCtlPacketState ccState;
+
+    int delivered{ 0 };/** packets the session had delivered when this was sent*/
+    Timepoint deliveredtic{ Timepoint::Zero() };/** when the session last counted a delivery before this was sent*/
+    Timepoint firstsenttic{ Timepoint::Zero() };/** send time of the last acked packet when this was sent*/
+    bool isAppLimited{ false };
 
-    int delivered{ 0 };
-    
 
     friend std::ostream& operator<<(std::ostream& os, const InflightPacket& pkt)
     {
@@ -75,6 +87,13 @@ public:
         inflightPacket.pieceId = p.pieceId;
         inflightPacket.groupId = p.groupId;
         inflightPacket.sendtic = sendtic;
+        AddSentPacket(inflightPacket);
+    }
+
+    /// keep the packet as it is, including the state the congestion control stamped on it when sent
+    void AddSentPacket(const InflightPacket& inflightPacket)
+    {
+        const auto& p = inflightPacket;
         auto&& itor_pair = inflightPktMap.emplace(std::make_pair(p.seq, p.pieceId), inflightPacket);
         if (!itor_pair.second)
         {
@@ -90,7 +109,10 @@ public:
                     MaxSeqInflightPkt().DebugInfo(), MaxSeqAckedPkt().DebugInfo());
         }
 
-        SPDLOG_TRACE("Sent seq:{}, map now:{}", p.seq, DebugInfo());
+        if (BASEFW_LOG_ENABLED(spdlog::level::trace))
+        {
+            SPDLOG_TRACE("Sent seq:{}, map now:{}", p.seq, DebugInfo());
+        }
     }
 
     void OnPacktReceived(InflightPacket& p, QuicTime recvtic)
@@ -117,7 +139,10 @@ public:
         }
 
 
-        SPDLOG_TRACE("Recv seq:{}, map now:{}", p.seq, DebugInfo());
+        if (BASEFW_LOG_ENABLED(spdlog::level::trace))
+        {
+            SPDLOG_TRACE("Recv seq:{}, map now:{}", p.seq, DebugInfo());
+        }
     }
 
     // packet is marked as lost
@@ -134,7 +159,10 @@ public:
         {
             SPDLOG_WARN("Remove a pkt with unknown seq {}", p.seq);
         }
-        SPDLOG_TRACE("remove seq:{}, map now:{}", p.seq, DebugInfo());
+        if (BASEFW_LOG_ENABLED(spdlog::level::trace))
+        {
+            SPDLOG_TRACE("remove seq:{}, map now:{}", p.seq, DebugInfo());
+        }
     }
 
     size_t InFlightPktNum() const
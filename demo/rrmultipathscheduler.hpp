@@ -3,6 +3,7 @@
 #pragma once
 
 
+#include <algorithm>
 #include <vector>
 #include <set>
 #include "basefw/base/log.h"
@@ -10,6 +11,12 @@
 #include <numeric>
 
 
+/// config of RRMultiPathScheduler
+struct RRMultiPathSchedulerConfig
+{
+    double botnec_ratio{ 0.85 };/** a session slower than this ratio of the fastest one is behind a bottleneck*/
+};
+
 /// min RTT Round Robin multipath scheduler
 class RRMultiPathScheduler : public MultiPathSchedulerAlgo
 {
@@ -21,8 +28,10 @@ public:
 
     explicit RRMultiPathScheduler(const fw::ID& taskid,
             std::map<fw::ID, fw::shared_ptr<SessionStreamController>>& dlsessionmap,
-            std::set<DataNumber>& downloadQueue, std::set<int32_t>& lostPiecesQueue, std::set<DataNumber>& waitDownloadPieces)
-            : MultiPathSchedulerAlgo(taskid, dlsessionmap, downloadQueue, lostPiecesQueue, waitDownloadPieces)
+            std::set<DataNumber>& downloadQueue, std::set<int32_t>& lostPiecesQueue, std::set<DataNumber>& waitDownloadPieces,
+            const RRMultiPathSchedulerConfig& config = RRMultiPathSchedulerConfig())
+            : MultiPathSchedulerAlgo(taskid, dlsessionmap, downloadQueue, lostPiecesQueue, waitDownloadPieces),
+              m_config(config)
     {
         SPDLOG_DEBUG("taskid :{}", taskid.ToLogStr());
     }
@@ -139,12 +148,13 @@ public:
             return -1;
         }
 
+        bool morePieces = true;
         if (m_downloadQueue.size() < uni32DataReqCnt)
         {
             auto handler = m_phandler.lock();
             if (handler)
             {
-                handler->OnRequestDownloadPieces(uni32DataReqCnt - m_downloadQueue.size());
+                morePieces = handler->OnRequestDownloadPieces(uni32DataReqCnt - m_downloadQueue.size());
             }
             else
             {
@@ -161,6 +171,12 @@ public:
             m_downloadQueue.erase(itr++);
             --uni32DataReqCnt;
         }
+        if (uni32DataReqCnt > 0 && !morePieces)
+        {
+            // the application has no more pieces for the free window, what this session delivers now is not
+            // its path's rate. A shortfall the application is about to fill is not, the pieces come next.
+            session->OnAppLimited();
+        }
 
         m_session_needdownloadpieceQ[sessionid].insert(vecSubpieceNums.begin(), vecSubpieceNums.end());
 
@@ -192,22 +208,29 @@ public:
         SPDLOG_DEBUG("session:{}, seq:{}, pno:{}, recvtime:{}",
                 sessionid.ToLogStr(), seq, pno, recvtime.ToDebuggingValue());
         /// rx and tx signal are forwarded directly from transport controller to session controller
-        double nowRate = 0;
         m_btlBws[sessionid] = m_dlsessionmap[sessionid]->GetSessBw();
-        if (lastRecvTime != Timepoint::Zero()) {
-            recvDur = 0.9 * recvDur + 0.1 * (recvtime - lastRecvTime);
-            nowRate = double(1)*1000 / recvDur.ToMicroseconds();
-            botBw = nowRate;
-            // if (isBotnec(sessionid)) {
-            //     SPDLOG_DEBUG("session bw is not the bottle neck");
-            // }
-            if (botBw > maxBotBw) {
-                maxBotBw = botBw;
-            }
+        // the task's rate is the sum of the sessions' delivery rates, each one ignores its app limited samples
+        botBw = 0;
+        for (auto&& itor: m_dlsessionmap) {
+            botBw += itor.second->GetDeliveryRate();
+        }
+        auto pathChangeCnt = m_dlsessionmap[sessionid]->GetPathChangeCnt();
+        if (pathChangeCnt != m_pathChangeCnts[sessionid]) {
+            // the session is on a new path, the peak rate of the old one no longer tells the task's rate
+            m_pathChangeCnts[sessionid] = pathChangeCnt;
+            maxBotBw = botBw;
+        }
+        if (botBw > maxBotBw) {
+            maxBotBw = botBw;
+        }
+        SPDLOG_DEBUG("botBw: {}, maxBotBw: {}", botBw, maxBotBw);
+
+        auto spuriousLossCnt = m_dlsessionmap[sessionid]->GetSpuriousLossCnt();
+        if (spuriousLossCnt != m_spuriousLossCnts[sessionid]) {
+            // this piece was declared lost by the session, a retransmission of it may still be queued
+            m_spuriousLossCnts[sessionid] = spuriousLossCnt;
+            CancelRetransmission(pno);
         }
-        lastRecvTime = recvtime;
-        SPDLOG_DEBUG("nowRate: {}, botBw: {}, maxBotBw: {}", nowRate, botBw, maxBotBw);
-        
         SetLogicBw();
         DoSinglePathSchedule(sessionid);
     }
@@ -224,7 +247,161 @@ public:
 
     }
 
+    /** The highest piece in flight on a silent session that is still missing goes out again on the active session
+     *  of least RTT that is not silent too, or on the silent one if it is active. Its arrival delivers the tail of the download a
+     *  loss timeout earlier, on the silent session it also has the loss detection run at once.
+     * */
+    void DoTailLossProbe() override
+    {
+        Timepoint now = EventClock::Now();
+        for (auto&& itor: m_dlsessionmap)
+        {
+            auto& silentSession = itor.second;
+            if (!silentSession->TailLossProbeDue(now))
+            {
+                continue;
+            }
+            silentSession->OnTailLossProbe(now);
+            DataNumber piece = -1;
+            for (auto pno: silentSession->GetInFlightPieces())
+            {
+                if (m_waitDownloadPieces.find(pno) != m_waitDownloadPieces.end())
+                {
+                    piece = pno;
+                    break;
+                }
+            }
+            if (piece < 0)
+            {
+                continue;
+            }
+            // a stalled session only sends the probes DoStallProbe gives it
+            fw::shared_ptr<SessionStreamController> probeSession;
+            if (silentSession->GetPathState() == PathState::active)
+            {
+                probeSession = silentSession;
+            }
+            for (auto&& sessionItor: m_dlsessionmap)
+            {
+                auto& session = sessionItor.second;
+                if (session->GetRtt() > Duration::Zero() && session->GetPathState() == PathState::active
+                    && (!probeSession || session->GetRtt() < probeSession->GetRtt())
+                    && !session->TailLossProbeDue(now))
+                {
+                    probeSession = session;
+                }
+            }
+            if (!probeSession)
+            {
+                continue;
+            }
+            SPDLOG_DEBUG("session:{} silent, probe piece {} on session:{}", itor.first.ToLogStr(), piece,
+                    probeSession->GetSessionId().ToLogStr());
+            probeSession->DoProbeRequest(probeSession->GetSessionId(), piece);
+        }
+    }
+
+    /** A stalled session sends one piece when its probe is due: a piece missing that is in flight elsewhere, so a
+     *  lost probe delays nothing, or a new one if none is. A dead session gets no new pieces, its queue and what
+     *  it has in flight go to the other sessions at once instead of after the loss timeouts.
+     * */
+    void DoStallProbe() override
+    {
+        Timepoint now = EventClock::Now();
+        bool handedOver = false;
+        for (auto&& itor: m_dlsessionmap)
+        {
+            auto& sessId = itor.first;
+            auto& session = itor.second;
+            auto pathState = session->GetPathState();
+            if (pathState != PathState::dead)
+            {
+                m_deadSessions.erase(sessId);
+            }
+            if (pathState == PathState::active)
+            {
+                continue;
+            }
+            if (session->IsProbeDue(now))
+            {
+                SendStallProbe(sessId, session);
+            }
+            if (session->GetPathState() == PathState::dead && m_deadSessions.insert(sessId).second)
+            {
+                HandOverDeadSession(sessId, session);
+                handedOver = true;
+            }
+        }
+        if (handedOver)
+        {
+            DoMultiPathSchedule();
+        }
+    }
+
 private:
+    void SendStallProbe(const fw::ID& sessId, fw::shared_ptr<SessionStreamController>& session)
+    {
+        DataNumber piece = -1;
+        bool fresh = false;
+        auto inflightPieces = session->GetInFlightPieces();
+        for (auto pno: m_waitDownloadPieces)
+        {
+            if (std::find(inflightPieces.begin(), inflightPieces.end(), pno) == inflightPieces.end())
+            {
+                piece = pno;
+                break;
+            }
+        }
+        if (piece < 0)
+        {
+            std::set<DataNumber>& queue = m_lostPiecesQueue.empty() ? m_downloadQueue : m_lostPiecesQueue;
+            if (queue.empty())
+            {
+                return;
+            }
+            piece = *queue.begin();
+            queue.erase(queue.begin());
+            fresh = true;
+        }
+        SPDLOG_DEBUG("session:{} stalled, probe piece {}", sessId.ToLogStr(), piece);
+        if (!session->DoProbeRequest(sessId, piece) && fresh)
+        {
+            m_downloadQueue.insert(piece);
+        }
+    }
+
+    /// the pieces of a dead session go back to the queue the other sessions take from
+    void HandOverDeadSession(const fw::ID& sessId, fw::shared_ptr<SessionStreamController>& session)
+    {
+        auto& sessQueue = m_session_needdownloadpieceQ[sessId];
+        m_downloadQueue.insert(sessQueue.begin(), sessQueue.end());
+        SPDLOG_DEBUG("session:{} dead, {} queued pieces handed over", sessId.ToLogStr(), sessQueue.size());
+        sessQueue.clear();
+        size_t inflight = 0;
+        for (auto pno: session->GetInFlightPieces())
+        {
+            if (m_waitDownloadPieces.find(pno) != m_waitDownloadPieces.end())
+            {
+                inflight += m_lostPiecesQueue.insert(pno).second;
+            }
+        }
+        SPDLOG_DEBUG("session:{} dead, {} in flight pieces handed over", sessId.ToLogStr(), inflight);
+    }
+
+    /// a piece declared lost arrived after all, its retransmission is dropped if it was not requested yet
+    void CancelRetransmission(DataNumber pno)
+    {
+        size_t cancelled = m_lostPiecesQueue.erase(pno) + m_downloadQueue.erase(pno);
+        for (auto&& it_sn: m_session_needdownloadpieceQ)
+        {
+            cancelled += it_sn.second.erase(pno);
+        }
+        if (cancelled > 0)
+        {
+            SPDLOG_DEBUG("piece {} arrived, retransmission cancelled", pno);
+        }
+    }
+
     void SetLogicBw() {
         double totalBw = maxBotBw;
         //Duration maxRtt = Duration::FromMicroseconds(0);
@@ -343,7 +520,7 @@ private:
     }
 
     bool isBotnec(double sessBw, double botnecBw) {
-        if (sessBw < botnecBw * 0.85) {
+        if (sessBw < botnecBw * m_config.botnec_ratio) {
             return true;
         }
         return false;
@@ -390,12 +567,13 @@ private:
 
         // 3. try to request enough piece cnt from up layer, if necessary
 
+        bool morePieces = true;
         if (m_downloadQueue.size() < totalSubpieceCnt)
         {
             auto handler = m_phandler.lock();
             if (handler)
             {
-                handler->OnRequestDownloadPieces(totalSubpieceCnt - m_downloadQueue.size());
+                morePieces = handler->OnRequestDownloadPieces(totalSubpieceCnt - m_downloadQueue.size());
             }
             else
             {
@@ -427,6 +605,10 @@ private:
                         --uni32DataReqCnt;
 
                     }
+                    if (uni32DataReqCnt > 0 && !morePieces)
+                    {
+                        sessStream->OnAppLimited();
+                    }
 
                     m_session_needdownloadpieceQ[sessId].insert(vecToSendpieceNums.begin(),
                             vecToSendpieceNums.end());
@@ -463,10 +645,12 @@ private:
     std::map<fw::ID, double> m_btlBws;
     std::multimap<Duration, fw::shared_ptr<SessionStreamController>> m_sortmmap;
     fw::weak_ptr<MultiPathSchedulerHandler> m_phandler;
+    RRMultiPathSchedulerConfig m_config;
 
-    Timepoint lastRecvTime{ Timepoint::Zero() };
-    Duration recvDur{ Duration::FromMicroseconds(10000) };
     double botBw{ 0.01 };
     double maxBotBw { 0.01 };
+    std::map<fw::ID, uint32_t> m_pathChangeCnts;/** the path change count of each session last seen*/
+    std::map<fw::ID, uint32_t> m_spuriousLossCnts;/** the spurious loss count of each session last seen*/
+    std::set<fw::ID> m_deadSessions;/** whose pieces were handed over, until their path is back*/
 };
 
@@ -2,10 +2,20 @@
 
 #pragma once
 
+#include <algorithm>
 #include <deque>
+#include <functional>
 #include <memory>
 #include "congestioncontrol.hpp"
+#include "congestioncontrolfactory.hpp"
+#include "changepointdetector.hpp"
+#include "lossclassifier.hpp"
+#include "deliveryratesampler.hpp"
+#include "packettrainestimator.hpp"
+#include "pacer.hpp"
+#include "spuriouslossdetector.hpp"
 #include "basefw/base/log.h"
+#include "utils/eventclock.hpp"
 #include "packettype.h"
 
 class SessionStreamCtlHandler
@@ -16,62 +26,197 @@ public:
     virtual bool DoSendDataRequest(const basefw::ID& peerid, const std::vector<int32_t>& spns) = 0;
 };
 
-/// PacketSender is a simple traffic control module, in TCP or Quic, it is called Pacer.
-/// Decide if we can send pkt at this time
-class PacketSender
+/// SessionStreamController is the single session delegate inside transport module.
+/// This single session contains three part, congestion control module, loss detection module, traffic control module.
+/// It may be used to send data request in its session and receive the notice when packets has been sent.
+/// The interface hides which modules a session is made of, BasicSessionStreamController composes them.
+class SessionStreamController
+{
+public:
+    virtual ~SessionStreamController() = default;
+
+    virtual void StartSessionStreamCtl(const basefw::ID& sessionId,
+            std::weak_ptr<SessionStreamCtlHandler> ssStreamHandler) = 0;
+
+    virtual void StopSessionStreamCtl() = 0;
+
+    virtual basefw::ID GetSessionId() = 0;
+
+    virtual bool CanSend() = 0;
+
+    virtual uint32_t CanRequestPktCnt() = 0;
+
+    /// the scheduler had fewer pieces than this session could request
+    virtual void OnAppLimited() = 0;
+
+    /// send ONE datarequest Pkt, requestting for the data pieces whose id are in spns
+    virtual bool DoRequestdata(const basefw::ID& peerid, const std::vector<int32_t>& spns) = 0;
+
+    virtual void OnDataRequestPktSent(const std::vector<SeqNumber>& seqs,
+            const std::vector<DataNumber>& dataids, Timepoint sendtic) = 0;
+
+    virtual void OnDataPktReceived(uint32_t seq, int32_t datapiece, Timepoint recvtic) = 0;
+
+    virtual void OnLossDetectionAlarm() = 0;
+
+    virtual Duration GetRtt() = 0;
+
+    virtual uint32_t GetInFlightPktNum() = 0;
+
+    virtual basefw::ID GetSessionID() = 0;
+
+    virtual double GetSessBw() = 0;
+
+    /// delivery rate of the session in packets per ms, app limited samples only count when they are higher
+    virtual double GetDeliveryRate() = 0;
+
+    /// bottleneck capacity from the dispersion of request trains in packets per ms, 0 before the first train
+    virtual double GetCapacityEstimate() = 0;
+
+    virtual void SetLogicBw(double bw, bool isMax) = 0;
+
+    virtual fw::ID GetId() = 0;
+
+    virtual bool IsHighRtt() = 0;
+
+    /// true if the algorithm spreads the requests in time, the alarm then has to release them between the acks
+    virtual bool IsPaced() = 0;
+
+    /// a session whose path is not active only sends the probes the scheduler gives it
+    virtual PathState GetPathState() = 0;
+
+    /// true if the path is not active and its next probe is due now, the call counts the probe sent before as failed
+    virtual bool IsProbeDue(Timepoint now) = 0;
+
+    /// number of path changes detected so far, the scheduler drops its old view of the session when it grows
+    virtual uint32_t GetPathChangeCnt() = 0;
+
+    /// number of packets declared lost that arrived after all
+    virtual uint32_t GetSpuriousLossCnt() = 0;
+
+    /// true if packets are in flight and nothing was sent or received for the tail loss probe timeout
+    virtual bool TailLossProbeDue(Timepoint now) = 0;
+
+    /// a probe was sent for the packets in flight of this session, on it or on a faster one
+    virtual void OnTailLossProbe(Timepoint now) = 0;
+
+    /// pieces of the packets in flight, the highest first
+    virtual std::vector<DataNumber> GetInFlightPieces() = 0;
+
+    /// request piece as a probe, a tail loss or a stall one, it is sent whatever the window and the pacer allow
+    virtual bool DoProbeRequest(const basefw::ID& peerid, DataNumber piece) = 0;
+};
+
+/** @brief A congestion control chosen at runtime behind a CongestionCtlAlgo pointer, every call is a virtual one.
+ *  It is the CC of BasicSessionStreamController for a type MakeSessionStreamController() does not list, and the
+ *  baseline the static composition is measured against in bench/ackpathbench.cpp.
+ * */
+class DynamicCongestionCtl
 {
 public:
-    bool CanSend(uint32_t cwnd, uint32_t downloadingPktCnt)
+    explicit DynamicCongestionCtl(const CongestionCtlConfig& ccConfig)
+            : m_congestionCtl(MakeCongestionCtl(ccConfig))
     {
+    }
 
-        auto rt = false;
-        if (cwnd > downloadingPktCnt)
-        {
-            rt = true;
-        }
-        else
-        {
-            rt = false;
-        }
-        SPDLOG_TRACE("cwnd:{},downloadingPktCnt:{},rt: {}", cwnd, downloadingPktCnt, rt);
-        return rt;
+    void OnDataSent(InflightPacket& sentpkt)
+    {
+        m_congestionCtl->OnDataSent(sentpkt);
     }
 
-    uint32_t MaySendPktCnt(uint32_t cwnd, uint32_t downloadingPktCnt)
+    void OnDataAckOrLoss(const AckEvent& ackEvent, const LossEvent& lossEvent, RttStats& rttstats)
     {
-        SPDLOG_TRACE("cwnd:{},downloadingPktCnt:{}", cwnd, downloadingPktCnt);
-        if (cwnd >= downloadingPktCnt)
-        {
-            return std::min(cwnd - downloadingPktCnt, 8U);
-        }
-        else
-        {
-            return 0U;
-        }
+        m_congestionCtl->OnDataAckOrLoss(ackEvent, lossEvent, rttstats);
+    }
+
+    uint32_t GetCWND()
+    {
+        return m_congestionCtl->GetCWND();
+    }
+
+    uint32_t GetSendNum()
+    {
+        return m_congestionCtl->GetSendNum();
+    }
+
+    double GetProbeBw()
+    {
+        return m_congestionCtl->GetProbeBw();
+    }
+
+    void SetLogicBw(double bw, bool isMax)
+    {
+        m_congestionCtl->SetLogicBw(bw, isMax);
+    }
+
+    Duration GetRtprop()
+    {
+        return m_congestionCtl->GetRtprop();
+    }
+
+    PathState GetPathState()
+    {
+        return m_congestionCtl->GetPathState();
+    }
+
+    bool IsProbeDue(Timepoint now)
+    {
+        return m_congestionCtl->IsProbeDue(now);
+    }
+
+    double GetPacingRate()
+    {
+        return m_congestionCtl->GetPacingRate();
+    }
+
+    bool IsHoldingBack()
+    {
+        return m_congestionCtl->IsHoldingBack();
+    }
+
+    void OnCapacityEstimate(double capacity)
+    {
+        m_congestionCtl->OnCapacityEstimate(capacity);
+    }
+
+    void OnPathChange()
+    {
+        m_congestionCtl->OnPathChange();
+    }
+
+    void OnSpuriousLoss(const AckEvent& ackEvent)
+    {
+        m_congestionCtl->OnSpuriousLoss(ackEvent);
     }
 
+private:
+    std::unique_ptr<CongestionCtlAlgo> m_congestionCtl;
 };
 
-/// SessionStreamController is the single session delegate inside transport module.
-/// This single session contains three part, congestion control module, loss detection module, traffic control module.
-/// It may be used to send data request in its session and receive the notice when packets has been sent
-class SessionStreamController
+/** @brief A session statically composed of its congestion control CC, its loss detection LossDetect and its
+ *  pacer PacerT. The modules are members, not pointers, and the leaf algorithms are final, so the compiler sees
+ *  every call of the ACK path and may inline it; only the entry through SessionStreamController is virtual.
+ *  CC is constructed from the arguments after the pacer config, DynamicCongestionCtl takes a CongestionCtlConfig.
+ * */
+template<class CC, class LossDetect = DefaultLossDetectionAlgo, class PacerT = Pacer>
+class BasicSessionStreamController final : public SessionStreamController
 {
 public:
-
-    SessionStreamController()
+    template<class... CCArgs>
+    explicit BasicSessionStreamController(const PacerConfig& pacerConfig, CCArgs&& ... ccArgs)
+            : m_congestionCtl(std::forward<CCArgs>(ccArgs)...), m_sendCtl(pacerConfig)
     {
         SPDLOG_TRACE("");
     }
 
-    ~SessionStreamController()
+    ~BasicSessionStreamController() override
     {
         SPDLOG_TRACE("");
         StopSessionStreamCtl();
     }
 
-    void StartSessionStreamCtl(const basefw::ID& sessionId, OursCongestionCtlConfig& ccConfig,
-            std::weak_ptr<SessionStreamCtlHandler> ssStreamHandler)
+    void StartSessionStreamCtl(const basefw::ID& sessionId,
+            std::weak_ptr<SessionStreamCtlHandler> ssStreamHandler) override
     {
         if (isRunning)
         {
@@ -81,21 +226,13 @@ public:
         isRunning = true;
         m_sessionId = sessionId;
         m_ssStreamHandler = ssStreamHandler;
-        // cc
-        m_congestionCtl.reset(new OursCongestionControl(ccConfig));
-
-        // send control
-        m_sendCtl.reset(new PacketSender());
-
-        //loss detection
-        m_lossDetect.reset(new DefaultLossDetectionAlgo());
 
         // set initial smothed rtt
         m_rttstats.set_initial_rtt(Duration::FromMilliseconds(200));
 
     }
 
-    void StopSessionStreamCtl()
+    void StopSessionStreamCtl() override
     {
         if (isRunning)
         {
@@ -107,7 +244,7 @@ public:
         }
     }
 
-    basefw::ID GetSessionId()
+    basefw::ID GetSessionId() override
     {
         if (isRunning)
         {
@@ -119,7 +256,7 @@ public:
         }
     }
 
-    bool CanSend()
+    bool CanSend() override
     {
         SPDLOG_TRACE("");
         if (!isRunning)
@@ -127,37 +264,47 @@ public:
             return false;
         }
 
-        return m_sendCtl->CanSend(m_congestionCtl->GetCWND(), GetInFlightPktNum());
+        return m_sendCtl.CanSend(m_congestionCtl.GetCWND(), GetInFlightPktNum());
     }
 
-    uint32_t CanRequestPktCnt()
+    uint32_t CanRequestPktCnt() override
     {
         SPDLOG_TRACE("");
         if (!isRunning)
         {
             return false;
         }
-        //return m_sendCtl->MaySendPktCnt(m_congestionCtl->GetCWND(), GetInFlightPktNum());
-        return m_congestionCtl->GetSendNum();
+        //return m_sendCtl.MaySendPktCnt(m_congestionCtl.GetCWND(), GetInFlightPktNum());
+        auto sendNum = m_congestionCtl.GetSendNum();
+        if (sendNum == 0 && m_congestionCtl.IsHoldingBack())
+        {
+            // the path is not what limits the session now
+            m_rateSampler.OnAppLimited(GetInFlightPktNum());
+        }
+        return m_sendCtl.PacedPktCnt(sendNum, m_congestionCtl.GetPacingRate(), EventClock::Now(),
+                GetInFlightPktNum(), m_rttstats.smoothed_rtt());
     };
 
-    /// send ONE datarequest Pkt, requestting for the data pieces whose id are in spns
-    bool DoRequestdata(const basefw::ID& peerid, const std::vector<int32_t>& spns)
+    void OnAppLimited() override
     {
-        SPDLOG_TRACE("peerid = {}, spns = {}", peerid.ToLogStr(), spns);
-        if (!isRunning)
+        if (isRunning)
         {
-            return false;
+            m_rateSampler.OnAppLimited(GetInFlightPktNum());
         }
-        if (!CanSend())
+    }
+
+    bool DoRequestdata(const basefw::ID& peerid, const std::vector<int32_t>& spns) override
+    {
+        SPDLOG_TRACE("peerid = {}, spns = {}", peerid.ToLogStr(), spns);
+        if (!isRunning)
         {
-            SPDLOG_WARN("CanSend = false");
             return false;
         }
-
-        if (spns.size() > CanRequestPktCnt())
+        // the send allowance of the cc, not cwnd > inflight: PRR releases packets while inflight is above the cut cwnd
+        auto canRequestCnt = CanRequestPktCnt();
+        if (spns.size() > canRequestCnt)
         {
-            SPDLOG_WARN("The number of request data pieces {} exceeds the freewnd {}", spns.size(), CanRequestPktCnt());
+            SPDLOG_WARN("The number of request data pieces {} exceeds the freewnd {}", spns.size(), canRequestCnt);
             return false;
         }
         auto handler = m_ssStreamHandler.lock();
@@ -174,7 +321,7 @@ public:
     }
 
     void OnDataRequestPktSent(const std::vector<SeqNumber>& seqs,
-            const std::vector<DataNumber>& dataids, Timepoint sendtic)
+            const std::vector<DataNumber>& dataids, Timepoint sendtic) override
     {
         SPDLOG_TRACE("seq = {}, dataid = {}, sendtic = {}",
                 seqs,
@@ -187,32 +334,32 @@ public:
         for (auto datano: dataids)
         {
             SPDLOG_TRACE("seqidx: {}", seqidx);
-            DataPacket p;
-            p.seq = seqs[seqidx];
-            p.pieceId = datano;
-            p.groupId = groupId;
-            // add to downloading queue
-            m_inflightpktmap.AddSentPacket(p, sendtic);
-
-            // inform cc algo that a packet is sent
+            // inform cc algo that a packet is sent, it may stamp its own state on the packet
             InflightPacket sentpkt;
             sentpkt.seq = seqs[seqidx];
             sentpkt.pieceId = datano;
             sentpkt.sendtic = sendtic;
             sentpkt.groupId = groupId;
-            m_congestionCtl->OnDataSent(sentpkt);
+            m_rateSampler.OnPacketSent(sentpkt, GetInFlightPktNum());
+            m_congestionCtl.OnDataSent(sentpkt);
+            m_trainEstimator.OnPacketSent(sentpkt);
+            // add to downloading queue
+            m_inflightpktmap.AddSentPacket(sentpkt);
             seqidx++;
         }
+        m_sendCtl.OnPacedSent(dataids.size());
         groupId++;
+        m_lastActivityTic = sendtic;
 
     }
 
-    void OnDataPktReceived(uint32_t seq, int32_t datapiece, Timepoint recvtic)
+    void OnDataPktReceived(uint32_t seq, int32_t datapiece, Timepoint recvtic) override
     {
         if (!isRunning)
         {
             return;
         }
+        m_lastActivityTic = recvtic;
         // find the sending record
         auto rtpair = m_inflightpktmap.PktIsInFlight(seq, datapiece);
         auto inFlight = rtpair.first;
@@ -223,34 +370,57 @@ public:
             auto oldsrtt = m_rttstats.smoothed_rtt();
             // we don't have ack_delay in this simple implementation.
             auto pkt_rtt = recvtic - inflightPkt.sendtic;
-            m_rttstats.UpdateRtt(pkt_rtt, Duration::Zero(), Clock::GetClock()->Now());
+            m_rttstats.UpdateRtt(pkt_rtt, Duration::Zero(), EventClock::Now());
             auto newsrtt = m_rttstats.smoothed_rtt();
 
-            auto oldcwnd = m_congestionCtl->GetCWND();
+            auto oldcwnd = m_congestionCtl.GetCWND();
 
             AckEvent ackEvent;
             ackEvent.valid = true;
-            ackEvent.ackPacket.seq = seq;
-            ackEvent.ackPacket.pieceId = datapiece;
-            ackEvent.ackPacket.groupId = inflightPkt.groupId;
+            ackEvent.ackPacket = inflightPkt;
             ackEvent.sendtic = inflightPkt.sendtic;
             ackEvent.recvtic = recvtic;
             ackEvent.sess_id = m_sessionId;
+            ackEvent.rateSample = m_rateSampler.OnPacketAcked(inflightPkt, recvtic);
+            if (m_changeDetector.OnAck(pkt_rtt, ackEvent.rateSample, recvtic))
+            {
+                OnPathChange(pkt_rtt);
+            }
+            OnRateSample(ackEvent.rateSample);
+            m_lossClassifier.OnPacketAcked(inflightPkt, pkt_rtt);
+            if (m_trainEstimator.OnPacketAcked(inflightPkt, recvtic))
+            {
+                m_congestionCtl.OnCapacityEstimate(m_trainEstimator.CapacityEstimate());
+            }
             LossEvent lossEvent; // if we detect loss when ACK event, we may do loss check here.
-            m_congestionCtl->OnDataAckOrLoss(ackEvent, lossEvent, m_rttstats);
+            m_congestionCtl.OnDataAckOrLoss(ackEvent, lossEvent, m_rttstats);
 
-            auto newcwnd = m_congestionCtl->GetCWND();
+            auto newcwnd = m_congestionCtl.GetCWND();
             // mark as received
             m_inflightpktmap.OnPacktReceived(inflightPkt, recvtic);
         }
         else
         {
-            SPDLOG_WARN(" Recv an pkt with unknown seq:{}", seq);
+            auto lostpair = m_spuriousLossDetector.OnPacketArrived(seq, datapiece);
+            if (lostpair.first)
+            {
+                OnSpuriousLoss(lostpair.second, recvtic);
+            }
+            else
+            {
+                SPDLOG_WARN(" Recv an pkt with unknown seq:{}", seq);
+            }
+        }
+        if (m_tailProbeCnt > 0)
+        {
+            // the path answers again, what is still missing from before the silence is lost
+            m_tailProbeCnt = 0;
+            DoAlarmTimeoutDetection();
         }
 
     }
 
-    void OnLossDetectionAlarm()
+    void OnLossDetectionAlarm() override
     {
         DoAlarmTimeoutDetection();
     }
@@ -280,23 +450,26 @@ public:
             return;
         }
         ///check timeout
-        Timepoint now_t = Clock::GetClock()->Now();
+        Timepoint now_t = EventClock::Now();
         AckEvent ack;
         LossEvent loss;
         loss.sess_id = m_sessionId;
-        m_lossDetect->DetectLoss(m_inflightpktmap, now_t, ack, -1, loss, m_rttstats);
+        m_lossDetect.DetectLoss(m_inflightpktmap, now_t, ack, -1, loss, m_rttstats);
         if (loss.valid)
         {
+            loss.congestive = m_lossClassifier.IsCongestive(loss.lossPackets, m_rttstats.windowed_min_rtt());
             for (auto&& pkt: loss.lossPackets)
             {
                 m_inflightpktmap.RemoveFromInFlight(pkt);
+                m_trainEstimator.OnPacketLost(pkt);
             }
-            m_congestionCtl->OnDataAckOrLoss(ack, loss, m_rttstats);
+            m_spuriousLossDetector.OnPacketsLost(loss.lossPackets, loss.losttic);
+            m_congestionCtl.OnDataAckOrLoss(ack, loss, m_rttstats);
             InformLossUp(loss);
         }
     }
 
-    Duration GetRtt()
+    Duration GetRtt() override
     {
         Duration rtt{ Duration::Zero() };
         if (isRunning)
@@ -307,49 +480,204 @@ public:
         return rtt;
     }
 
-    uint32_t GetInFlightPktNum()
+    uint32_t GetInFlightPktNum() override
     {
         return m_inflightpktmap.InFlightPktNum();
     }
 
 
-    basefw::ID GetSessionID()
+    basefw::ID GetSessionID() override
     {
         return m_sessionId;
     }
 
-    double GetSessBw() {
-        return m_congestionCtl->GetProbeBw();
+    double GetSessBw() override {
+        return m_congestionCtl.GetProbeBw();
     }
 
-    void SetLogicBw(double bw, bool isMax) {
-        m_congestionCtl->SetLogicBw(bw, isMax);
+    double GetDeliveryRate() override {
+        return m_deliveryRate;
+    }
+
+    double GetCapacityEstimate() override {
+        return m_trainEstimator.CapacityEstimate();
     }
 
-    fw::ID GetId(){
+    void SetLogicBw(double bw, bool isMax) override {
+        m_congestionCtl.SetLogicBw(bw, isMax);
+    }
+
+    fw::ID GetId() override {
         return m_sessionId;
     }
 
-    bool IsHighRtt() {
-        return m_rttstats.smoothed_rtt() > 1.1 * m_congestionCtl->GetRtprop();
+    bool IsHighRtt() override {
+        return m_rttstats.smoothed_rtt() > 1.1 * m_congestionCtl.GetRtprop();
     }
 
-    bool IsSleepEnough(Timepoint now) {
-        return m_congestionCtl->IsSleepEnough(now);
+    bool IsPaced() override {
+        return isRunning && m_congestionCtl.GetPacingRate() > 0;
+    }
+
+    PathState GetPathState() override {
+        return m_congestionCtl.GetPathState();
+    }
+
+    bool IsProbeDue(Timepoint now) override {
+        return m_congestionCtl.IsProbeDue(now);
+    }
+
+    uint32_t GetPathChangeCnt() override {
+        return m_changeDetector.ChangeCnt();
+    }
+
+    uint32_t GetSpuriousLossCnt() override {
+        return m_spuriousLossDetector.SpuriousCnt();
+    }
+
+    /// the timeout is twice the smoothed RTT, at least kMinTailProbeMs, and doubles with each probe
+    bool TailLossProbeDue(Timepoint now) override {
+        if (!isRunning || m_inflightpktmap.InFlightPktNum() == 0 || m_tailProbeCnt >= kMaxTailProbes
+            || !m_lastActivityTic.IsInitialized())
+        {
+            return false;
+        }
+        Duration timeout = std::max(m_rttstats.SmoothedOrInitialRtt() * 2,
+                Duration::FromMilliseconds(kMinTailProbeMs));
+        return now - m_lastActivityTic >= timeout * int(1U << m_tailProbeCnt);
+    }
+
+    void OnTailLossProbe(Timepoint now) override {
+        ++m_tailProbeCnt;
+        m_lastActivityTic = now;
+    }
+
+    std::vector<DataNumber> GetInFlightPieces() override {
+        std::vector<DataNumber> pieces;
+        pieces.reserve(m_inflightpktmap.InFlightPktNum());
+        for (auto&& pkt_itor: m_inflightpktmap.inflightPktMap)
+        {
+            pieces.push_back(pkt_itor.second.pieceId);
+        }
+        std::sort(pieces.begin(), pieces.end(), std::greater<DataNumber>());
+        return pieces;
+    }
+
+    bool DoProbeRequest(const basefw::ID& peerid, DataNumber piece) override {
+        if (!isRunning)
+        {
+            return false;
+        }
+        auto handler = m_ssStreamHandler.lock();
+        if (!handler)
+        {
+            SPDLOG_WARN("SessionStreamHandler is null");
+            return false;
+        }
+        SPDLOG_DEBUG("session:{}, probe for piece:{}", m_sessionId.ToLogStr(), piece);
+        return handler->DoSendDataRequest(peerid, std::vector<int32_t>{ piece });
     }
 
 private:
+    static constexpr uint32_t kMaxTailProbes = 2;/** probes without an answer, the loss alarm takes over then*/
+    static constexpr uint32_t kMinTailProbeMs = 10;
+
+    /** a packet declared lost arrived: the loss delay widens before the RTT takes the sample of this late packet,
+     *  the congestion control puts back what it cut for the loss, and the data is delivered. The handler was told
+     *  about the loss already, the scheduler drops the retransmission when the piece comes in.
+     * */
+    void OnSpuriousLoss(const InflightPacket& lostpkt, Timepoint recvtic)
+    {
+        m_lossDetect.OnSpuriousLoss(lostpkt, recvtic, m_rttstats);
+        auto pkt_rtt = recvtic - lostpkt.sendtic;
+        m_rttstats.UpdateRtt(pkt_rtt, Duration::Zero(), EventClock::Now());
+
+        AckEvent ackEvent;
+        ackEvent.valid = true;
+        ackEvent.ackPacket = lostpkt;
+        ackEvent.sendtic = lostpkt.sendtic;
+        ackEvent.recvtic = recvtic;
+        ackEvent.sess_id = m_sessionId;
+        ackEvent.rateSample = m_rateSampler.OnPacketAcked(lostpkt, recvtic);
+        OnRateSample(ackEvent.rateSample);
+        m_lossClassifier.OnPacketAcked(lostpkt, pkt_rtt);
+        m_congestionCtl.OnSpuriousLoss(ackEvent);
+    }
+
+    /// the RTT or delivery rate jumped, restart the RTT and bandwidth estimates from the latest sample
+    void OnPathChange(Duration latestRtt)
+    {
+        SPDLOG_DEBUG("session:{}, path change, latest rtt:{}", m_sessionId.ToLogStr(), latestRtt.ToDebuggingValue());
+        m_rttstats.OnConnectionMigration();
+        m_rttstats.UpdateRtt(latestRtt, Duration::Zero(), EventClock::Now());
+        m_congestionCtl.OnPathChange();
+        m_trainEstimator.ClearSamples();
+        m_deliveryRate = 0;
+    }
+
+    void OnRateSample(const RateSample& rs)
+    {
+        if (!rs.valid || (rs.isAppLimited && rs.deliveryRate < m_deliveryRate))
+        {
+            return;
+        }
+        m_deliveryRate = m_deliveryRate == 0 ? rs.deliveryRate : 0.875 * m_deliveryRate + 0.125 * rs.deliveryRate;
+    }
+
     bool isRunning{ false };
     uint32_t groupId{ 0 };
 
     basefw::ID m_sessionId;/** The remote peer id defines the session id*/
     basefw::ID m_taskid;/**The file id downloading*/
-    std::unique_ptr<CongestionCtlAlgo> m_congestionCtl;
-    std::unique_ptr<LossDetectionAlgo> m_lossDetect;
+    CC m_congestionCtl;
+    LossDetect m_lossDetect;
     std::weak_ptr<SessionStreamCtlHandler> m_ssStreamHandler;
     InFlightPacketMap m_inflightpktmap;
 
-    std::unique_ptr<PacketSender> m_sendCtl;
+    PacerT m_sendCtl;
     RttStats m_rttstats;
+    DeliveryRateSampler m_rateSampler;
+    double m_deliveryRate{ 0 };
+    PacketTrainEstimator m_trainEstimator;
+    ChangePointDetector m_changeDetector;
+    LossClassifier m_lossClassifier;
+    SpuriousLossDetector m_spuriousLossDetector;
+    Timepoint m_lastActivityTic{ Timepoint::Zero() };/** last request sent or packet received*/
+    uint32_t m_tailProbeCnt{ 0 };/** tail loss probes since the last packet received*/
 };
 
+/// a session of the algorithm ccConfig.type, composed at compile time for each type the factory lists
+inline std::shared_ptr<SessionStreamController> MakeSessionStreamController(const CongestionCtlConfig& ccConfig)
+{
+    switch (ccConfig.type)
+    {
+        case CongestionCtlType::reno:
+            return std::make_shared<BasicSessionStreamController<RenoCongestionControl>>(ccConfig.pacer,
+                    ccConfig.reno);
+        case CongestionCtlType::bbr2:
+            return std::make_shared<BasicSessionStreamController<Bbr2CongestionControl>>(ccConfig.pacer,
+                    ccConfig.bbr2);
+        case CongestionCtlType::cubic:
+            return std::make_shared<BasicSessionStreamController<CubicCongestionControl>>(ccConfig.pacer,
+                    ccConfig.cubic);
+        case CongestionCtlType::copa:
+            return std::make_shared<BasicSessionStreamController<CopaCongestionControl>>(ccConfig.pacer,
+                    ccConfig.copa);
+        case CongestionCtlType::ledbat:
+            return std::make_shared<BasicSessionStreamController<LedbatCongestionControl>>(ccConfig.pacer,
+                    ccConfig.ledbat);
+        case CongestionCtlType::vivace:
+            return std::make_shared<BasicSessionStreamController<VivaceCongestionControl>>(ccConfig.pacer,
+                    ccConfig.vivace);
+        case CongestionCtlType::lia:
+        case CongestionCtlType::olia:
+        case CongestionCtlType::balia:
+            return std::make_shared<BasicSessionStreamController<CoupledCongestionControl>>(ccConfig.pacer,
+                    CoupledConfigOf(ccConfig));
+        case CongestionCtlType::ours:
+            return std::make_shared<BasicSessionStreamController<OursCongestionControl>>(ccConfig.pacer,
+                    ccConfig.ours);
+        default:
+            return std::make_shared<BasicSessionStreamController<DynamicCongestionCtl>>(ccConfig.pacer, ccConfig);
+    }
+}
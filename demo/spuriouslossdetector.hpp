@@ -0,0 +1,84 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+#include "basefw/base/log.h"
+#include "utils/transporttime.h"
+#include "packettype.h"
+
+/// config of SpuriousLossDetector
+struct SpuriousLossDetectorConfig
+{
+    uint32_t max_records{ 256 };/** lost packets remembered at most, the oldest are dropped first*/
+    uint32_t record_ms{ 2000 };/** a lost packet is forgotten this long after it was declared lost*/
+};
+
+/** @brief Remembers the packets recently declared lost, to tell when one of them arrives after all.
+ *  The loss detection declares a packet lost when it is late by a multiple of the RTT, a packet that was only
+ *  delayed (reordered on another queue, a link layer retransmission, a delay spike) arrives after that. Without a
+ *  record it is an unknown packet and the window cut it caused stays. The record is bounded in size and time.
+ * */
+class SpuriousLossDetector
+{
+public:
+    explicit SpuriousLossDetector(const SpuriousLossDetectorConfig& config = SpuriousLossDetectorConfig())
+            : m_config(config)
+    {
+    }
+
+    void OnPacketsLost(const std::vector<InflightPacket>& lossPackets, Timepoint losttic)
+    {
+        for (const auto& lostpkt: lossPackets)
+        {
+            auto key = std::make_pair(lostpkt.seq, lostpkt.pieceId);
+            if (m_lostPkts.emplace(key, lostpkt).second)
+            {
+                m_order.push_back({ key, losttic });
+            }
+        }
+        Duration keep = Duration::FromMilliseconds(m_config.record_ms);
+        while (!m_order.empty() && (m_order.size() > m_config.max_records || m_order.front().losttic + keep < losttic))
+        {
+            m_lostPkts.erase(m_order.front().key);
+            m_order.pop_front();
+        }
+    }
+
+    /// first is true if the packet seq, piece was declared lost, second is its send record then
+    std::pair<bool, InflightPacket> OnPacketArrived(SeqNumber seq, DataNumber piece)
+    {
+        auto itor = m_lostPkts.find(std::make_pair(seq, piece));
+        if (itor == m_lostPkts.end())
+        {
+            return std::make_pair(false, InflightPacket());
+        }
+        auto rt = std::make_pair(true, itor->second);
+        // the order entry stays until it is evicted, it no longer finds the packet then
+        m_lostPkts.erase(itor);
+        ++m_spuriousCnt;
+        SPDLOG_DEBUG("spurious loss of seq:{}, piece:{}, total:{}", seq, piece, m_spuriousCnt);
+        return rt;
+    }
+
+    uint32_t SpuriousCnt() const
+    {
+        return m_spuriousCnt;
+    }
+
+private:
+    struct LostRecord
+    {
+        std::pair<SeqNumber, DataNumber> key;
+        Timepoint losttic;
+    };
+
+    SpuriousLossDetectorConfig m_config;
+    std::map<std::pair<SeqNumber, DataNumber>, InflightPacket> m_lostPkts;
+    std::deque<LostRecord> m_order;/** in the order the packets were declared lost*/
+    uint32_t m_spuriousCnt{ 0 };
+};
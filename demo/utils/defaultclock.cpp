@@ -1,6 +1,9 @@
 // Copyright (c) 2023. ByteDance Inc. All rights reserved.
 
 #include "defaultclock.hpp"
+#ifdef __linux__
+#include <time.h>
+#endif
 
      DefaultClock* DefaultClock::GetClock()
     {
@@ -9,8 +12,17 @@
     }
 
     // QuicClock implementation.
+    /// CLOCK_MONOTONIC_COARSE shares the epoch of steady_clock, but is served from the vDSO
+    /// without reading the hardware counter. The resolution is the kernel tick (1~4ms).
     QuicTime DefaultClock::ApproximateNow() const
     {
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+        struct timespec ts;
+        if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+        {
+            return CreateTimeFromMicroseconds(uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000);
+        }
+#endif
         return Now();
     }
 
@@ -25,6 +25,7 @@ public:
     DefaultClock& operator=(const DefaultClock&) = delete;
 
     // QuicClock implementation.
+    /// cheap coarse grained steady time, see defaultclock.cpp
     QuicTime ApproximateNow() const override;
 
     /// std::steady_clock
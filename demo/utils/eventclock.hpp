@@ -0,0 +1,72 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include "transporttime.h"
+
+/// Event scoped cached "now" for the per packet path.
+/// ScopedEventTime reads the installed clock once at the entrance of an SDK callback, everything called
+/// inside that callback gets the same time point from EventClock::Now() without another clock read.
+/// Outside of any scope EventClock::Now() falls back to Clock::GetClock()->Now().
+class EventClock
+{
+public:
+    static Timepoint Now()
+    {
+        const auto& cached = Cached();
+        if (cached.IsInitialized())
+        {
+            return cached;
+        }
+        return Clock::GetClock()->Now();
+    }
+
+    static bool InEvent()
+    {
+        return Cached().IsInitialized();
+    }
+
+    /// same as Clock::GetClock()->CreateTimeFromMicroseconds(), but without the virtual call
+    static Timepoint FromMicroseconds(uint64_t time_us)
+    {
+        return Clock::GetClock()->QuicClock::CreateTimeFromMicroseconds(time_us);
+    }
+
+private:
+    friend class ScopedEventTime;
+
+    static Timepoint& Cached()
+    {
+        static thread_local Timepoint cached = Timepoint::Zero();
+        return cached;
+    }
+};
+
+/// Capture the event time for the lifetime of this object. Nested scopes keep the outermost time point.
+class ScopedEventTime
+{
+public:
+    ScopedEventTime()
+            : m_isOwner(!EventClock::InEvent())
+    {
+        if (m_isOwner)
+        {
+            EventClock::Cached() = Clock::GetClock()->Now();
+        }
+    }
+
+    ~ScopedEventTime()
+    {
+        if (m_isOwner)
+        {
+            EventClock::Cached() = Timepoint::Zero();
+        }
+    }
+
+    ScopedEventTime(const ScopedEventTime&) = delete;
+
+    ScopedEventTime& operator=(const ScopedEventTime&) = delete;
+
+private:
+    bool m_isOwner;
+};
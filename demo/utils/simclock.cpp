@@ -0,0 +1,60 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#include "simclock.hpp"
+#include <chrono>
+#include "basefw/base/log.h"
+
+constexpr int64_t SimClock::kDefaultStartUs;
+
+SimClock::SimClock(int64_t startUs)
+        : m_nowUs(startUs)
+{
+    auto nowus = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::system_clock::now());
+    m_wallOffsetUs = nowus.time_since_epoch().count() - startUs;
+}
+
+void SimClock::AdvanceTime(QuicTime::Delta delta)
+{
+    if (delta < QuicTime::Delta::Zero())
+    {
+        SPDLOG_WARN("Ignore negative delta: {}", delta.ToMicroseconds());
+        return;
+    }
+    m_nowUs += delta.ToMicroseconds();
+}
+
+void SimClock::AdvanceTo(QuicTime timepoint)
+{
+    if (timepoint.ToDebuggingValue() < m_nowUs)
+    {
+        SPDLOG_WARN("Ignore time going backwards, now: {} target: {}", m_nowUs, timepoint.ToDebuggingValue());
+        return;
+    }
+    m_nowUs = timepoint.ToDebuggingValue();
+}
+
+int64_t SimClock::NowMicroseconds() const
+{
+    return m_nowUs;
+}
+
+QuicTime SimClock::ApproximateNow() const
+{
+    return Now();
+}
+
+QuicTime SimClock::Now() const
+{
+    return CreateTimeFromMicroseconds(m_nowUs);
+}
+
+QuicWallTime SimClock::WallNow() const
+{
+    return QuicWallTime::FromUNIXMicroseconds(uint64_t(m_wallOffsetUs + m_nowUs));
+}
+
+QuicTime SimClock::ConvertWallTimeToQuicTime(
+        const QuicWallTime& walltime) const
+{
+    return CreateTimeFromMicroseconds(uint64_t(int64_t(walltime.ToUNIXMicroseconds()) - m_wallOffsetUs));
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+
+#include "demo/utils/thirdparty/quiche/quic_clock.h"
+#include <cstdint>
+
+using basefw::quic::QuicClock;
+using basefw::quic::QuicTime;
+using basefw::quic::QuicWallTime;
+
+/// A settable virtual clock implementing the QuicClock Interface.
+/// Time only moves when the owner calls AdvanceTime() or AdvanceTo(), so controllers driven by
+/// a simulator see fully deterministic time and never wait on the wall clock.
+class SimClock : public QuicClock
+{
+public:
+    /// QuicTime::Zero() is used as "not set" all over the transport module, so never start from 0
+    static constexpr int64_t kDefaultStartUs = 1000 * 1000;
+
+    explicit SimClock(int64_t startUs = kDefaultStartUs);
+
+    ~SimClock() override = default;
+
+    SimClock(const SimClock&) = delete;
+
+    SimClock& operator=(const SimClock&) = delete;
+
+    /// move the clock forward by delta, a negative delta is ignored
+    void AdvanceTime(QuicTime::Delta delta);
+
+    /// jump to the given time point, time points in the past are ignored
+    void AdvanceTo(QuicTime timepoint);
+
+    /// current virtual time in us
+    int64_t NowMicroseconds() const;
+
+    // QuicClock implementation.
+    QuicTime ApproximateNow() const override;
+
+    QuicTime Now() const override;
+
+    /// wall time is the virtual time shifted by the wall clock at construction
+    QuicWallTime WallNow() const override;
+
+    QuicTime ConvertWallTimeToQuicTime(
+            const QuicWallTime& walltime) const override;
+
+private:
+    int64_t m_nowUs;
+    int64_t m_wallOffsetUs;/** wall clock minus virtual time at construction, may be negative*/
+};
@@ -23,12 +23,15 @@ namespace basefw
             const float kBeta = 0.25f;
             const float kOneMinusBeta = (1 - kBeta);
             const int64_t kInitialRttMs = 1000;
+            const int64_t kMinRttWindowMs = 10000;
 
         }  // namespace
 
         RttStats::RttStats()
                 : latest_rtt_(QuicTime::Delta::Zero()),
                   min_rtt_(QuicTime::Delta::Zero()),
+                  windowed_min_rtt_(QuicTime::Delta::FromMilliseconds(kMinRttWindowMs), QuicTime::Delta::Zero(),
+                          QuicTime::Zero()),
                   smoothed_rtt_(QuicTime::Delta::Zero()),
                   previous_srtt_(QuicTime::Delta::Zero()),
                   mean_deviation_(QuicTime::Delta::Zero()),
@@ -67,6 +70,7 @@ namespace basefw
             {
                 min_rtt_ = send_delta;
             }
+            windowed_min_rtt_.Update(send_delta, now);
 
             QuicTime::Delta rtt_sample(send_delta);
             previous_srtt_ = smoothed_rtt_;
@@ -118,6 +122,7 @@ namespace basefw
         {
             latest_rtt_ = QuicTime::Delta::Zero();
             min_rtt_ = QuicTime::Delta::Zero();
+            windowed_min_rtt_.Clear();
             smoothed_rtt_ = QuicTime::Delta::Zero();
             mean_deviation_ = QuicTime::Delta::Zero();
             initial_rtt_ = QuicTime::Delta::FromMilliseconds(kInitialRttMs);
@@ -163,6 +168,7 @@ namespace basefw
         {
             latest_rtt_ = stats.latest_rtt_;
             min_rtt_ = stats.min_rtt_;
+            windowed_min_rtt_ = stats.windowed_min_rtt_;
             smoothed_rtt_ = stats.smoothed_rtt_;
             previous_srtt_ = stats.previous_srtt_;
             mean_deviation_ = stats.mean_deviation_;
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cstdint>
 #include "quic_time.h"
+#include "windowed_filter.h"
 #include "basefw/base/log.h"
 #include "spdlog/spdlog.h"
 /** RTT Sampler Modified from Chromium Quic implementation
@@ -123,6 +124,19 @@ namespace basefw
                 return min_rtt_;
             }
 
+            // Returns the min rtt over the last min rtt window, it follows a path whose
+            // rtt went up, unlike min_rtt().
+            // May return Zero if no valid updates have occurred.
+            QuicTime::Delta windowed_min_rtt() const
+            {
+                return windowed_min_rtt_.GetBest();
+            }
+
+            void set_min_rtt_window(QuicTime::Delta window)
+            {
+                windowed_min_rtt_.SetWindowLength(window);
+            }
+
             QuicTime::Delta mean_deviation() const
             {
                 return mean_deviation_;
@@ -149,6 +163,7 @@ namespace basefw
 
             QuicTime::Delta latest_rtt_;
             QuicTime::Delta min_rtt_;
+            WindowedFilter<QuicTime::Delta, MinFilter<QuicTime::Delta>, QuicTime, QuicTime::Delta> windowed_min_rtt_;
             QuicTime::Delta smoothed_rtt_;
             QuicTime::Delta previous_srtt_;
             // Mean RTT deviation during this session.
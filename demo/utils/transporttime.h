@@ -14,6 +14,52 @@ using Clock = NS3Clock;
 #else
 
 #include "defaultclock.hpp"
+#include "simclock.hpp"
 
-using Clock = DefaultClock;
+/// The clock used by the transport module. It is DefaultClock unless another QuicClock, e.g. a SimClock,
+/// is installed with SetClock(). The selection is per thread, so simulations may run side by side.
+class Clock
+{
+public:
+    static QuicClock* GetClock()
+    {
+        return CurrentClock();
+    }
+
+    /// install clock for the calling thread, nullptr restores DefaultClock. The caller keeps the ownership.
+    static void SetClock(QuicClock* clock)
+    {
+        CurrentClock() = clock ? clock : DefaultClock::GetClock();
+    }
+
+private:
+    static QuicClock*& CurrentClock()
+    {
+        static thread_local QuicClock* clock = DefaultClock::GetClock();
+        return clock;
+    }
+};
+
+/// Install a clock for the lifetime of this object, restore the previous one when it goes out of scope
+class ScopedClockOverride
+{
+public:
+    explicit ScopedClockOverride(QuicClock* clock)
+            : m_prevClock(Clock::GetClock())
+    {
+        Clock::SetClock(clock);
+    }
+
+    ~ScopedClockOverride()
+    {
+        Clock::SetClock(m_prevClock);
+    }
+
+    ScopedClockOverride(const ScopedClockOverride&) = delete;
+
+    ScopedClockOverride& operator=(const ScopedClockOverride&) = delete;
+
+private:
+    QuicClock* m_prevClock;
+};
 #endif
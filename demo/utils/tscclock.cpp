@@ -0,0 +1,113 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#include "tscclock.hpp"
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TSC_CLOCK_X86 1
+#endif
+
+TscClock* TscClock::GetClock()
+{
+    static TscClock* clock = new TscClock();
+    return clock;
+}
+
+TscClock::TscClock(uint32_t calibrateUs)
+{
+    m_tscEnabled = HasInvariantTsc();
+    if (m_tscEnabled)
+    {
+        Calibrate(calibrateUs);
+    }
+}
+
+bool TscClock::IsTscEnabled() const
+{
+    return m_tscEnabled;
+}
+
+double TscClock::TicksPerMicrosecond() const
+{
+    return m_usPerTick > 0 ? 1.0 / m_usPerTick : 0;
+}
+
+QuicTime TscClock::ApproximateNow() const
+{
+    return Now();
+}
+
+QuicTime TscClock::Now() const
+{
+    if (!m_tscEnabled)
+    {
+        return CreateTimeFromMicroseconds(SteadyNowUs());
+    }
+    auto elapsedTicks = static_cast<int64_t>(ReadTsc() - m_baseTsc);
+    return CreateTimeFromMicroseconds(m_baseUs + static_cast<int64_t>(elapsedTicks * m_usPerTick));
+}
+
+QuicWallTime TscClock::WallNow() const
+{
+    auto nowms = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
+    return QuicWallTime::FromUNIXMicroseconds(nowms.time_since_epoch().count() * 1000);
+}
+
+QuicTime TscClock::ConvertWallTimeToQuicTime(
+        const QuicWallTime& walltime) const
+{
+    return CreateTimeFromMicroseconds(walltime.ToUNIXMicroseconds());
+}
+
+bool TscClock::HasInvariantTsc()
+{
+#ifdef TSC_CLOCK_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+    {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    /// CPUID.80000007H:EDX[8], the TSC runs at a constant rate in all ACPI P-, C- and T-states
+    return (edx & (1U << 8)) != 0;
+#else
+    return false;
+#endif
+}
+
+uint64_t TscClock::ReadTsc()
+{
+#ifdef TSC_CLOCK_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+int64_t TscClock::SteadyNowUs()
+{
+    auto nowus = std::chrono::time_point_cast<std::chrono::microseconds>(std::chrono::steady_clock::now());
+    return nowus.time_since_epoch().count();
+}
+
+void TscClock::Calibrate(uint32_t calibrateUs)
+{
+    auto startUs = SteadyNowUs();
+    auto startTsc = ReadTsc();
+    auto endUs = startUs;
+    while (endUs - startUs < calibrateUs)
+    {
+        endUs = SteadyNowUs();
+    }
+    auto endTsc = ReadTsc();
+    if (endTsc <= startTsc)
+    {
+        m_tscEnabled = false;
+        return;
+    }
+    m_usPerTick = double(endUs - startUs) / double(endTsc - startTsc);
+    m_baseTsc = endTsc;
+    m_baseUs = endUs;
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+
+#include "demo/utils/thirdparty/quiche/quic_clock.h"
+#include <cstdint>
+
+using basefw::quic::QuicClock;
+using basefw::quic::QuicTime;
+using basefw::quic::QuicWallTime;
+
+/// A QuicClock reading the CPU time stamp counter, calibrated against std::chrono::steady_clock.
+/// Time points share the steady_clock epoch, so they can be mixed with the tic_us given by the SDK.
+/// Falls back to steady_clock when the CPU has no invariant TSC or is not x86.
+/// Install it with Clock::SetClock(TscClock::GetClock()) to use it.
+class TscClock : public QuicClock
+{
+public:
+    static TscClock* GetClock();
+
+    /// @param calibrateUs time spent on calibration, longer is more accurate
+    explicit TscClock(uint32_t calibrateUs = 20000);
+
+    ~TscClock() override = default;
+
+    TscClock(const TscClock&) = delete;
+
+    TscClock& operator=(const TscClock&) = delete;
+
+    /// true if the TSC is in use, false if we fall back to steady_clock
+    bool IsTscEnabled() const;
+
+    double TicksPerMicrosecond() const;
+
+    // QuicClock implementation.
+    QuicTime ApproximateNow() const override;
+
+    QuicTime Now() const override;
+
+    /// std::system_clock
+    QuicWallTime WallNow() const override;
+
+    QuicTime ConvertWallTimeToQuicTime(
+            const QuicWallTime& walltime) const override;
+
+private:
+    static bool HasInvariantTsc();
+
+    static uint64_t ReadTsc();
+
+    static int64_t SteadyNowUs();
+
+    void Calibrate(uint32_t calibrateUs);
+
+    bool m_tscEnabled{ false };
+    uint64_t m_baseTsc{ 0 };
+    int64_t m_baseUs{ 0 };
+    double m_usPerTick{ 0 };
+};
@@ -0,0 +1,325 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <random>
+#include "congestioncontrol.hpp"
+
+/// config of VivaceCongestionControl, rates are in packets per ms
+struct VivaceCongestionCtlConfig
+{
+    double init_rate{ 0.1 };
+    double min_rate{ 0.02 };
+    double max_rate{ 100 };
+    uint32_t min_cwnd{ 4 };
+    uint32_t max_burst{ 8 };/** packets requested at once*/
+    double epsilon{ 0.05 };/** probe rates are rate * (1 +- epsilon)*/
+    double exponent{ 0.9 };/** utility = rate^exponent - latency_coef * rate * dRTT/dT - loss_coef * rate * loss*/
+    double latency_coef{ 900 };
+    double loss_coef{ 11.35 };
+    double rtt_gradient_floor{ 0.01 };/** smaller RTT gradients are noise*/
+    double theta{ 0.05 };/** rate step per unit of utility gradient, scaled by the confidence*/
+    double omega{ 0.05 };/** first bound of a step, as a share of the rate*/
+    double omega_step{ 0.1 };/** the bound grows by this each time a step hits it*/
+    uint32_t min_mi_ms{ 10 };/** shortest monitor interval*/
+    uint32_t min_mi_pkts{ 20 };/** a monitor interval lasts at least this many packets, or the probes are noise*/
+};
+
+/** @brief PCC Vivace (Dong et al., NSDI 2018), an online learning rate control.
+ *  The sending rate is split into monitor intervals of about one RTT. Each pair of probing intervals sends at
+ *  rate*(1+eps) and rate*(1-eps), in random order, and scores each one with the utility
+ *  u = x^0.9 - 900 * x * dRTT/dT - 11.35 * x * loss, x being the rate of the interval. The rate then moves along the
+ *  utility gradient, the step grows with the number of steps in the same direction and is bounded by a share of
+ *  the rate that grows each time a step hits it. Random loss only costs loss_coef * loss, so a few percent of it do
+ *  not turn the gradient, while a growing RTT or a loss rate rising with the rate does.
+ *  Startup doubles the rate each interval while the utility grows. The rate is exposed by GetPacingRate(), the
+ *  window is two rate * RTT so that the pacing is what limits the requests.
+ * */
+class VivaceCongestionControl final : public WindowCongestionCtlAlgo
+{
+public:
+    explicit VivaceCongestionControl(const VivaceCongestionCtlConfig& ccConfig)
+            : WindowCongestionCtlAlgo(ccConfig.min_cwnd, ccConfig.max_burst), m_config(ccConfig),
+              m_rate(ccConfig.init_rate)
+    {
+        m_bwEstimate = m_rate;
+        SPDLOG_DEBUG("init_rate:{}, epsilon:{}", ccConfig.init_rate, ccConfig.epsilon);
+    }
+
+    ~VivaceCongestionControl() override
+    {
+        SPDLOG_DEBUG("");
+    }
+
+    CongestionCtlType GetCCtype() override
+    {
+        return CongestionCtlType::vivace;
+    }
+
+    double GetPacingRate() override
+    {
+        return m_intervals.empty() ? m_rate : m_intervals.back().rate;
+    }
+
+protected:
+    void OnPacketSent(const InflightPacket& sentpkt) override
+    {
+        if (!m_rngSeeded)
+        {
+            m_rng.seed(uint32_t(sentpkt.sendtic.ToDebuggingValue()) ^ (sentpkt.seq * 2654435761U));
+            m_rngSeeded = true;
+        }
+        if (m_intervals.empty() || sentpkt.sendtic >= m_intervals.back().end)
+        {
+            StartInterval(sentpkt.sendtic);
+        }
+        m_intervals.back().sent++;
+    }
+
+    void OnPacketAcked(const AckEvent& ackEvent, double rateSample, RttStats& rttstats) override
+    {
+        m_srtt = rttstats.smoothed_rtt();
+        auto interval = FindInterval(ackEvent.sendtic);
+        if (interval)
+        {
+            interval->acked++;
+            Duration rtt = rttstats.latest_rtt();
+            double x = (ackEvent.recvtic - interval->start).ToMicroseconds() / 1000.0;
+            double y = rtt.ToMicroseconds() / 1000.0;
+            // least squares of the RTT over the ack time
+            interval->n += 1;
+            interval->sumX += x;
+            interval->sumY += y;
+            interval->sumXY += x * y;
+            interval->sumXX += x * x;
+        }
+        ProcessIntervals(ackEvent.recvtic);
+        UpdateCwnd();
+    }
+
+    void OnPacketsLost(const LossEvent& lossEvent, RttStats& rttstats) override
+    {
+        for (const auto& lostpkt: lossEvent.lossPackets)
+        {
+            auto interval = FindInterval(lostpkt.sendtic);
+            if (interval)
+            {
+                interval->lost++;
+            }
+        }
+        ProcessIntervals(lossEvent.losttic);
+        UpdateCwnd();
+    }
+
+private:
+    enum class Role : uint8_t
+    {
+        startup,
+        probeUp,
+        probeDown,
+        hold/** sent while waiting for the results, not scored*/
+    };
+
+    struct MonitorInterval
+    {
+        Role role{ Role::hold };
+        double rate{ 0 };
+        Timepoint start{ Timepoint::Zero() };
+        Timepoint end{ Timepoint::Zero() };
+        uint32_t sent{ 0 };
+        uint32_t acked{ 0 };
+        uint32_t lost{ 0 };
+        double n{ 0 }, sumX{ 0 }, sumY{ 0 }, sumXY{ 0 }, sumXX{ 0 };
+
+        double RttGradient() const
+        {
+            double den = n * sumXX - sumX * sumX;
+            return n >= 2 && den > 0 ? (n * sumXY - sumX * sumY) / den : 0;
+        }
+    };
+
+    void StartInterval(Timepoint now)
+    {
+        MonitorInterval interval;
+        interval.start = now;
+        if (m_startup)
+        {
+            interval.role = m_waitingStartup ? Role::hold : Role::startup;
+            interval.rate = m_rate;
+            m_waitingStartup = interval.role == Role::startup || m_waitingStartup;
+        }
+        else if (!m_pendingRoles.empty())
+        {
+            interval.role = m_pendingRoles.front();
+            m_pendingRoles.pop_front();
+            double sign = interval.role == Role::probeUp ? 1 : -1;
+            interval.rate = m_rate * (1 + sign * m_config.epsilon);
+        }
+        else
+        {
+            interval.role = Role::hold;
+            interval.rate = m_rate;
+        }
+        Duration length = std::max(m_srtt, Duration::FromMilliseconds(m_config.min_mi_ms));
+        length = std::max(length, Duration::FromMicroseconds(int64_t(m_config.min_mi_pkts * 1000 / interval.rate)));
+        interval.end = now + length;
+        m_intervals.push_back(interval);
+    }
+
+    MonitorInterval* FindInterval(Timepoint sendtic)
+    {
+        for (auto itor = m_intervals.rbegin(); itor != m_intervals.rend(); ++itor)
+        {
+            if (sendtic >= itor->start && sendtic < itor->end)
+            {
+                return &*itor;
+            }
+        }
+        return nullptr;
+    }
+
+    double Utility(const MonitorInterval& interval) const
+    {
+        // the target rate of the interval, the count of packets sent in it is too coarse to tell r(1+eps) from r
+        double x = interval.rate;
+        double loss = interval.acked + interval.lost > 0 ? double(interval.lost) / (interval.acked + interval.lost) : 0;
+        double gradient = interval.RttGradient();
+        if (std::fabs(gradient) < m_config.rtt_gradient_floor)
+        {
+            gradient = 0;
+        }
+        return std::pow(x, m_config.exponent) - m_config.latency_coef * x * gradient - m_config.loss_coef * x * loss;
+    }
+
+    /// intervals are scored in order, once every packet they sent is acked or lost
+    void ProcessIntervals(Timepoint now)
+    {
+        while (!m_intervals.empty())
+        {
+            auto& front = m_intervals.front();
+            if (now < front.end || front.acked + front.lost < front.sent)
+            {
+                break;
+            }
+            if (front.sent > 0)
+            {
+                OnIntervalDone(front);
+            }
+            m_intervals.pop_front();
+        }
+    }
+
+    void OnIntervalDone(const MonitorInterval& interval)
+    {
+        double utility = Utility(interval);
+        switch (interval.role)
+        {
+            case Role::startup:
+                m_waitingStartup = false;
+                if (utility > m_lastUtility)
+                {
+                    m_lastUtility = utility;
+                    m_rate = std::min(m_rate * 2, m_config.max_rate);
+                }
+                else
+                {
+                    // the last doubling did not pay, go back and start learning
+                    m_rate = std::max(m_rate / 2, m_config.min_rate);
+                    m_startup = false;
+                    StartProbing();
+                    SPDLOG_DEBUG("exit startup, rate:{}", m_rate);
+                }
+                break;
+            case Role::probeUp:
+                m_upUtility = utility;
+                m_upDone = true;
+                break;
+            case Role::probeDown:
+                m_downUtility = utility;
+                m_downDone = true;
+                break;
+            default:
+                break;
+        }
+        if (m_upDone && m_downDone)
+        {
+            UpdateRate();
+            StartProbing();
+        }
+    }
+
+    void StartProbing()
+    {
+        m_upDone = false;
+        m_downDone = false;
+        m_pendingRoles.clear();
+        if (std::uniform_int_distribution<int>(0, 1)(m_rng))
+        {
+            m_pendingRoles = { Role::probeUp, Role::probeDown };
+        }
+        else
+        {
+            m_pendingRoles = { Role::probeDown, Role::probeUp };
+        }
+    }
+
+    void UpdateRate()
+    {
+        double gradient = (m_upUtility - m_downUtility) / (2 * m_config.epsilon * m_rate);
+        bool up = gradient > 0;
+        if (m_confidence > 0 && up == m_lastUp)
+        {
+            ++m_confidence;
+        }
+        else
+        {
+            m_confidence = 1;
+            m_omega = m_config.omega;
+        }
+        m_lastUp = up;
+        double step = m_config.theta * m_confidence * gradient;
+        double bound = m_omega * m_rate;
+        if (std::fabs(step) > bound)
+        {
+            step = up ? bound : -bound;
+            m_omega += m_config.omega_step;
+        }
+        m_rate = std::max(m_config.min_rate, std::min(m_rate + step, m_config.max_rate));
+        m_bwEstimate = m_rate;
+        SPDLOG_DEBUG("gradient:{}, step:{}, rate:{}", gradient, step, m_rate);
+    }
+
+    void UpdateCwnd()
+    {
+        if (m_startup)
+        {
+            m_bwEstimate = m_rate;
+        }
+        double rttMs = std::max<double>(m_srtt.ToMicroseconds(), 1000) / 1000.0;
+        m_cwnd = std::max(m_config.min_cwnd, uint32_t(std::ceil(2 * GetPacingRate() * rttMs)));
+    }
+
+    VivaceCongestionCtlConfig m_config;
+    double m_rate;
+    Duration m_srtt{ Duration::FromMilliseconds(200) };
+    std::deque<MonitorInterval> m_intervals;
+
+    bool m_startup{ true };
+    bool m_waitingStartup{ false };/** a startup interval is out, later ones only hold the rate*/
+    double m_lastUtility{ -std::numeric_limits<double>::max() };
+
+    std::deque<Role> m_pendingRoles;
+    bool m_upDone{ false };
+    bool m_downDone{ false };
+    double m_upUtility{ 0 };
+    double m_downUtility{ 0 };
+    uint32_t m_confidence{ 0 };
+    bool m_lastUp{ true };
+    double m_omega{ 0 };
+
+    std::minstd_rand m_rng;
+    bool m_rngSeeded{ false };
+};
@@ -0,0 +1,202 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/// Load test DemoTransportCtl on real UDP sockets against peerserver.
+/// usage: loopbackclient <downnode.json> [--tasks 1] [--file-mb 10] [--bitrate bps] [--duration s]
+///                       [--set key=value]... [--trace MPDTrace.txt] [--log level]
+
+#include "spdlog/spdlog.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "sim/simrunner.hpp"
+#include "loopbackdownloadtask.hpp"
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "usage: loopbackclient <downnode.json> [--tasks n] [--file-mb mb] [--bitrate bps]"
+                     " [--duration s] [--set key=value]... [--trace file] [--log level]" << std::endl;
+    }
+
+    double CpuSeconds()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+               + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return -1;
+    }
+    std::string downnodePath(argv[1]);
+    uint32_t taskNum = 1;
+    double fileMB = 10;
+    uint32_t bitrate = 1024 * 1024;
+    double durationSec = 0;
+    std::string tracePath;
+    std::string logLevel = "off";
+    json overrides = json::object();
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (i + 1 >= argc)
+        {
+            PrintUsage();
+            return -1;
+        }
+        std::string value(argv[++i]);
+        if (arg == "--tasks")
+        {
+            taskNum = std::max(1UL, std::stoul(value));
+        }
+        else if (arg == "--file-mb")
+        {
+            fileMB = std::stod(value);
+        }
+        else if (arg == "--bitrate")
+        {
+            bitrate = std::stoul(value);
+        }
+        else if (arg == "--duration")
+        {
+            durationSec = std::stod(value);
+        }
+        else if (arg == "--set")
+        {
+            auto eq = value.find('=');
+            if (eq == std::string::npos)
+            {
+                PrintUsage();
+                return -1;
+            }
+            overrides[value.substr(0, eq)] = json::parse(value.substr(eq + 1));
+        }
+        else if (arg == "--trace")
+        {
+            tracePath = value;
+        }
+        else if (arg == "--log")
+        {
+            logLevel = value;
+        }
+        else
+        {
+            PrintUsage();
+            return -1;
+        }
+    }
+
+    auto logger = spdlog::stdout_color_mt("loopbacklogger");
+    logger->set_pattern("[%H:%M:%S.%e][%t][%l][%s:%# %!()] %v");
+    logger->set_level(spdlog::level::from_str(logLevel));
+    spdlog::set_default_logger(logger);
+
+    DownNodeConfig downNodeConfig;
+    try
+    {
+        std::ifstream in(downnodePath);
+        downNodeConfig = json::parse(in).get<DownNodeConfig>();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Parse downnode config failed: " << downnodePath << " " << e.what() << std::endl;
+        return -1;
+    }
+    // the SDK binds the downnode address, here every task binds an ephemeral port on loopback
+    downNodeConfig.IP = "127.0.0.1";
+    auto ctlConfig = std::make_shared<DemoTransportCtlConfig>();
+    if (!ApplyTransportConfig(overrides, *ctlConfig))
+    {
+        return -1;
+    }
+    auto settings = std::make_shared<DemoTransportModuleSettings>();
+    settings->transportCtlConfig = ctlConfig;
+    settings->transportCtlFactory = std::make_shared<DemoTransportCtlFactory>();
+
+    uint64_t fileLength = uint64_t(fileMB * 1024 * 1024);
+    if (durationSec <= 0)
+    {
+        durationSec = 2.0 * fileLength * 8 / bitrate;
+    }
+
+    std::vector<std::shared_ptr<LoopbackDownloadTask>> tasks;
+    for (uint32_t i = 0; i < taskNum; ++i)
+    {
+        auto task = std::make_shared<LoopbackDownloadTask>(downNodeConfig, fileLength, bitrate);
+        if (!task->Init())
+        {
+            return -1;
+        }
+        tasks.push_back(task);
+    }
+
+    auto wallStart = std::chrono::steady_clock::now();
+    auto cpuStart = CpuSeconds();
+    std::vector<std::thread> threads;
+    for (auto& task: tasks)
+    {
+        // the transport controller is single threaded, each task is driven by its own thread
+        threads.emplace_back([task, settings, durationSec]()
+        {
+            if (task->Start(settings))
+            {
+                task->Run(uint64_t(durationSec * 1e6));
+            }
+        });
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double cpuSec = CpuSeconds() - cpuStart;
+
+    printf("config: %s, tasks: %u, file: %.1f MB\n", ctlConfig->DebugInfo().c_str(), taskNum, fileMB);
+    uint32_t finished = 0;
+    double scoreSum = 0;
+    uint64_t pieces = 0;
+    uint64_t syscalls = 0;
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        const auto& task = tasks[i];
+        const auto score = task->Score();
+        const auto& stats = task->GetStats();
+        finished += task->IsFinished();
+        scoreSum += score.valid ? score.score : 0;
+        pieces += stats.pieceDatagrams;
+        syscalls += stats.requestDatagrams + stats.recvCalls + stats.pollCalls;
+        printf("task %zu finished: %d, elapsed: %.3f s, pieces: %llu, requests: %llu, send errors: %llu,"
+               " stray: %llu, score: %.4f KBps%s%s\n", i, task->IsFinished(), task->ElapsedUs() / 1e6,
+                (unsigned long long) stats.pieceDatagrams, (unsigned long long) stats.requestDatagrams,
+                (unsigned long long) stats.sendErrors, (unsigned long long) stats.strayDatagrams,
+                score.valid ? score.score : 0.0, score.valid ? "" : " ", score.reason.c_str());
+        for (const auto& upnode: task->UpNodes())
+        {
+            printf("    upnode %s requested: %llu received: %llu\n", upnode.peerIdStr.c_str(),
+                    (unsigned long long) upnode.requestedPieces, (unsigned long long) upnode.receivedPieces);
+        }
+    }
+    printf("finished: %u/%zu, mean score: %.4f KBps, wall: %.3f s, cpu: %.3f s, pieces/cpu-s: %.0f,"
+           " syscalls: %llu\n", finished, tasks.size(), scoreSum / tasks.size(), wallSec, cpuSec,
+            cpuSec > 0 ? pieces / cpuSec : 0.0, (unsigned long long) syscalls);
+
+    if (!tracePath.empty() && !tasks.front()->Recorder().WriteTrace(tracePath, tasks.front()->PeerIds()))
+    {
+        std::cerr << "Write trace failed: " << tracePath << std::endl;
+        return -1;
+    }
+    return finished == tasks.size() ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include "configjson.hpp"
+#include "basefw/base/log.h"
+#include "sim/scenario.hpp"
+#include "shapedlink.hpp"
+
+/** One emulated upnode, read from a mininet/config/upnode_mn*.json file. Besides IP, port and selfpeerID
+ *  the file may carry the TCLink options of the upnode's link, applied in userspace by peerserver:
+ *  { "IP": "10.100.2.0", "port": 41111, "selfpeerID": "...",
+ *    "bw": 10, "delay": "30ms", "loss": 1, "max_queue_size": 100, "burst": 15000 }
+ *  bw, max_queue_size and burst shape the pieces sent to the client; delay and loss apply to both directions.
+ * */
+struct LoopbackPeerConfig
+{
+    UpNodeConfig upnode;
+    ShapedLinkConfig link;
+};
+
+inline void from_json(const json& j, LoopbackPeerConfig& peer)
+{
+    peer.upnode.IP = j.value("IP", peer.upnode.IP);
+    peer.upnode.port = j.value("port", peer.upnode.port);
+    peer.upnode.selfpeerID = j.at("selfpeerID").get<std::string>();
+    peer.link.bw = j.value("bw", 0.0);
+    if (j.contains("delay"))
+    {
+        peer.link.delay = ParseDelayMs(j.at("delay"));
+    }
+    peer.link.loss = j.value("loss", 0.0);
+    peer.link.max_queue_size = j.value("max_queue_size", 0U);
+    peer.link.burst = j.value("burst", 0U);
+}
+
+inline bool LoadLoopbackPeerConfig(const std::string& path, LoopbackPeerConfig& peer)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        SPDLOG_ERROR("can't open {}", path);
+        return false;
+    }
+    try
+    {
+        peer = json::parse(in).get<LoopbackPeerConfig>();
+    }
+    catch (const std::exception& e)
+    {
+        SPDLOG_ERROR("parse {} failed: {}", path, e.what());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,387 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "mpd/download/transportcontroller/transportcontroller.hpp"
+#include "configjson.hpp"
+#include "basefw/base/log.h"
+#include "demo/utils/transporttime.h"
+#include "sim/simscore.hpp"
+#include "peerprotocol.hpp"
+
+/** @brief Client side stand-in for the download SDK on real UDP sockets.
+ *  It implements MPDTransCtlHandler, turns DoSendDataRequest() into request datagrams to the upnodes served
+ *  by peerserver and feeds every received piece back to the controller. Like the SDK, everything runs on the
+ *  thread calling Run(): socket reads, the loss detection alarm and the asynchronous OnDataSent() and
+ *  OnPieceTaskAdding() callbacks. Several tasks may run on different threads, each with its own socket.
+ * */
+class LoopbackDownloadTask : public MPDTransCtlHandler,
+                             public std::enable_shared_from_this<LoopbackDownloadTask>
+{
+public:
+    struct UpNode
+    {
+        fw::ID id;
+        std::string peerIdStr;
+        sockaddr_in addr;
+        uint64_t requestedPieces{ 0 };
+        uint64_t receivedPieces{ 0 };
+    };
+
+    struct Stats
+    {
+        uint64_t requestDatagrams{ 0 };
+        uint64_t pieceDatagrams{ 0 };
+        uint64_t recvCalls{ 0 };
+        uint64_t pollCalls{ 0 };
+        uint64_t sendErrors{ 0 };
+        uint64_t strayDatagrams{ 0 };/** unknown sender or bad format*/
+    };
+
+    LoopbackDownloadTask(const DownNodeConfig& config, uint64_t fileLength, uint32_t bitrate)
+            : m_config(config), m_fileLength(fileLength), m_bitrate(bitrate)
+    {
+    }
+
+    ~LoopbackDownloadTask() override
+    {
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+    }
+
+    /// open the client socket on an ephemeral port of config.IP and resolve the upnodes
+    bool Init()
+    {
+        m_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (m_fd < 0)
+        {
+            SPDLOG_ERROR("socket failed: {}", strerror(errno));
+            return false;
+        }
+        int flags = fcntl(m_fd, F_GETFL, 0);
+        fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
+        int rcvbuf = 4 * 1024 * 1024;
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        sockaddr_in local;
+        if (!ToSockAddr(m_config.IP, 0, local)
+            || bind(m_fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0)
+        {
+            SPDLOG_ERROR("bind {} failed: {}", m_config.IP, strerror(errno));
+            return false;
+        }
+        for (const auto& upConfig: m_config.upnodes)
+        {
+            UpNode upnode;
+            upnode.id = fw::ID(upConfig.selfpeerID);
+            upnode.peerIdStr = upConfig.selfpeerID;
+            if (!ToSockAddr(upConfig.IP, upConfig.port, upnode.addr))
+            {
+                SPDLOG_ERROR("bad upnode address {}:{}", upConfig.IP, upConfig.port);
+                return false;
+            }
+            m_upnodeIdx[upnode.id] = uint32_t(m_upnodes.size());
+            m_upnodeByAddr[AddrKey(upnode.addr)] = uint32_t(m_upnodes.size());
+            m_upnodes.push_back(upnode);
+        }
+        m_totalPieces = uint32_t((m_fileLength + peerproto::kPieceBytes - 1) / peerproto::kPieceBytes);
+        return true;
+    }
+
+    /// create the transport controller with the factory in settings and start downloading
+    bool Start(const std::shared_ptr<TransportModuleSettings>& settings)
+    {
+        m_controller = settings->transportCtlFactory->MakeTransportController(settings->transportCtlConfig);
+        if (!m_controller)
+        {
+            SPDLOG_ERROR("factory returns null");
+            return false;
+        }
+        TransportDownloadTaskInfo taskInfo;
+        taskInfo.m_filelength = m_fileLength;
+        taskInfo.m_byterate = m_bitrate / 8;
+        m_controller->StartTransportController(taskInfo, shared_from_this());
+        for (const auto& upnode: m_upnodes)
+        {
+            m_controller->OnSessionCreate(upnode.id);
+        }
+        m_alarmIntervalUs = uint64_t(settings->GetAlarmInterval()) * 1000;
+        m_startUs = NowUs();
+        m_nextAlarmUs = m_startUs + m_alarmIntervalUs;
+        m_isRunning = true;
+        m_controller->OnDownloadTaskStart();
+        return true;
+    }
+
+    /// serve the socket, the alarm and posted callbacks until the download finishes or maxDurationUs elapses
+    void Run(uint64_t maxDurationUs)
+    {
+        uint64_t deadline = m_startUs + maxDurationUs;
+        pollfd fd{ m_fd, POLLIN, 0 };
+        while (m_isRunning)
+        {
+            RunPosted();
+            auto now_us = NowUs();
+            if (now_us >= deadline)
+            {
+                break;
+            }
+            if (now_us >= m_nextAlarmUs)
+            {
+                m_controller->OnLossDetectionAlarm();
+                m_nextAlarmUs = now_us + m_alarmIntervalUs;
+                continue;
+            }
+            if (!m_posted.empty())
+            {
+                continue;
+            }
+            uint64_t wait_us = std::min(m_nextAlarmUs, deadline) - now_us;
+            timespec timeout{ time_t(wait_us / 1000000), long((wait_us % 1000000) * 1000) };
+            ++m_stats.pollCalls;
+            if (ppoll(&fd, 1, &timeout, nullptr) < 0 && errno != EINTR)
+            {
+                SPDLOG_ERROR("ppoll failed: {}", strerror(errno));
+                break;
+            }
+            if (fd.revents & POLLIN)
+            {
+                ReceivePieces();
+            }
+        }
+        Stop();
+    }
+
+    void Stop()
+    {
+        if (!m_controller || m_stopped)
+        {
+            return;
+        }
+        m_isRunning = false;
+        m_stopped = true;
+        m_finishUs = NowUs();
+        m_controller->OnDownloadTaskStop();
+    }
+
+    bool IsFinished() const
+    {
+        return m_uniqueReceived.size() >= m_totalPieces;
+    }
+
+    /////  MPDTransCtlHandler
+    bool DoSendDataRequest(const fw::ID& sessionid, const std::vector<int32_t>& datapieces) override
+    {
+        auto itor = m_upnodeIdx.find(sessionid);
+        if (!m_isRunning || itor == m_upnodeIdx.end() || datapieces.empty())
+        {
+            return false;
+        }
+        auto upIdx = itor->second;
+        auto& upnode = m_upnodes[upIdx];
+        auto senttic = NowUs();
+        std::vector<peerproto::SeqPiece> seqpieces;
+        std::vector<uint32_t> seqs;
+        for (auto piece: datapieces)
+        {
+            seqs.push_back(m_nextSeq++);
+            seqpieces.emplace_back(seqs.back(), piece);
+            m_recorder.OnTx(senttic, piece, seqs.back(), upIdx);
+        }
+        upnode.requestedPieces += datapieces.size();
+        uint8_t buf[1500];
+        for (size_t offset = 0; offset < seqpieces.size(); offset += peerproto::kMaxPiecesPerRequest)
+        {
+            std::vector<peerproto::SeqPiece> chunk(seqpieces.begin() + offset, seqpieces.begin()
+                    + std::min(seqpieces.size(), offset + peerproto::kMaxPiecesPerRequest));
+            auto len = peerproto::EncodeRequest(chunk, buf, sizeof(buf));
+            ++m_stats.requestDatagrams;
+            if (sendto(m_fd, buf, len, 0, reinterpret_cast<const sockaddr*>(&upnode.addr), sizeof(upnode.addr)) < 0)
+            {
+                ++m_stats.sendErrors;
+                SPDLOG_DEBUG("sendto {} failed: {}", upnode.peerIdStr, strerror(errno));
+            }
+        }
+        // the SDK reports the request as sent from the io loop, after this call has returned
+        Post([this, sessionid, datapieces, seqs, senttic]()
+        {
+            m_controller->OnDataSent(sessionid, datapieces, seqs, senttic);
+        });
+        return true;
+    }
+
+    bool DoRequestDatapiecesTask(uint32_t piecesnum) override
+    {
+        if (!m_isRunning || m_nextPiece >= m_totalPieces)
+        {
+            return false;
+        }
+        std::vector<int32_t> pieces;
+        while (pieces.size() < piecesnum && m_nextPiece < m_totalPieces)
+        {
+            pieces.push_back(int32_t(m_nextPiece++));
+        }
+        Post([this, pieces]() mutable
+        {
+            m_controller->OnPieceTaskAdding(pieces);
+        });
+        return true;
+    }
+
+    /////
+    const SimTraceRecorder& Recorder() const
+    {
+        return m_recorder;
+    }
+
+    SimScoreResult Score() const
+    {
+        return m_recorder.Score(double(m_totalPieces), m_bitrate);
+    }
+
+    const std::vector<UpNode>& UpNodes() const
+    {
+        return m_upnodes;
+    }
+
+    std::vector<std::string> PeerIds() const
+    {
+        std::vector<std::string> ids;
+        for (const auto& upnode: m_upnodes)
+        {
+            ids.push_back(upnode.peerIdStr);
+        }
+        return ids;
+    }
+
+    const Stats& GetStats() const
+    {
+        return m_stats;
+    }
+
+    uint64_t ElapsedUs() const
+    {
+        return (m_stopped ? m_finishUs : NowUs()) - m_startUs;
+    }
+
+private:
+    static uint64_t NowUs()
+    {
+        return uint64_t((Clock::GetClock()->Now() - QuicTime::Zero()).ToMicroseconds());
+    }
+
+    static bool ToSockAddr(const std::string& ip, uint16_t port, sockaddr_in& addr)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        return inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) == 1;
+    }
+
+    static uint64_t AddrKey(const sockaddr_in& addr)
+    {
+        return (uint64_t(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+    }
+
+    void Post(std::function<void()> func)
+    {
+        m_posted.push_back(std::move(func));
+    }
+
+    void RunPosted()
+    {
+        // callbacks may post again, those run in the next round like on an io_context
+        auto posted = std::move(m_posted);
+        m_posted.clear();
+        for (auto& func: posted)
+        {
+            if (!m_isRunning)
+            {
+                return;
+            }
+            func();
+        }
+    }
+
+    void ReceivePieces()
+    {
+        uint8_t buf[2048];
+        while (m_isRunning)
+        {
+            sockaddr_in from;
+            socklen_t addrlen = sizeof(from);
+            ++m_stats.recvCalls;
+            auto len = recvfrom(m_fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &addrlen);
+            if (len < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    SPDLOG_WARN("recvfrom failed: {}", strerror(errno));
+                }
+                return;
+            }
+            auto tic_us = NowUs();
+            uint32_t seq;
+            int32_t piece;
+            auto itor = m_upnodeByAddr.find(AddrKey(from));
+            if (itor == m_upnodeByAddr.end() || !peerproto::DecodePiece(buf, size_t(len), seq, piece))
+            {
+                ++m_stats.strayDatagrams;
+                continue;
+            }
+            ++m_stats.pieceDatagrams;
+            auto& upnode = m_upnodes[itor->second];
+            ++upnode.receivedPieces;
+            m_recorder.OnRx(tic_us, piece, seq, itor->second);
+            m_uniqueReceived.insert(piece);
+            m_controller->OnDataPiecesReceived(upnode.id, seq, piece, tic_us);
+            if (IsFinished())
+            {
+                Stop();
+            }
+        }
+    }
+
+    DownNodeConfig m_config;
+    uint64_t m_fileLength;
+    uint32_t m_bitrate;
+    int m_fd{ -1 };
+    std::shared_ptr<MPDTransportController> m_controller;
+    bool m_isRunning{ false };
+    bool m_stopped{ false };
+
+    std::vector<UpNode> m_upnodes;
+    std::map<fw::ID, uint32_t> m_upnodeIdx;
+    std::map<uint64_t, uint32_t> m_upnodeByAddr;
+    std::deque<std::function<void()>> m_posted;
+
+    uint64_t m_startUs{ 0 };
+    uint64_t m_finishUs{ 0 };
+    uint64_t m_alarmIntervalUs{ 100000 };
+    uint64_t m_nextAlarmUs{ 0 };
+
+    uint32_t m_totalPieces{ 0 };
+    uint32_t m_nextPiece{ 0 };
+    uint32_t m_nextSeq{ 1 };
+    std::set<int32_t> m_uniqueReceived;
+    SimTraceRecorder m_recorder;
+    Stats m_stats;
+};
@@ -0,0 +1,107 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/** Wire format between LoopbackDownloadTask and peerserver, all integers in network byte order.
+ *  request: | magic u32 | type u8 = 1 | reserved u8 | count u16 | count x { seq u32, piece i32 } |
+ *  piece:   | magic u32 | type u8 = 2 | reserved u8 | 0 u16     | seq u32 | piece i32 | 1KB payload |
+ *  The upnode answers every requested piece with one piece datagram echoing the seq of the request.
+ * */
+namespace peerproto
+{
+    constexpr uint32_t kMagic = 0x4d50444c;/** "MPDL"*/
+    constexpr uint8_t kTypeRequest = 1;
+    constexpr uint8_t kTypePiece = 2;
+    constexpr size_t kHeaderBytes = 8;
+    constexpr size_t kPieceBytes = 1024;
+    constexpr size_t kPiecePacketBytes = kHeaderBytes + 8 + kPieceBytes;
+    /// keep a request datagram under a typical MTU
+    constexpr size_t kMaxPiecesPerRequest = (1400 - kHeaderBytes) / 8;
+
+    using SeqPiece = std::pair<uint32_t, int32_t>;
+
+    inline void PutU32(uint8_t* buf, uint32_t value)
+    {
+        value = htonl(value);
+        memcpy(buf, &value, sizeof(value));
+    }
+
+    inline uint32_t GetU32(const uint8_t* buf)
+    {
+        uint32_t value;
+        memcpy(&value, buf, sizeof(value));
+        return ntohl(value);
+    }
+
+    inline void PutHeader(uint8_t* buf, uint8_t type, uint16_t count)
+    {
+        PutU32(buf, kMagic);
+        buf[4] = type;
+        buf[5] = 0;
+        uint16_t n = htons(count);
+        memcpy(buf + 6, &n, sizeof(n));
+    }
+
+    /// @return the datagram length, pieces beyond kMaxPiecesPerRequest are not encoded
+    inline size_t EncodeRequest(const std::vector<SeqPiece>& pieces, uint8_t* buf, size_t buflen)
+    {
+        size_t count = std::min(pieces.size(), std::min(kMaxPiecesPerRequest, (buflen - kHeaderBytes) / 8));
+        PutHeader(buf, kTypeRequest, uint16_t(count));
+        uint8_t* pos = buf + kHeaderBytes;
+        for (size_t i = 0; i < count; ++i, pos += 8)
+        {
+            PutU32(pos, pieces[i].first);
+            PutU32(pos + 4, uint32_t(pieces[i].second));
+        }
+        return size_t(pos - buf);
+    }
+
+    inline bool DecodeRequest(const uint8_t* buf, size_t len, std::vector<SeqPiece>& pieces)
+    {
+        if (len < kHeaderBytes || GetU32(buf) != kMagic || buf[4] != kTypeRequest)
+        {
+            return false;
+        }
+        uint16_t count;
+        memcpy(&count, buf + 6, sizeof(count));
+        count = ntohs(count);
+        if (len < kHeaderBytes + size_t(count) * 8)
+        {
+            return false;
+        }
+        pieces.clear();
+        const uint8_t* pos = buf + kHeaderBytes;
+        for (uint16_t i = 0; i < count; ++i, pos += 8)
+        {
+            pieces.emplace_back(GetU32(pos), int32_t(GetU32(pos + 4)));
+        }
+        return true;
+    }
+
+    /// the payload is left as it is in buf, only the header is written
+    inline size_t EncodePiece(uint32_t seq, int32_t piece, uint8_t* buf)
+    {
+        PutHeader(buf, kTypePiece, 0);
+        PutU32(buf + kHeaderBytes, seq);
+        PutU32(buf + kHeaderBytes + 4, uint32_t(piece));
+        return kPiecePacketBytes;
+    }
+
+    inline bool DecodePiece(const uint8_t* buf, size_t len, uint32_t& seq, int32_t& piece)
+    {
+        if (len < kHeaderBytes + 8 || GetU32(buf) != kMagic || buf[4] != kTypePiece)
+        {
+            return false;
+        }
+        seq = GetU32(buf + kHeaderBytes);
+        piece = int32_t(GetU32(buf + kHeaderBytes + 4));
+        return true;
+    }
+}
@@ -0,0 +1,360 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/// Loopback stand-in for mininet/bin/servertest: one process serving several upnodes over UDP,
+/// each with its own userspace shaped link configured from an upnode_mn*.json file.
+/// usage: peerserver [--bind 127.0.0.1] [--downnode downnode_lo.json] [--stats-sec 5] [--log level]
+///                   upnode0.json [upnode1.json]...
+
+#include "spdlog/spdlog.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "loopbackconfig.hpp"
+#include "peerprotocol.hpp"
+
+namespace
+{
+    volatile std::sig_atomic_t g_stop = 0;
+
+    void OnSignal(int)
+    {
+        g_stop = 1;
+    }
+
+    uint64_t SteadyNowUs()
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void PrintUsage()
+    {
+        std::cerr << "usage: peerserver [--bind ip] [--downnode file] [--stats-sec s] [--log level]"
+                     " upnode.json..." << std::endl;
+    }
+}
+
+class PeerServer
+{
+public:
+    ~PeerServer()
+    {
+        for (auto& peer: m_peers)
+        {
+            if (peer.fd >= 0)
+            {
+                close(peer.fd);
+            }
+        }
+    }
+
+    /// bind one socket per upnode on bindIP, a port already taken by an earlier upnode is bumped
+    bool Init(const std::vector<LoopbackPeerConfig>& configs, const std::string& bindIP)
+    {
+        std::set<uint16_t> usedPorts;
+        auto now_us = SteadyNowUs();
+        m_peers.resize(configs.size());
+        for (size_t i = 0; i < configs.size(); ++i)
+        {
+            auto& peer = m_peers[i];
+            peer.config = configs[i];
+            peer.config.upnode.IP = bindIP;
+            while (usedPorts.count(peer.config.upnode.port) > 0)
+            {
+                ++peer.config.upnode.port;
+            }
+            usedPorts.insert(peer.config.upnode.port);
+            if (!OpenSocket(peer))
+            {
+                return false;
+            }
+            // requests are small, they only see the delay and loss of the link
+            ShapedLinkConfig requestLink;
+            requestLink.delay = peer.config.link.delay;
+            requestLink.loss = peer.config.link.loss;
+            peer.requestLink.Init(requestLink, 2 * i + 1, now_us);
+            peer.pieceLink.Init(peer.config.link, 2 * i + 2, now_us);
+            SPDLOG_INFO("upnode {} on {}:{}, bw: {} Mbps, delay: {} ms, loss: {}%, queue: {}",
+                    peer.config.upnode.selfpeerID, bindIP, peer.config.upnode.port, peer.config.link.bw,
+                    peer.config.link.delay, peer.config.link.loss, peer.config.link.max_queue_size);
+        }
+        return true;
+    }
+
+    /// the downnode config a client needs to reach the upnodes on their final ports
+    DownNodeConfig MakeDownNodeConfig(const std::string& bindIP) const
+    {
+        DownNodeConfig downnode;
+        downnode.IP = bindIP;
+        downnode.port = 0;
+        downnode.upnodes.clear();
+        for (const auto& peer: m_peers)
+        {
+            downnode.upnodes.push_back(peer.config.upnode);
+        }
+        return downnode;
+    }
+
+    void Run(uint32_t statsSec)
+    {
+        std::vector<pollfd> fds;
+        for (const auto& peer: m_peers)
+        {
+            fds.push_back(pollfd{ peer.fd, POLLIN, 0 });
+        }
+        uint64_t nextStats = statsSec > 0 ? SteadyNowUs() + statsSec * 1000000ULL : ShapedLink<int>::kNever;
+        while (!g_stop)
+        {
+            auto now_us = SteadyNowUs();
+            uint64_t next = nextStats;
+            for (auto& peer: m_peers)
+            {
+                ReceiveRequests(peer, now_us);
+                Forward(peer, now_us);
+                next = std::min(next, peer.requestLink.NextEventTime(now_us));
+                next = std::min(next, peer.pieceLink.NextEventTime(now_us));
+            }
+            if (now_us >= nextStats)
+            {
+                PrintStats();
+                nextStats = now_us + statsSec * 1000000ULL;
+            }
+            // the shaper is served with microsecond timers, poll() only has ms resolution
+            timespec timeout{ 1, 0 };
+            if (next != ShapedLink<int>::kNever)
+            {
+                uint64_t wait_us = next > now_us ? next - now_us : 0;
+                timeout.tv_sec = time_t(std::min<uint64_t>(wait_us / 1000000, 1));
+                timeout.tv_nsec = long(wait_us >= 1000000 ? 0 : (wait_us % 1000000) * 1000);
+            }
+            if (ppoll(fds.data(), fds.size(), &timeout, nullptr) < 0 && errno != EINTR)
+            {
+                SPDLOG_ERROR("ppoll failed: {}", strerror(errno));
+                break;
+            }
+        }
+        PrintStats();
+    }
+
+private:
+    struct Request
+    {
+        sockaddr_in from;
+        std::vector<peerproto::SeqPiece> pieces;
+    };
+
+    struct PiecePacket
+    {
+        sockaddr_in to;
+        uint32_t seq;
+        int32_t piece;
+    };
+
+    struct Peer
+    {
+        LoopbackPeerConfig config;
+        int fd{ -1 };
+        ShapedLink<Request> requestLink;
+        ShapedLink<PiecePacket> pieceLink;
+        uint64_t requests{ 0 };
+        uint64_t badDatagrams{ 0 };
+        uint64_t sendErrors{ 0 };
+    };
+
+    bool OpenSocket(Peer& peer)
+    {
+        peer.fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (peer.fd < 0)
+        {
+            SPDLOG_ERROR("socket failed: {}", strerror(errno));
+            return false;
+        }
+        int flags = fcntl(peer.fd, F_GETFL, 0);
+        fcntl(peer.fd, F_SETFL, flags | O_NONBLOCK);
+        // the delay line holds the pieces, the kernel buffer only has to absorb one burst
+        int sndbuf = 4 * 1024 * 1024;
+        setsockopt(peer.fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(peer.config.upnode.port);
+        if (inet_pton(AF_INET, peer.config.upnode.IP.c_str(), &addr.sin_addr) != 1)
+        {
+            SPDLOG_ERROR("bad IP {}", peer.config.upnode.IP);
+            return false;
+        }
+        if (bind(peer.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            SPDLOG_ERROR("bind {}:{} failed: {}", peer.config.upnode.IP, peer.config.upnode.port, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    void ReceiveRequests(Peer& peer, uint64_t now_us)
+    {
+        uint8_t buf[2048];
+        while (true)
+        {
+            Request request;
+            socklen_t addrlen = sizeof(request.from);
+            auto len = recvfrom(peer.fd, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&request.from), &addrlen);
+            if (len < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    SPDLOG_WARN("recvfrom failed: {}", strerror(errno));
+                }
+                return;
+            }
+            if (!peerproto::DecodeRequest(buf, size_t(len), request.pieces))
+            {
+                ++peer.badDatagrams;
+                continue;
+            }
+            ++peer.requests;
+            peer.requestLink.Enqueue(now_us, std::move(request), uint32_t(len));
+        }
+    }
+
+    /// arrived requests turn into piece packets, released piece packets go to the socket
+    void Forward(Peer& peer, uint64_t now_us)
+    {
+        peer.requestLink.Dequeue(now_us, [&peer, now_us](const Request& request)
+        {
+            for (const auto& seqpiece: request.pieces)
+            {
+                peer.pieceLink.Enqueue(now_us, PiecePacket{ request.from, seqpiece.first, seqpiece.second },
+                        uint32_t(peerproto::kPiecePacketBytes));
+            }
+        });
+        peer.pieceLink.Dequeue(now_us, [this, &peer](const PiecePacket& packet)
+        {
+            auto len = peerproto::EncodePiece(packet.seq, packet.piece, m_sendBuf);
+            if (sendto(peer.fd, m_sendBuf, len, 0, reinterpret_cast<const sockaddr*>(&packet.to),
+                    sizeof(packet.to)) < 0)
+            {
+                ++peer.sendErrors;
+            }
+        });
+    }
+
+    void PrintStats() const
+    {
+        for (const auto& peer: m_peers)
+        {
+            const auto& stats = peer.pieceLink.GetStats();
+            SPDLOG_INFO("upnode {} requests: {} pieces offered: {} sent: {} random loss: {} queue drops: {}"
+                        " max queue: {} request loss: {} bad datagrams: {} send errors: {}",
+                    peer.config.upnode.selfpeerID, peer.requests, stats.offered, stats.sent, stats.randomLoss,
+                    stats.queueDrops, stats.maxQueue, peer.requestLink.GetStats().randomLoss, peer.badDatagrams,
+                    peer.sendErrors);
+        }
+    }
+
+    std::vector<Peer> m_peers;
+    uint8_t m_sendBuf[peerproto::kPiecePacketBytes]{};
+};
+
+int main(int argc, char** argv)
+{
+    std::string bindIP = "127.0.0.1";
+    std::string downnodePath;
+    std::string logLevel = "info";
+    uint32_t statsSec = 0;
+    std::vector<std::string> upnodePaths;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            upnodePaths.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            PrintUsage();
+            return -1;
+        }
+        std::string value(argv[++i]);
+        if (arg == "--bind")
+        {
+            bindIP = value;
+        }
+        else if (arg == "--downnode")
+        {
+            downnodePath = value;
+        }
+        else if (arg == "--stats-sec")
+        {
+            statsSec = std::stoul(value);
+        }
+        else if (arg == "--log")
+        {
+            logLevel = value;
+        }
+        else
+        {
+            PrintUsage();
+            return -1;
+        }
+    }
+    if (upnodePaths.empty())
+    {
+        PrintUsage();
+        return -1;
+    }
+
+    auto logger = spdlog::stdout_color_mt("peerlogger");
+    logger->set_pattern("[%H:%M:%S.%e][%l] %v");
+    logger->set_level(spdlog::level::from_str(logLevel));
+    spdlog::set_default_logger(logger);
+
+    std::vector<LoopbackPeerConfig> configs;
+    for (const auto& path: upnodePaths)
+    {
+        LoopbackPeerConfig config;
+        if (!LoadLoopbackPeerConfig(path, config))
+        {
+            return -1;
+        }
+        configs.push_back(config);
+    }
+
+    PeerServer server;
+    if (!server.Init(configs, bindIP))
+    {
+        return -1;
+    }
+    if (!downnodePath.empty())
+    {
+        std::ofstream out(downnodePath);
+        out << json(server.MakeDownNodeConfig(bindIP)).dump(4) << std::endl;
+        if (!out)
+        {
+            std::cerr << "Write downnode config failed: " << downnodePath << std::endl;
+            return -1;
+        }
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    server.Run(statsSec);
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <random>
+
+/// the TCLink options applied to one direction of a link
+struct ShapedLinkConfig
+{
+    double bw{ 0 };/** Mbit/s, 0 means unlimited*/
+    double delay{ 0 };/** ms*/
+    double loss{ 0 };/** percent*/
+    uint32_t max_queue_size{ 0 };/** packets, 0 means unlimited*/
+    uint32_t burst{ 0 };/** bytes, 0 picks 10 full size packets*/
+};
+
+struct ShapedLinkStats
+{
+    uint64_t offered{ 0 };
+    uint64_t sent{ 0 };
+    uint64_t randomLoss{ 0 };
+    uint64_t queueDrops{ 0 };
+    uint64_t maxQueue{ 0 };
+};
+
+/** @brief Userspace stand-in for the tc qdiscs mininet puts on a TCLink, in one direction:
+ *  random loss -> drop tail queue -> token bucket (rate, burst) -> constant delay line.
+ *  All times are steady clock microseconds supplied by the caller, nothing here reads a clock or blocks.
+ * */
+template<typename Packet>
+class ShapedLink
+{
+public:
+    static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+    void Init(const ShapedLinkConfig& config, uint64_t seed, uint64_t now_us)
+    {
+        m_config = config;
+        m_bytesPerUs = config.bw * 1e6 / 8 / 1e6;
+        m_burst = config.burst > 0 ? config.burst : 10 * 1500;
+        m_tokens = m_burst;
+        m_lastRefill = now_us;
+        m_delayUs = uint64_t(config.delay * 1000);
+        m_rng.seed(seed);
+    }
+
+    /// @return false if the packet is dropped
+    bool Enqueue(uint64_t now_us, Packet packet, uint32_t bytes)
+    {
+        ++m_stats.offered;
+        if (m_config.loss > 0 && m_uniform(m_rng) * 100 < m_config.loss)
+        {
+            ++m_stats.randomLoss;
+            return false;
+        }
+        if (m_config.max_queue_size > 0 && m_queue.size() >= m_config.max_queue_size)
+        {
+            ++m_stats.queueDrops;
+            return false;
+        }
+        m_queue.push_back(Queued{ std::move(packet), bytes });
+        m_stats.maxQueue = std::max<uint64_t>(m_stats.maxQueue, m_queue.size());
+        Service(now_us);
+        return true;
+    }
+
+    /// move the packets whose delay has elapsed to out, in FIFO order
+    template<typename OutFunc>
+    void Dequeue(uint64_t now_us, OutFunc&& out)
+    {
+        Service(now_us);
+        while (!m_delayLine.empty() && m_delayLine.front().release_us <= now_us)
+        {
+            ++m_stats.sent;
+            out(m_delayLine.front().packet);
+            m_delayLine.pop_front();
+        }
+    }
+
+    /// the earliest time Dequeue() may have something to output, kNever if idle
+    uint64_t NextEventTime(uint64_t now_us)
+    {
+        Service(now_us);
+        uint64_t next = m_delayLine.empty() ? kNever : m_delayLine.front().release_us;
+        if (!m_queue.empty())
+        {
+            // not enough tokens for the head of the queue, otherwise Service() would have released it
+            double lack = m_queue.front().bytes - m_tokens;
+            uint64_t ready = now_us + uint64_t(std::max(lack, 0.0) / m_bytesPerUs) + 1;
+            next = std::min(next, ready);
+        }
+        return next;
+    }
+
+    size_t QueueLength() const
+    {
+        return m_queue.size();
+    }
+
+    const ShapedLinkStats& GetStats() const
+    {
+        return m_stats;
+    }
+
+private:
+    struct Queued
+    {
+        Packet packet;
+        uint32_t bytes;
+    };
+
+    struct Delayed
+    {
+        Packet packet;
+        uint64_t release_us;
+    };
+
+    void Service(uint64_t now_us)
+    {
+        if (m_bytesPerUs <= 0)
+        {
+            for (auto& queued: m_queue)
+            {
+                m_delayLine.push_back(Delayed{ std::move(queued.packet), now_us + m_delayUs });
+            }
+            m_queue.clear();
+            return;
+        }
+        if (now_us > m_lastRefill)
+        {
+            m_tokens = std::min<double>(m_burst, m_tokens + (now_us - m_lastRefill) * m_bytesPerUs);
+            m_lastRefill = now_us;
+        }
+        while (!m_queue.empty() && m_tokens >= m_queue.front().bytes)
+        {
+            m_tokens -= m_queue.front().bytes;
+            m_delayLine.push_back(Delayed{ std::move(m_queue.front().packet), now_us + m_delayUs });
+            m_queue.pop_front();
+        }
+    }
+
+    ShapedLinkConfig m_config;
+    double m_bytesPerUs{ 0 };
+    double m_burst{ 0 };
+    double m_tokens{ 0 };
+    uint64_t m_lastRefill{ 0 };
+    uint64_t m_delayUs{ 0 };
+    std::deque<Queued> m_queue;
+    std::deque<Delayed> m_delayLine;
+    ShapedLinkStats m_stats;
+    std::mt19937_64 m_rng;
+    std::uniform_real_distribution<double> m_uniform{ 0.0, 1.0 };
+};
+
+template<typename Packet>
+constexpr uint64_t ShapedLink<Packet>::kNever;
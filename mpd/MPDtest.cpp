@@ -47,7 +47,7 @@ int main(int argc, char** argv)
 
 
     ///////////////Create a Transport Module Setting///////////////
-    std::shared_ptr<TransportModuleSettings> myTransportModuleSettings = std::make_shared<TransportModuleSettings>();
+    std::shared_ptr<TransportModuleSettings> myTransportModuleSettings = std::make_shared<DemoTransportModuleSettings>();
 
     // create your TransportCtlConfig class here. The parameters inside this class will be passed to
     // your TransportController.
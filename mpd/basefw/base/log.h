@@ -11,5 +11,6 @@
 
 #endif
 
-
-
+/// guard the log statements whose arguments are expensive to build, e.g. a dump of a whole container,
+/// spdlog evaluates the arguments even if the level is disabled at runtime
+#define BASEFW_LOG_ENABLED(lvl) (spdlog::default_logger_raw()->should_log(lvl))
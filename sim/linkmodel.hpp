@@ -0,0 +1,297 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "basefw/base/log.h"
+#include "demo/utils/transporttime.h"
+
+/// A step function of time, each entry is {ms since the simulation start, value}
+using TimeSchedule = std::vector<std::pair<double, double>>;
+
+/// Parameters of one emulated link, the names follow the TCLink options used in mininet/topos.py
+struct LinkModelConfig
+{
+    std::string name;
+    double bw{ 0 };/** Mbit/s, 0 means unlimited*/
+    std::string trace;/** Mahimahi style delivery opportunity trace, overrides bw*/
+    double delay{ 0 };/** one way propagation delay in ms*/
+    double loss{ 0 };/** random loss in percent, applied in both directions*/
+    uint32_t max_queue_size{ 0 };/** packets, 0 means unlimited*/
+    TimeSchedule bw_schedule;/** Mbit/s, only used without a trace*/
+    TimeSchedule delay_schedule;/** ms*/
+    TimeSchedule loss_schedule;/** percent*/
+};
+
+/** @brief Emulate one direction of a link: a drop tail FIFO served either at a fixed (scheduled) rate
+ *  or by the delivery opportunities of a Mahimahi trace, followed by a propagation delay line.
+ *  Trace format: one integer per line, the ms timestamp of an opportunity to deliver kMtuBytes bytes.
+ *  The trace loops with a period equal to its last timestamp, like mm-link does.
+ *  Packets must be offered in non decreasing time order, which the event loop guarantees.
+ * */
+class LinkModel
+{
+public:
+    static constexpr uint32_t kMtuBytes = 1500;
+
+    bool Init(const LinkModelConfig& config, const std::string& baseDir, Timepoint starttime, uint64_t seed)
+    {
+        m_config = config;
+        m_startTime = starttime;
+        m_lastDeparture = starttime;
+        m_rng.seed(seed);
+        if (!m_config.trace.empty())
+        {
+            auto path = m_config.trace;
+            if (!path.empty() && path[0] != '/' && !baseDir.empty())
+            {
+                path = baseDir + "/" + path;
+            }
+            if (!LoadTrace(path))
+            {
+                return false;
+            }
+        }
+        SPDLOG_DEBUG("link: {}, bw: {}, trace opportunities: {}, delay: {}, loss: {}, queue: {}",
+                m_config.name, m_config.bw, m_trace.size(), m_config.delay, m_config.loss,
+                m_config.max_queue_size);
+        return true;
+    }
+
+    const std::string& Name() const
+    {
+        return m_config.name;
+    }
+
+    /** @brief offer a packet to the link
+     * @param now the time point the packet arrives at the link
+     * @param bytes packet size
+     * @param exittime output, the time point the packet leaves the far end of the link
+     * @return false if the packet is dropped by the queue or the random loss
+     * */
+    bool Transmit(Timepoint now, uint32_t bytes, Timepoint& exittime)
+    {
+        ++m_stats.offered;
+        if (IsLost(now))
+        {
+            ++m_stats.randomLoss;
+            return false;
+        }
+        while (!m_queue.empty() && m_queue.front() <= now)
+        {
+            m_queue.pop_front();
+        }
+        if (m_config.max_queue_size > 0 && m_queue.size() >= m_config.max_queue_size)
+        {
+            ++m_stats.queueDrops;
+            return false;
+        }
+        Timepoint departure = now;
+        if (!m_trace.empty())
+        {
+            departure = TraceDeparture(now, bytes);
+        }
+        else
+        {
+            double bw = ValueAt(m_config.bw_schedule, now, m_config.bw);
+            if (bw > 0)
+            {
+                auto start = std::max(now, m_lastDeparture);
+                departure = start + Duration::FromMicroseconds(int64_t(bytes * 8.0 / bw));
+            }
+        }
+        m_lastDeparture = departure;
+        if (departure > now)
+        {
+            m_queue.push_back(departure);
+        }
+        m_stats.maxQueue = std::max<uint64_t>(m_stats.maxQueue, m_queue.size());
+        ++m_stats.delivered;
+        m_stats.deliveredBytes += bytes;
+        exittime = departure + PropagationDelay(departure);
+        return true;
+    }
+
+    /// requests flow in the opposite direction, they are tiny, so only delay and loss apply
+    bool TransmitReverse(Timepoint now, Timepoint& exittime)
+    {
+        if (IsLost(now))
+        {
+            ++m_stats.reverseLoss;
+            return false;
+        }
+        exittime = now + PropagationDelay(now);
+        return true;
+    }
+
+    /// the number of bytes the link is able to deliver in [from, to)
+    uint64_t CapacityBytes(Timepoint from, Timepoint to) const
+    {
+        if (!(from < to))
+        {
+            return 0;
+        }
+        if (!m_trace.empty())
+        {
+            return (OpportunityIndex(to) - OpportunityIndex(from)) * kMtuBytes;
+        }
+        double bw = ValueAt(m_config.bw_schedule, from, m_config.bw);
+        if (bw <= 0)
+        {
+            return std::numeric_limits<uint64_t>::max();
+        }
+        return uint64_t(bw * (to - from).ToMicroseconds() / 8.0);
+    }
+
+    uint32_t QueueLength(Timepoint now) const
+    {
+        return uint32_t(std::count_if(m_queue.begin(), m_queue.end(), [now](Timepoint t)
+        {
+            return now < t;
+        }));
+    }
+
+    bool IsRateLimited() const
+    {
+        return !m_trace.empty() || m_config.bw > 0 || !m_config.bw_schedule.empty();
+    }
+
+    struct Stats
+    {
+        uint64_t offered{ 0 };
+        uint64_t delivered{ 0 };
+        uint64_t deliveredBytes{ 0 };
+        uint64_t randomLoss{ 0 };
+        uint64_t queueDrops{ 0 };
+        uint64_t reverseLoss{ 0 };
+        uint64_t maxQueue{ 0 };
+    };
+
+    const Stats& GetStats() const
+    {
+        return m_stats;
+    }
+
+private:
+    bool LoadTrace(const std::string& path)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            SPDLOG_ERROR("can't open trace file: {}", path);
+            return false;
+        }
+        int64_t ms = 0;
+        while (in >> ms)
+        {
+            if (!m_trace.empty() && ms < m_trace.back())
+            {
+                SPDLOG_ERROR("trace {} is not sorted", path);
+                return false;
+            }
+            m_trace.push_back(ms);
+        }
+        if (m_trace.empty() || m_trace.back() <= 0)
+        {
+            SPDLOG_ERROR("trace {} is empty", path);
+            return false;
+        }
+        m_tracePeriodUs = m_trace.back() * 1000;
+        return true;
+    }
+
+    /// time point of the idx-th delivery opportunity
+    Timepoint OpportunityTime(uint64_t idx) const
+    {
+        auto cycles = idx / m_trace.size();
+        auto offsetUs = m_trace[idx % m_trace.size()] * 1000;
+        return m_startTime + Duration::FromMicroseconds(cycles * m_tracePeriodUs + offsetUs);
+    }
+
+    /// index of the first opportunity at or after t
+    uint64_t OpportunityIndex(Timepoint t) const
+    {
+        auto elapsedUs = std::max<int64_t>((t - m_startTime).ToMicroseconds(), 0);
+        uint64_t cycles = elapsedUs / m_tracePeriodUs;
+        int64_t offsetUs = elapsedUs % m_tracePeriodUs;
+        auto itor = std::lower_bound(m_trace.begin(), m_trace.end(), offsetUs, [](int64_t ms, int64_t us)
+        {
+            return ms * 1000 < us;
+        });
+        return cycles * m_trace.size() + (itor - m_trace.begin());
+    }
+
+    Timepoint TraceDeparture(Timepoint now, uint32_t bytes)
+    {
+        if (OpportunityTime(m_oppIdx) < now || !m_oppStarted)
+        {
+            // the queue has been drained, unused opportunities are lost
+            m_oppIdx = std::max(m_oppIdx, OpportunityIndex(now));
+            m_oppBytesLeft = kMtuBytes;
+            m_oppStarted = true;
+        }
+        uint32_t need = bytes;
+        while (need > m_oppBytesLeft)
+        {
+            need -= m_oppBytesLeft;
+            ++m_oppIdx;
+            m_oppBytesLeft = kMtuBytes;
+        }
+        m_oppBytesLeft -= need;
+        return OpportunityTime(m_oppIdx);
+    }
+
+    bool IsLost(Timepoint now)
+    {
+        double loss = ValueAt(m_config.loss_schedule, now, m_config.loss);
+        if (loss <= 0)
+        {
+            return false;
+        }
+        return m_uniform(m_rng) * 100.0 < loss;
+    }
+
+    Duration PropagationDelay(Timepoint now) const
+    {
+        double delayms = ValueAt(m_config.delay_schedule, now, m_config.delay);
+        return Duration::FromMicroseconds(int64_t(std::max(delayms, 0.0) * 1000));
+    }
+
+    double ValueAt(const TimeSchedule& schedule, Timepoint now, double defaultValue) const
+    {
+        double value = defaultValue;
+        double nowms = (now - m_startTime).ToMicroseconds() / 1000.0;
+        for (const auto& step: schedule)
+        {
+            if (step.first > nowms)
+            {
+                break;
+            }
+            value = step.second;
+        }
+        return value;
+    }
+
+    LinkModelConfig m_config;
+    Timepoint m_startTime{ Timepoint::Zero() };
+    Timepoint m_lastDeparture{ Timepoint::Zero() };
+    std::deque<Timepoint> m_queue;/** departure time of every packet still in the queue*/
+
+    std::vector<int64_t> m_trace;
+    int64_t m_tracePeriodUs{ 0 };
+    uint64_t m_oppIdx{ 0 };
+    uint32_t m_oppBytesLeft{ 0 };
+    bool m_oppStarted{ false };
+
+    std::mt19937_64 m_rng;
+    std::uniform_real_distribution<double> m_uniform{ 0.0, 1.0 };
+    Stats m_stats;
+};
@@ -0,0 +1,135 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "basefw/base/log.h"
+#include "linkmodel.hpp"
+
+using json = nlohmann::json;
+
+/** An offline download scenario, loaded from a json file:
+ * {
+ *   "name": "topo1", "seed": 1,
+ *   "file_length": 10485760, "bitrate": 1048576, "max_duration": 160,
+ *   "links": [ {"name": "bottleneck", "bw": 10, "delay": "30ms", "loss": 1, "max_queue_size": 100}, ... ],
+ *   "upnodes": [ {"selfpeerID": "...", "path": ["server0", "bottleneck", "client"]}, ... ],
+ *   "transport": { "period": 4, "peak_gain": 0.25 }
+ * }
+ * Link fields are described in LinkModelConfig. A path lists the links a data piece passes from the
+ * upnode to us, requests go the opposite way.
+ * */
+struct SimUpNodeConfig
+{
+    std::string selfpeerID;
+    std::vector<std::string> path;
+};
+
+struct SimScenario
+{
+    std::string name;
+    uint64_t seed{ 1 };
+    uint64_t file_length{ 10 * 1024 * 1024 };/** bytes*/
+    uint32_t bitrate{ 1024 * 1024 };/** video bitrate in bps*/
+    double max_duration{ 0 };/** seconds, 0 means twice the video duration*/
+    std::vector<LinkModelConfig> links;
+    std::vector<SimUpNodeConfig> upnodes;
+    json transport;/** DemoTransportCtlConfig fields, see ApplyTransportConfig()*/
+    std::string baseDir;/** directory of the scenario file, relative trace paths start here*/
+
+    double VideoDurationSec() const
+    {
+        return double(file_length) * 8.0 / bitrate;
+    }
+
+    double MaxDurationSec() const
+    {
+        return max_duration > 0 ? max_duration : 2 * VideoDurationSec();
+    }
+};
+
+/// "30ms", "1s", "500us" or a plain number of ms
+inline double ParseDelayMs(const json& j)
+{
+    if (j.is_number())
+    {
+        return j.get<double>();
+    }
+    auto str = j.get<std::string>();
+    size_t pos = 0;
+    double value = std::stod(str, &pos);
+    auto unit = str.substr(pos);
+    if (unit == "us")
+    {
+        return value / 1000.0;
+    }
+    if (unit == "s")
+    {
+        return value * 1000.0;
+    }
+    return value;
+}
+
+inline void from_json(const json& j, LinkModelConfig& link)
+{
+    link.name = j.value("name", std::string());
+    link.bw = j.value("bw", 0.0);
+    link.trace = j.value("trace", std::string());
+    if (j.contains("delay"))
+    {
+        link.delay = ParseDelayMs(j.at("delay"));
+    }
+    link.loss = j.value("loss", 0.0);
+    link.max_queue_size = j.value("max_queue_size", 0U);
+    link.bw_schedule = j.value("bw_schedule", TimeSchedule());
+    link.delay_schedule = j.value("delay_schedule", TimeSchedule());
+    link.loss_schedule = j.value("loss_schedule", TimeSchedule());
+}
+
+inline void from_json(const json& j, SimUpNodeConfig& upnode)
+{
+    upnode.selfpeerID = j.at("selfpeerID").get<std::string>();
+    upnode.path = j.value("path", std::vector<std::string>());
+}
+
+inline void from_json(const json& j, SimScenario& scenario)
+{
+    scenario.name = j.value("name", std::string());
+    scenario.seed = j.value("seed", uint64_t(1));
+    scenario.file_length = j.value("file_length", uint64_t(10 * 1024 * 1024));
+    scenario.bitrate = j.value("bitrate", uint32_t(1024 * 1024));
+    scenario.max_duration = j.value("max_duration", 0.0);
+    scenario.links = j.at("links").get<std::vector<LinkModelConfig>>();
+    scenario.upnodes = j.at("upnodes").get<std::vector<SimUpNodeConfig>>();
+    scenario.transport = j.value("transport", json::object());
+}
+
+inline bool LoadSimScenario(const std::string& path, SimScenario& scenario)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        SPDLOG_ERROR("can't open scenario file: {}", path);
+        return false;
+    }
+    try
+    {
+        json j = json::parse(in);
+        scenario = j.get<SimScenario>();
+    }
+    catch (const std::exception& e)
+    {
+        SPDLOG_ERROR("parse scenario {} failed: {}", path, e.what());
+        return false;
+    }
+    auto slash = path.find_last_of('/');
+    scenario.baseDir = slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    if (scenario.name.empty())
+    {
+        scenario.name = path;
+    }
+    return true;
+}
@@ -0,0 +1,375 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "mpd/download/transportcontroller/transportcontroller.hpp"
+#include "basefw/base/log.h"
+#include "linkmodel.hpp"
+#include "scenario.hpp"
+#include "simeventloop.hpp"
+#include "simscore.hpp"
+
+/** @brief Offline stand-in for the download SDK and the upnodes (mininet/bin/servertest).
+ *  It drives an MPDTransportController through the same callbacks the SDK uses, forwards the data requests
+ *  to emulated upnodes, which answer each requested piece with one packet sent back to back along the
+ *  emulated path. Everything runs on a SimEventLoop, so a download takes milliseconds of CPU time and the
+ *  result only depends on the scenario and its seed.
+ * */
+class SimDownloadTask : public MPDTransCtlHandler,
+                        public std::enable_shared_from_this<SimDownloadTask>
+{
+public:
+    /// bytes on the wire of one piece packet: 1KB data piece plus headers
+    static constexpr uint32_t kPiecePacketBytes = 1024 + 76;
+    static constexpr uint32_t kPieceBytes = 1024;
+
+    struct UpNode
+    {
+        fw::ID id;
+        std::string peerIdStr;
+        std::vector<LinkModel*> path;
+        uint64_t requestedPieces{ 0 };
+        uint64_t receivedPieces{ 0 };
+        uint64_t lostRequests{ 0 };
+    };
+
+    /// one row of the timeline, sampled every sample interval
+    struct TimelineSample
+    {
+        uint64_t time_ms;
+        std::vector<uint64_t> linkCapacityBytes;/** per link, during the last interval*/
+        std::vector<uint64_t> linkDeliveredBytes;/** per link, during the last interval*/
+        std::vector<uint32_t> linkQueue;/** per link, at the sample time*/
+        std::vector<uint64_t> upnodeReceivedPieces;/** per upnode, during the last interval*/
+    };
+
+    SimDownloadTask(SimEventLoop& loop, const SimScenario& scenario)
+            : m_loop(loop), m_scenario(scenario)
+    {
+    }
+
+    ~SimDownloadTask() override = default;
+
+    /// build the links and upnodes of the scenario
+    bool Init()
+    {
+        m_links.clear();
+        m_links.resize(m_scenario.links.size());
+        std::map<std::string, LinkModel*> linkByName;
+        for (size_t i = 0; i < m_scenario.links.size(); ++i)
+        {
+            const auto& linkConfig = m_scenario.links[i];
+            if (!m_links[i].Init(linkConfig, m_scenario.baseDir, m_loop.StartTime(), m_scenario.seed * 1000 + i))
+            {
+                return false;
+            }
+            linkByName[linkConfig.name] = &m_links[i];
+        }
+        for (const auto& upConfig: m_scenario.upnodes)
+        {
+            UpNode upnode;
+            upnode.id = fw::ID(upConfig.selfpeerID);
+            upnode.peerIdStr = upConfig.selfpeerID;
+            for (const auto& linkName: upConfig.path)
+            {
+                auto itor = linkByName.find(linkName);
+                if (itor == linkByName.end())
+                {
+                    SPDLOG_ERROR("upnode {} uses unknown link {}", upConfig.selfpeerID, linkName);
+                    return false;
+                }
+                upnode.path.push_back(itor->second);
+            }
+            m_upnodeIdx[upnode.id] = uint32_t(m_upnodes.size());
+            m_upnodes.push_back(upnode);
+        }
+        m_totalPieces = uint32_t((m_scenario.file_length + kPieceBytes - 1) / kPieceBytes);
+        return true;
+    }
+
+    /// create the transport controller with the factory in settings and start downloading
+    bool Start(const std::shared_ptr<TransportModuleSettings>& settings, Duration sampleInterval = Duration::Zero())
+    {
+        m_settings = settings;
+        m_controller = settings->transportCtlFactory->MakeTransportController(settings->transportCtlConfig);
+        if (!m_controller)
+        {
+            SPDLOG_ERROR("factory returns null");
+            return false;
+        }
+        TransportDownloadTaskInfo taskInfo;
+        taskInfo.m_filelength = m_scenario.file_length;
+        taskInfo.m_byterate = m_scenario.bitrate / 8;
+        m_controller->StartTransportController(taskInfo, shared_from_this());
+        for (const auto& upnode: m_upnodes)
+        {
+            m_controller->OnSessionCreate(upnode.id);
+        }
+        m_controller->OnDownloadTaskStart();
+        m_isRunning = true;
+        m_alarmInterval = Duration::FromMilliseconds(settings->GetAlarmInterval());
+        m_loop.Post([this]()
+        {
+            OnAlarm();
+        });
+        if (sampleInterval > Duration::Zero())
+        {
+            m_sampleInterval = sampleInterval;
+            m_lastSampleTime = m_loop.Now();
+            m_lastLinkDelivered.assign(m_links.size(), 0);
+            m_lastUpnodeReceived.assign(m_upnodes.size(), 0);
+            m_loop.ScheduleAfter(m_sampleInterval, [this]()
+            {
+                OnSample();
+            });
+        }
+        return true;
+    }
+
+    void Stop()
+    {
+        if (!m_isRunning)
+        {
+            return;
+        }
+        m_isRunning = false;
+        m_controller->OnDownloadTaskStop();
+    }
+
+    bool IsFinished() const
+    {
+        return m_uniqueReceived.size() >= m_totalPieces;
+    }
+
+    /////  MPDTransCtlHandler
+    bool DoSendDataRequest(const fw::ID& sessionid, const std::vector<int32_t>& datapieces) override
+    {
+        auto itor = m_upnodeIdx.find(sessionid);
+        if (!m_isRunning || itor == m_upnodeIdx.end() || datapieces.empty())
+        {
+            return false;
+        }
+        auto upIdx = itor->second;
+        auto& upnode = m_upnodes[upIdx];
+        std::vector<uint32_t> seqs;
+        for (auto piece: datapieces)
+        {
+            seqs.push_back(m_nextSeq++);
+            m_recorder.OnTx(m_loop.NowMicroseconds(), piece, seqs.back(), upIdx);
+        }
+        upnode.requestedPieces += datapieces.size();
+        // the SDK reports the request as sent from the io loop, after this call has returned
+        auto senttic = m_loop.NowMicroseconds();
+        m_loop.Post([this, sessionid, datapieces, seqs, senttic]()
+        {
+            if (m_isRunning)
+            {
+                m_controller->OnDataSent(sessionid, datapieces, seqs, senttic);
+            }
+        });
+        // the request travels the path in the reverse direction
+        Timepoint arrive = m_loop.Now();
+        for (auto link = upnode.path.rbegin(); link != upnode.path.rend(); ++link)
+        {
+            if (!(*link)->TransmitReverse(arrive, arrive))
+            {
+                ++upnode.lostRequests;
+                return true;
+            }
+        }
+        m_loop.Schedule(arrive, [this, upIdx, datapieces, seqs]()
+        {
+            OnRequestArrived(upIdx, datapieces, seqs);
+        });
+        return true;
+    }
+
+    bool DoRequestDatapiecesTask(uint32_t piecesnum) override
+    {
+        if (!m_isRunning || m_nextPiece >= m_totalPieces)
+        {
+            return false;
+        }
+        std::vector<int32_t> pieces;
+        while (pieces.size() < piecesnum && m_nextPiece < m_totalPieces)
+        {
+            pieces.push_back(int32_t(m_nextPiece++));
+        }
+        // tasks are added asynchronously by the application layer
+        m_loop.Post([this, pieces]() mutable
+        {
+            if (m_isRunning)
+            {
+                m_controller->OnPieceTaskAdding(pieces);
+            }
+        });
+        return true;
+    }
+
+    /////
+    const SimTraceRecorder& Recorder() const
+    {
+        return m_recorder;
+    }
+
+    SimScoreResult Score() const
+    {
+        return m_recorder.Score(double(m_totalPieces), m_scenario.bitrate);
+    }
+
+    const std::vector<UpNode>& UpNodes() const
+    {
+        return m_upnodes;
+    }
+
+    const std::vector<LinkModel>& Links() const
+    {
+        return m_links;
+    }
+
+    const std::vector<TimelineSample>& Timeline() const
+    {
+        return m_timeline;
+    }
+
+    std::vector<std::string> PeerIds() const
+    {
+        std::vector<std::string> ids;
+        for (const auto& upnode: m_upnodes)
+        {
+            ids.push_back(upnode.peerIdStr);
+        }
+        return ids;
+    }
+
+    uint32_t TotalPieces() const
+    {
+        return m_totalPieces;
+    }
+
+    Timepoint FinishTime() const
+    {
+        return m_finishTime;
+    }
+
+private:
+    /// the upnode answers each piece with one packet, all sent back to back
+    void OnRequestArrived(uint32_t upIdx, const std::vector<int32_t>& datapieces, const std::vector<uint32_t>& seqs)
+    {
+        for (size_t i = 0; i < datapieces.size(); ++i)
+        {
+            ForwardPiece(upIdx, seqs[i], datapieces[i], 0);
+        }
+    }
+
+    void ForwardPiece(uint32_t upIdx, uint32_t seq, int32_t piece, size_t hop)
+    {
+        const auto& path = m_upnodes[upIdx].path;
+        if (hop == path.size())
+        {
+            OnPieceArrived(upIdx, seq, piece);
+            return;
+        }
+        Timepoint exittime = Timepoint::Zero();
+        if (!path[hop]->Transmit(m_loop.Now(), kPiecePacketBytes, exittime))
+        {
+            return;
+        }
+        m_loop.Schedule(exittime, [this, upIdx, seq, piece, hop]()
+        {
+            ForwardPiece(upIdx, seq, piece, hop + 1);
+        });
+    }
+
+    void OnPieceArrived(uint32_t upIdx, uint32_t seq, int32_t piece)
+    {
+        if (!m_isRunning)
+        {
+            return;
+        }
+        auto& upnode = m_upnodes[upIdx];
+        ++upnode.receivedPieces;
+        auto tic_us = m_loop.NowMicroseconds();
+        m_recorder.OnRx(tic_us, piece, seq, upIdx);
+        m_uniqueReceived.insert(piece);
+        m_controller->OnDataPiecesReceived(upnode.id, seq, piece, tic_us);
+        if (IsFinished())
+        {
+            m_finishTime = m_loop.Now();
+            Stop();
+            m_loop.Stop();
+        }
+    }
+
+    void OnAlarm()
+    {
+        if (!m_isRunning)
+        {
+            return;
+        }
+        m_controller->OnLossDetectionAlarm();
+        m_loop.ScheduleAfter(m_alarmInterval, [this]()
+        {
+            OnAlarm();
+        });
+    }
+
+    void OnSample()
+    {
+        auto now = m_loop.Now();
+        TimelineSample sample;
+        sample.time_ms = uint64_t((now - m_loop.StartTime()).ToMilliseconds());
+        for (size_t i = 0; i < m_links.size(); ++i)
+        {
+            auto delivered = m_links[i].GetStats().deliveredBytes;
+            sample.linkCapacityBytes.push_back(
+                    m_links[i].IsRateLimited() ? m_links[i].CapacityBytes(m_lastSampleTime, now) : 0);
+            sample.linkDeliveredBytes.push_back(delivered - m_lastLinkDelivered[i]);
+            sample.linkQueue.push_back(m_links[i].QueueLength(now));
+            m_lastLinkDelivered[i] = delivered;
+        }
+        for (size_t i = 0; i < m_upnodes.size(); ++i)
+        {
+            sample.upnodeReceivedPieces.push_back(m_upnodes[i].receivedPieces - m_lastUpnodeReceived[i]);
+            m_lastUpnodeReceived[i] = m_upnodes[i].receivedPieces;
+        }
+        m_timeline.push_back(sample);
+        m_lastSampleTime = now;
+        if (m_isRunning)
+        {
+            m_loop.ScheduleAfter(m_sampleInterval, [this]()
+            {
+                OnSample();
+            });
+        }
+    }
+
+    SimEventLoop& m_loop;
+    const SimScenario& m_scenario;
+    std::shared_ptr<TransportModuleSettings> m_settings;
+    std::shared_ptr<MPDTransportController> m_controller;
+    bool m_isRunning{ false };
+    Duration m_alarmInterval{ Duration::FromMilliseconds(100) };
+
+    std::vector<LinkModel> m_links;
+    std::vector<UpNode> m_upnodes;
+    std::map<fw::ID, uint32_t> m_upnodeIdx;
+
+    uint32_t m_totalPieces{ 0 };
+    uint32_t m_nextPiece{ 0 };
+    uint32_t m_nextSeq{ 1 };
+    std::set<int32_t> m_uniqueReceived;
+    Timepoint m_finishTime{ Timepoint::Zero() };
+    SimTraceRecorder m_recorder;
+
+    Duration m_sampleInterval{ Duration::Zero() };
+    Timepoint m_lastSampleTime{ Timepoint::Zero() };
+    std::vector<uint64_t> m_lastLinkDelivered;
+    std::vector<uint64_t> m_lastUpnodeReceived;
+    std::vector<TimelineSample> m_timeline;
+};
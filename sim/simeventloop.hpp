@@ -0,0 +1,121 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "demo/utils/transporttime.h"
+
+/// Discrete event loop running in virtual time.
+/// The loop owns a SimClock and installs it as the transport module clock while Run() is executing,
+/// events scheduled at the same time point are executed in the order they were scheduled.
+class SimEventLoop
+{
+public:
+    using EventFunc = std::function<void()>;
+
+    SimEventLoop() = default;
+
+    SimEventLoop(const SimEventLoop&) = delete;
+
+    SimEventLoop& operator=(const SimEventLoop&) = delete;
+
+    Timepoint Now() const
+    {
+        return m_clock.Now();
+    }
+
+    /// the time point the loop was created, all scenario schedules are relative to it
+    Timepoint StartTime() const
+    {
+        return m_startTime;
+    }
+
+    uint64_t NowMicroseconds() const
+    {
+        return m_clock.NowMicroseconds();
+    }
+
+    /// install it with ScopedClockOverride to call into the controllers outside of Run()
+    SimClock* GetSimClock()
+    {
+        return &m_clock;
+    }
+
+    void Schedule(Timepoint attime, EventFunc func)
+    {
+        if (attime < Now())
+        {
+            attime = Now();
+        }
+        m_events.push(Event{ attime, m_nextEventId++, std::move(func) });
+    }
+
+    void ScheduleAfter(Duration delay, EventFunc func)
+    {
+        Schedule(Now() + delay, std::move(func));
+    }
+
+    /// run in the current time point after the running event
+    void Post(EventFunc func)
+    {
+        Schedule(Now(), std::move(func));
+    }
+
+    /// run events till there is nothing left, Stop() is called or the time limit is reached
+    void Run(Timepoint deadline = Timepoint::Infinite())
+    {
+        ScopedClockOverride clockOverride(&m_clock);
+        m_stopped = false;
+        while (!m_stopped && !m_events.empty())
+        {
+            if (deadline < m_events.top().attime)
+            {
+                m_clock.AdvanceTo(deadline);
+                break;
+            }
+            // std::priority_queue::top() is const, the event is copied out before pop
+            Event event = m_events.top();
+            m_events.pop();
+            m_clock.AdvanceTo(event.attime);
+            ++m_executedEvents;
+            event.func();
+        }
+    }
+
+    void Stop()
+    {
+        m_stopped = true;
+    }
+
+    uint64_t ExecutedEvents() const
+    {
+        return m_executedEvents;
+    }
+
+private:
+    struct Event
+    {
+        Timepoint attime;
+        uint64_t id;
+        EventFunc func;
+
+        bool operator>(const Event& other) const
+        {
+            if (attime == other.attime)
+            {
+                return id > other.id;
+            }
+            return attime > other.attime;
+        }
+    };
+
+    SimClock m_clock;
+    Timepoint m_startTime{ m_clock.Now() };
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_events;
+    uint64_t m_nextEventId{ 0 };
+    uint64_t m_executedEvents{ 0 };
+    bool m_stopped{ false };
+};
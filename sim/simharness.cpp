@@ -0,0 +1,191 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/// Offline download harness: replay a scenario of emulated links against DemoTransportCtl in virtual time.
+/// usage: simharness <scenario.json> [--set key=value]... [--trace MPDTrace.txt] [--timeline timeline.csv]
+///                   [--sample-ms 100] [--log off|error|warn|info|debug|trace]
+
+#include "spdlog/spdlog.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "simrunner.hpp"
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "usage: simharness <scenario.json> [--set key=value]... [--trace file] [--timeline file.csv]"
+                     " [--sample-ms ms] [--log level]" << std::endl;
+    }
+
+    bool WriteTimeline(const std::string& path, const SimRunReport& report)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            return false;
+        }
+        out << "time_ms";
+        for (const auto& name: report.linkNames)
+        {
+            out << "," << name << "_capacity_kbps," << name << "_delivered_kbps," << name << "_queue";
+        }
+        for (size_t i = 0; i < report.upnodes.size(); ++i)
+        {
+            out << ",upnode" << i << "_kbps";
+        }
+        out << "\n";
+        uint64_t lastMs = 0;
+        for (const auto& sample: report.timeline)
+        {
+            double intervalMs = double(sample.time_ms - lastMs);
+            lastMs = sample.time_ms;
+            auto toKbps = [intervalMs](uint64_t bytes)
+            {
+                return intervalMs > 0 ? bytes * 8.0 / intervalMs : 0;
+            };
+            out << sample.time_ms;
+            for (size_t i = 0; i < sample.linkCapacityBytes.size(); ++i)
+            {
+                out << "," << toKbps(sample.linkCapacityBytes[i]) << "," << toKbps(sample.linkDeliveredBytes[i])
+                    << "," << sample.linkQueue[i];
+            }
+            for (auto pieces: sample.upnodeReceivedPieces)
+            {
+                out << "," << toKbps(pieces * SimDownloadTask::kPieceBytes);
+            }
+            out << "\n";
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        PrintUsage();
+        return -1;
+    }
+    std::string scenarioPath(argv[1]);
+    std::string tracePath;
+    std::string timelinePath;
+    std::string logLevel = "off";
+    uint32_t sampleMs = 100;
+    json overrides = json::object();
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (i + 1 >= argc)
+        {
+            PrintUsage();
+            return -1;
+        }
+        std::string value(argv[++i]);
+        if (arg == "--set")
+        {
+            auto eq = value.find('=');
+            if (eq == std::string::npos)
+            {
+                PrintUsage();
+                return -1;
+            }
+            overrides[value.substr(0, eq)] = json::parse(value.substr(eq + 1));
+        }
+        else if (arg == "--trace")
+        {
+            tracePath = value;
+        }
+        else if (arg == "--timeline")
+        {
+            timelinePath = value;
+        }
+        else if (arg == "--sample-ms")
+        {
+            sampleMs = std::stoul(value);
+        }
+        else if (arg == "--log")
+        {
+            logLevel = value;
+        }
+        else
+        {
+            PrintUsage();
+            return -1;
+        }
+    }
+
+    auto logger = spdlog::stdout_color_mt("simlogger");
+    logger->set_pattern("[%H:%M:%S.%e][%l][%s:%# %!()] %v");
+    logger->set_level(spdlog::level::from_str(logLevel));
+    spdlog::set_default_logger(logger);
+
+    SimScenario scenario;
+    if (!LoadSimScenario(scenarioPath, scenario))
+    {
+        std::cerr << "Load scenario failed: " << scenarioPath << std::endl;
+        return -1;
+    }
+    auto ctlConfig = std::make_shared<DemoTransportCtlConfig>();
+    if (!ApplyTransportConfig(scenario.transport, *ctlConfig) || !ApplyTransportConfig(overrides, *ctlConfig))
+    {
+        return -1;
+    }
+
+    SimRunOptions options;
+    options.tracePath = tracePath;
+    if (!timelinePath.empty())
+    {
+        options.sampleInterval = Duration::FromMilliseconds(sampleMs);
+    }
+    auto report = RunSimScenario(scenario, ctlConfig, options);
+    if (!report.ok)
+    {
+        std::cerr << "Run scenario failed" << std::endl;
+        return -1;
+    }
+
+    printf("scenario: %s, config: %s\n", scenario.name.c_str(), ctlConfig->DebugInfo().c_str());
+    printf("finished: %d, simulated: %.3f s, wall: %.3f s, events: %llu\n", report.finished, report.simulatedSec,
+            report.wallSec, (unsigned long long) report.events);
+    for (size_t i = 0; i < report.linkNames.size(); ++i)
+    {
+        const auto& stats = report.linkStats[i];
+        printf("link %-12s delivered: %8llu random loss: %6llu queue drops: %6llu max queue: %4llu",
+                report.linkNames[i].c_str(), (unsigned long long) stats.delivered,
+                (unsigned long long) stats.randomLoss, (unsigned long long) stats.queueDrops,
+                (unsigned long long) stats.maxQueue);
+        if (report.linkUtilization[i] >= 0)
+        {
+            printf(" utilization: %.3f", report.linkUtilization[i]);
+        }
+        printf("\n");
+    }
+    for (const auto& upnode: report.upnodes)
+    {
+        printf("upnode %s requested: %llu received: %llu lost requests: %llu\n", upnode.peerIdStr.c_str(),
+                (unsigned long long) upnode.requestedPieces, (unsigned long long) upnode.receivedPieces,
+                (unsigned long long) upnode.lostRequests);
+    }
+    const auto& score = report.score;
+    printf("download duration: %.3f s, total data downloaded: %.3f MB, unique pieces: %llu\n", score.downloadSec,
+            score.downloadedMB, (unsigned long long) score.uniquePieces);
+    if (score.valid)
+    {
+        printf("alpha: %.6f, belta: %.6f, Score: %.4f KBps\n", score.alpha, score.beta, score.score);
+    }
+    else
+    {
+        printf("Score: 0 (%s)\n", score.reason.c_str());
+    }
+
+    if (!timelinePath.empty() && !WriteTimeline(timelinePath, report))
+    {
+        std::cerr << "Write timeline failed: " << timelinePath << std::endl;
+        return -1;
+    }
+    return 0;
+}
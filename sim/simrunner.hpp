@@ -0,0 +1,186 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "demo/demotransportcontroller.hpp"
+#include "scenario.hpp"
+#include "simdownloadtask.hpp"
+#include "simeventloop.hpp"
+
+/// set DemoTransportCtlConfig fields from a json object, unknown keys are rejected
+inline bool ApplyTransportConfig(const json& j, DemoTransportCtlConfig& config)
+{
+    for (auto itor = j.begin(); itor != j.end(); ++itor)
+    {
+        const auto& key = itor.key();
+        const auto& value = itor.value();
+        if (key == "period")
+        {
+            config.period = value.get<uint32_t>();
+        }
+        else if (key == "peak_gain")
+        {
+            config.peak_gain = value.get<double>();
+        }
+        else if (key == "alpha")
+        {
+            config.alpha = value.get<double>();
+        }
+        else if (key == "probe_fail_cnt")
+        {
+            config.probe_fail_cnt = value.get<uint32_t>();
+        }
+        else if (key == "max_probe_ms")
+        {
+            config.max_probe_ms = value.get<uint32_t>();
+        }
+        else if (key == "gain_down")
+        {
+            config.gain_down = value.get<double>();
+        }
+        else if (key == "gain_up")
+        {
+            config.gain_up = value.get<double>();
+        }
+        else if (key == "max_send_w")
+        {
+            config.max_send_w = value.get<uint32_t>();
+        }
+        else if (key == "botnec_ratio")
+        {
+            config.botnec_ratio = value.get<double>();
+        }
+        else if (key == "background")
+        {
+            config.background = value.get<bool>();
+        }
+        else if (key == "shared_bottleneck")
+        {
+            config.shared_bottleneck = value.get<bool>();
+        }
+        else if (key == "loss_check_ms")
+        {
+            config.loss_check_ms = value.get<uint32_t>();
+        }
+        else if (key == "pacing_gain_cycle")
+        {
+            config.pacing_gain_cycle = value.get<std::vector<double>>();
+        }
+        else if (key == "cc")
+        {
+            if (!ParseCongestionCtlType(value.get<std::string>(), config.cc_type))
+            {
+                SPDLOG_ERROR("unknown cc: {}", value.get<std::string>());
+                return false;
+            }
+        }
+        else
+        {
+            SPDLOG_ERROR("unknown transport config: {}", key);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// the fields ApplyTransportConfig() accepts
+inline json TransportConfigToJson(const DemoTransportCtlConfig& config)
+{
+    return json{{ "period",       config.period },
+                { "peak_gain",    config.peak_gain },
+                { "alpha",        config.alpha },
+                { "probe_fail_cnt", config.probe_fail_cnt },
+                { "max_probe_ms", config.max_probe_ms },
+                { "gain_down",    config.gain_down },
+                { "gain_up",      config.gain_up },
+                { "max_send_w",   config.max_send_w },
+                { "botnec_ratio", config.botnec_ratio },
+                { "cc",           CongestionCtlTypeName(config.cc_type) },
+                { "background",   config.background },
+                { "shared_bottleneck", config.shared_bottleneck },
+                { "loss_check_ms", config.loss_check_ms },
+                { "pacing_gain_cycle", config.pacing_gain_cycle }};
+}
+
+struct SimRunOptions
+{
+    Duration sampleInterval{ Duration::Zero() };/** timeline sampling, zero disables the timeline*/
+    std::string tracePath;/** write a MPDTrace style file if not empty*/
+};
+
+struct SimRunReport
+{
+    bool ok{ false };
+    bool finished{ false };/** all pieces received before the deadline*/
+    SimScoreResult score;
+    double simulatedSec{ 0 };
+    double wallSec{ 0 };
+    uint64_t events{ 0 };
+    std::vector<std::string> linkNames;
+    std::vector<LinkModel::Stats> linkStats;
+    std::vector<double> linkUtilization;/** delivered / capacity of rate limited links, -1 otherwise*/
+    std::vector<SimDownloadTask::UpNode> upnodes;
+    std::vector<SimDownloadTask::TimelineSample> timeline;
+};
+
+/// run one download of the scenario with the given controller config on the calling thread
+inline SimRunReport RunSimScenario(const SimScenario& scenario, std::shared_ptr<DemoTransportCtlConfig> ctlConfig,
+        const SimRunOptions& options = SimRunOptions())
+{
+    SimRunReport report;
+    auto wallStart = std::chrono::steady_clock::now();
+    SimEventLoop loop;
+    auto settings = std::make_shared<DemoTransportModuleSettings>();
+    settings->transportCtlConfig = ctlConfig;
+    settings->transportCtlFactory = std::make_shared<DemoTransportCtlFactory>();
+
+    auto task = std::make_shared<SimDownloadTask>(loop, scenario);
+    if (!task->Init())
+    {
+        return report;
+    }
+    Timepoint deadline = loop.StartTime() + Duration::FromMicroseconds(int64_t(scenario.MaxDurationSec() * 1e6));
+    {
+        // the controller reads the clock while it is started
+        ScopedClockOverride clockOverride(loop.GetSimClock());
+        if (!task->Start(settings, options.sampleInterval))
+        {
+            return report;
+        }
+    }
+    loop.Run(deadline);
+    {
+        ScopedClockOverride clockOverride(loop.GetSimClock());
+        task->Stop();
+    }
+
+    report.ok = true;
+    report.finished = task->IsFinished();
+    report.score = task->Score();
+    report.simulatedSec = (loop.Now() - loop.StartTime()).ToMicroseconds() / 1e6;
+    report.events = loop.ExecutedEvents();
+    for (const auto& link: task->Links())
+    {
+        report.linkNames.push_back(link.Name());
+        report.linkStats.push_back(link.GetStats());
+        double utilization = -1;
+        if (link.IsRateLimited())
+        {
+            auto capacity = link.CapacityBytes(loop.StartTime(), loop.Now());
+            utilization = capacity > 0 ? double(link.GetStats().deliveredBytes) / capacity : 0;
+        }
+        report.linkUtilization.push_back(utilization);
+    }
+    report.upnodes = task->UpNodes();
+    report.timeline = task->Timeline();
+    if (!options.tracePath.empty())
+    {
+        task->Recorder().WriteTrace(options.tracePath, task->PeerIds());
+    }
+    report.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    return report;
+}
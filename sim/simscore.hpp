@@ -0,0 +1,155 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+/// The result of tools/get_score.py, computed from the Tx/Rx records of one download
+struct SimScoreResult
+{
+    bool valid{ false };
+    std::string reason;/** why the score is 0*/
+    double downloadSec{ 0 };/** T*/
+    double downloadedMB{ 0 };/** DS, duplicates included*/
+    uint64_t uniquePieces{ 0 };/** DS_*/
+    double alpha{ 0 };
+    double beta{ 0 };
+    double score{ 0 };/** KBps*/
+};
+
+/** @brief Record every sent and received piece the way the SDK writes MPDTrace_*.txt,
+ * and compute the score with exactly the same rules as tools/get_score.py.
+ * */
+class SimTraceRecorder
+{
+public:
+    struct Record
+    {
+        bool isTx;
+        uint64_t tic_us;
+        int32_t piece;
+        uint32_t seq;
+        uint32_t upnode;
+    };
+
+    void OnTx(uint64_t tic_us, int32_t piece, uint32_t seq, uint32_t upnode)
+    {
+        m_records.push_back(Record{ true, tic_us, piece, seq, upnode });
+    }
+
+    void OnRx(uint64_t tic_us, int32_t piece, uint32_t seq, uint32_t upnode)
+    {
+        m_records.push_back(Record{ false, tic_us, piece, seq, upnode });
+    }
+
+    const std::vector<Record>& Records() const
+    {
+        return m_records;
+    }
+
+    /// write a trace in the format get_score.py parses, "peer" and "seq" are extra keys for offline analyzers
+    bool WriteTrace(const std::string& path, const std::vector<std::string>& peerIds) const
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            return false;
+        }
+        for (const auto& rec: m_records)
+        {
+            out << "{\"event\": \"" << (rec.isTx ? "Tx" : "Rx") << "\", \"timestamp\": " << rec.tic_us
+                << ", \"value\": " << rec.piece << ", \"seq\": " << rec.seq
+                << ", \"peer\": \"" << (rec.upnode < peerIds.size() ? peerIds[rec.upnode] : "") << "\"}\n";
+        }
+        return true;
+    }
+
+    /// @param filesizeKB FS in get_score.py
+    /// @param bitrate video bitrate in bps
+    SimScoreResult Score(double filesizeKB, double bitrate) const
+    {
+        SimScoreResult rt;
+        const double DT = filesizeKB * 1024 * 8 / bitrate;
+        // t_start: the first Tx record after sorting by piece number
+        int32_t minTxPiece = std::numeric_limits<int32_t>::max();
+        uint64_t t_start = 0;
+        uint64_t rxCnt = 0;
+        std::map<int32_t, uint64_t> recvTs;
+        for (const auto& rec: m_records)
+        {
+            if (rec.isTx)
+            {
+                if (rec.piece < minTxPiece)
+                {
+                    minTxPiece = rec.piece;
+                    t_start = rec.tic_us;
+                }
+                continue;
+            }
+            ++rxCnt;
+            auto itor = recvTs.find(rec.piece);
+            if (itor == recvTs.end())
+            {
+                recvTs.emplace(rec.piece, rec.tic_us);
+            }
+            else
+            {
+                itor->second = std::min(itor->second, rec.tic_us);
+            }
+        }
+        if (recvTs.empty())
+        {
+            rt.reason = "data loss";
+            return rt;
+        }
+        uint64_t tsTmp = 0;
+        for (auto& piece_ts: recvTs)
+        {
+            tsTmp = std::max(tsTmp, piece_ts.second);
+            piece_ts.second = tsTmp;
+        }
+        const double T = (double(recvTs.rbegin()->second) - double(t_start)) / 1e6;
+        rt.downloadSec = T;
+        rt.uniquePieces = recvTs.size();
+        rt.downloadedMB = rxCnt / 1024.0;
+        if (rt.uniquePieces < filesizeKB)
+        {
+            rt.reason = "not recv enough data";
+            return rt;
+        }
+        if (T > DT)
+        {
+            rt.reason = "timeout";
+            return rt;
+        }
+        double tsum = 0;
+        for (int i = 0; i < int(std::floor(DT / 10)); ++i)
+        {
+            double dataRequired = 10.0 * (i + 1) * bitrate / 8 / 1024;
+            auto pieceNum = int32_t(std::ceil(dataRequired));
+            auto itor = recvTs.find(pieceNum - 1);
+            if (pieceNum > int32_t(recvTs.size()) || itor == recvTs.end())
+            {
+                rt.reason = "not receive enough data";
+                return rt;
+            }
+            double t = (double(itor->second) - double(t_start)) / 1e6;
+            tsum += std::max(0.0, t - 10 * (i + 1));
+        }
+        rt.alpha = (rt.downloadedMB * 1024 + filesizeKB) / (2 * filesizeKB);
+        rt.beta = tsum / T;
+        rt.score = filesizeKB / ((rt.alpha + rt.beta) * T);
+        rt.valid = true;
+        return rt;
+    }
+
+private:
+    std::vector<Record> m_records;
+};
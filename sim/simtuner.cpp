@@ -0,0 +1,267 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+/// Tune DemoTransportCtlConfig on simulated downloads, using every core.
+/// usage: simtuner [--strategy grid|random|halving] [--threads n] [--samples 64] [--seeds 1] [--max-seeds 9]
+///                 [--eta 3] [--rng-seed 1] [--top 10] [--param name=v1,v2...] [--range name=min:max]
+///                 [--fix name=value]... [--out best.json] scenario.json...
+
+#include "spdlog/spdlog.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "simtuner.hpp"
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "usage: simtuner [--strategy grid|random|halving] [--threads n] [--samples n] [--seeds n]"
+                     " [--max-seeds n] [--eta n] [--rng-seed n] [--top n] [--param name=v1,v2...]"
+                     " [--range name=min:max] [--fix name=value]... [--out best.json] scenario.json..." << std::endl;
+    }
+
+    bool SplitAssign(const std::string& value, std::string& name, std::string& rest)
+    {
+        auto eq = value.find('=');
+        if (eq == std::string::npos)
+        {
+            return false;
+        }
+        name = value.substr(0, eq);
+        rest = value.substr(eq + 1);
+        return true;
+    }
+
+    TuneParam* FindParam(std::vector<TuneParam>& space, const std::string& name)
+    {
+        for (auto& param: space)
+        {
+            if (param.name == name)
+            {
+                return &param;
+            }
+        }
+        return nullptr;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string strategy = "halving";
+    size_t threads = std::thread::hardware_concurrency();
+    size_t samples = 64;
+    size_t seeds = 1;
+    size_t maxSeeds = 9;
+    size_t eta = 3;
+    uint64_t rngSeed = 1;
+    size_t top = 10;
+    std::string outPath;
+    json fixed = json::object();
+    std::vector<std::string> scenarioPaths;
+    auto space = DefaultTuneSpace();
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            scenarioPaths.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            PrintUsage();
+            return -1;
+        }
+        std::string value(argv[++i]);
+        std::string name, rest;
+        if (arg == "--strategy")
+        {
+            strategy = value;
+        }
+        else if (arg == "--threads")
+        {
+            threads = std::stoul(value);
+        }
+        else if (arg == "--samples")
+        {
+            samples = std::stoul(value);
+        }
+        else if (arg == "--seeds")
+        {
+            seeds = std::stoul(value);
+        }
+        else if (arg == "--max-seeds")
+        {
+            maxSeeds = std::stoul(value);
+        }
+        else if (arg == "--eta")
+        {
+            eta = std::stoul(value);
+        }
+        else if (arg == "--rng-seed")
+        {
+            rngSeed = std::stoull(value);
+        }
+        else if (arg == "--top")
+        {
+            top = std::stoul(value);
+        }
+        else if (arg == "--out")
+        {
+            outPath = value;
+        }
+        else if (arg == "--fix" && SplitAssign(value, name, rest))
+        {
+            // a fixed field is no longer searched
+            fixed[name] = json::parse(rest);
+            space.erase(std::remove_if(space.begin(), space.end(), [&name](const TuneParam& param)
+            {
+                return param.name == name;
+            }), space.end());
+        }
+        else if ((arg == "--param" || arg == "--range") && SplitAssign(value, name, rest))
+        {
+            auto param = FindParam(space, name);
+            if (!param)
+            {
+                space.push_back(TuneParam{ name, 0, 0, false, false, {}});
+                param = &space.back();
+            }
+            std::replace(rest.begin(), rest.end(), arg == "--param" ? ',' : ':', ' ');
+            std::istringstream in(rest);
+            if (arg == "--param")
+            {
+                param->grid.clear();
+                double v;
+                while (in >> v)
+                {
+                    param->grid.push_back(v);
+                }
+            }
+            else
+            {
+                in >> param->min >> param->max;
+            }
+        }
+        else
+        {
+            PrintUsage();
+            return -1;
+        }
+    }
+    if (scenarioPaths.empty())
+    {
+        PrintUsage();
+        return -1;
+    }
+
+    auto logger = spdlog::stdout_color_mt("tunerlogger");
+    logger->set_level(spdlog::level::off);
+    spdlog::set_default_logger(logger);
+
+    std::vector<SimScenario> scenarios;
+    for (const auto& path: scenarioPaths)
+    {
+        SimScenario scenario;
+        if (!LoadSimScenario(path, scenario))
+        {
+            std::cerr << "Load scenario failed: " << path << std::endl;
+            return -1;
+        }
+        // the scenario's own transport settings are the starting point, --fix overrides them
+        json base = scenario.transport.is_object() ? scenario.transport : json::object();
+        base.update(fixed);
+        scenario.transport = base;
+        scenarios.push_back(scenario);
+    }
+    // reject unknown keys before spending minutes on simulations
+    DemoTransportCtlConfig check;
+    for (const auto& scenario: scenarios)
+    {
+        if (!ApplyTransportConfig(scenario.transport, check))
+        {
+            return -1;
+        }
+    }
+    for (const auto& param: space)
+    {
+        if (!ApplyTransportConfig(json{{ param.name, param.integer ? json(uint32_t(param.min)) : json(param.min) }},
+                check))
+        {
+            return -1;
+        }
+    }
+
+    SimTuner tuner(scenarios, threads);
+    tuner.SetRungCallback([](size_t rungSeeds, size_t alive, double best)
+    {
+        fprintf(stderr, "rung: seeds/scenario %zu, candidates %zu, best %.2f KBps\n", rungSeeds, alive, best);
+    });
+    std::mt19937_64 rng(rngSeed);
+    auto wallStart = std::chrono::steady_clock::now();
+    std::vector<TuneCandidate> candidates;
+    if (strategy == "grid")
+    {
+        candidates = tuner.Grid(space, seeds);
+    }
+    else if (strategy == "random")
+    {
+        candidates = tuner.Random(space, samples, seeds, rng);
+    }
+    else if (strategy == "halving")
+    {
+        candidates = tuner.SuccessiveHalving(space, samples, seeds, maxSeeds, eta, rng);
+    }
+    else
+    {
+        PrintUsage();
+        return -1;
+    }
+    double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    // candidates evaluated on more seeds rank first, a lucky score on one seed should not win
+    std::sort(candidates.begin(), candidates.end(), [](const TuneCandidate& a, const TuneCandidate& b)
+    {
+        if (a.evaluatedSeeds != b.evaluatedSeeds)
+        {
+            return a.evaluatedSeeds > b.evaluatedSeeds;
+        }
+        return a.MeanScore() > b.MeanScore();
+    });
+    printf("strategy: %s, scenarios: %zu, candidates: %zu, simulations: %llu, threads: %zu, stolen: %llu,"
+           " wall: %.1f s\n", strategy.c_str(), scenarios.size(), candidates.size(),
+            (unsigned long long) tuner.Simulations(), tuner.ThreadNum(), (unsigned long long) tuner.StolenTasks(),
+            wallSec);
+    for (size_t i = 0; i < std::min(top, candidates.size()); ++i)
+    {
+        const auto& candidate = candidates[i];
+        printf("#%zu score: %.2f +- %.2f KBps, finished: %.2f, runs: %zu, %s\n", i + 1, candidate.MeanScore(),
+                candidate.StdDev(), candidate.FinishedRatio(), candidate.scores.size(), candidate.params.dump().c_str());
+    }
+    for (const auto& candidate: candidates)
+    {
+        if (candidate.params.empty())
+        {
+            printf("baseline score: %.2f KBps, runs: %zu\n", candidate.MeanScore(), candidate.scores.size());
+        }
+    }
+
+    if (!outPath.empty() && !candidates.empty())
+    {
+        DemoTransportCtlConfig best;
+        ApplyTransportConfig(scenarios.front().transport, best);
+        ApplyTransportConfig(candidates.front().params, best);
+        std::ofstream out(outPath);
+        out << TransportConfigToJson(best).dump(4) << std::endl;
+        if (!out)
+        {
+            std::cerr << "Write result failed: " << outPath << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
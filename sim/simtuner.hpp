@@ -0,0 +1,297 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "simrunner.hpp"
+#include "workstealingpool.hpp"
+
+/// One tunable DemoTransportCtlConfig field, the name is the key used by ApplyTransportConfig()
+struct TuneParam
+{
+    std::string name;
+    double min;
+    double max;
+    bool integer;
+    bool logScale;/** sample uniformly in log space*/
+    std::vector<double> grid;/** values tried by the grid strategy*/
+
+    double Sample(std::mt19937_64& rng) const
+    {
+        double value;
+        if (logScale && min > 0)
+        {
+            std::uniform_real_distribution<double> dist(std::log(min), std::log(max));
+            value = std::exp(dist(rng));
+        }
+        else
+        {
+            std::uniform_real_distribution<double> dist(min, max);
+            value = dist(rng);
+        }
+        return integer ? std::round(value) : value;
+    }
+};
+
+/// the controller constants worth tuning, with their current values inside the ranges
+inline std::vector<TuneParam> DefaultTuneSpace()
+{
+    return {
+            { "period",       2,    8,    true,  false, { 2, 3, 4, 6, 8 }},
+            { "alpha",        0.02, 0.5,  false, true,  { 0.05, 0.1, 0.2 }},
+            { "probe_fail_cnt", 1,  8,    true,  false, { 2, 3, 5 }},
+            { "max_probe_ms", 200,  3000, true,  true,  { 250, 500, 1000, 2000 }},
+            { "gain_down",    0.6,  0.98, false, false, { 0.8, 0.9, 0.95 }},
+            { "gain_up",      1.01, 1.5,  false, false, { 1.05, 1.1, 1.25 }},
+            { "max_send_w",   2,    32,   true,  true,  { 4, 8, 16 }},
+            { "botnec_ratio", 0.5,  0.98, false, false, { 0.7, 0.85, 0.95 }},
+    };
+}
+
+/// one point of the search space and what it scored so far
+struct TuneCandidate
+{
+    json params;
+    std::vector<double> scores;/** one per evaluated (scenario, seed), in evaluation order*/
+    std::vector<bool> finished;
+    size_t evaluatedSeeds{ 0 };
+
+    double MeanScore() const
+    {
+        if (scores.empty())
+        {
+            return 0;
+        }
+        double sum = 0;
+        for (auto score: scores)
+        {
+            sum += score;
+        }
+        return sum / scores.size();
+    }
+
+    double StdDev() const
+    {
+        if (scores.size() < 2)
+        {
+            return 0;
+        }
+        double mean = MeanScore();
+        double sum = 0;
+        for (auto score: scores)
+        {
+            sum += (score - mean) * (score - mean);
+        }
+        return std::sqrt(sum / (scores.size() - 1));
+    }
+
+    double FinishedRatio() const
+    {
+        if (finished.empty())
+        {
+            return 0;
+        }
+        return double(std::count(finished.begin(), finished.end(), true)) / finished.size();
+    }
+};
+
+/** @brief Evaluate candidate configs on a set of scenarios, every (config, scenario, seed) simulation is one task
+ *  on a WorkStealingPool. A run that does not finish or has an invalid score counts as 0, like get_score.py.
+ * */
+class SimTuner
+{
+public:
+    SimTuner(std::vector<SimScenario> scenarios, size_t threadNum)
+            : m_scenarios(std::move(scenarios)), m_pool(threadNum)
+    {
+    }
+
+    size_t ThreadNum() const
+    {
+        return m_pool.ThreadNum();
+    }
+
+    uint64_t Simulations() const
+    {
+        return m_simulations;
+    }
+
+    uint64_t StolenTasks() const
+    {
+        return m_pool.StolenTasks();
+    }
+
+    /// called after each successive halving rung with the seeds per scenario, candidates left and best score
+    void SetRungCallback(std::function<void(size_t, size_t, double)> callback)
+    {
+        m_rungCallback = std::move(callback);
+    }
+
+    /// run seeds [evaluatedSeeds, seeds) of every scenario for every candidate
+    void Evaluate(std::vector<TuneCandidate*>& candidates, size_t seeds)
+    {
+        std::mutex resultMutex;
+        for (auto candidate: candidates)
+        {
+            for (size_t seed = candidate->evaluatedSeeds; seed < seeds; ++seed)
+            {
+                for (size_t i = 0; i < m_scenarios.size(); ++i)
+                {
+                    m_pool.Submit([this, candidate, seed, i, &resultMutex]()
+                    {
+                        SimScenario scenario = m_scenarios[i];
+                        scenario.seed += seed;
+                        // the scenario's transport settings first, then the candidate's
+                        auto config = std::make_shared<DemoTransportCtlConfig>();
+                        double score = 0;
+                        SimRunReport report;
+                        if (ApplyTransportConfig(scenario.transport, *config)
+                            && ApplyTransportConfig(candidate->params, *config))
+                        {
+                            report = RunSimScenario(scenario, config);
+                            score = report.ok && report.finished && report.score.valid ? report.score.score : 0;
+                        }
+                        std::lock_guard<std::mutex> lock(resultMutex);
+                        candidate->scores.push_back(score);
+                        candidate->finished.push_back(report.finished);
+                        ++m_simulations;
+                    });
+                }
+            }
+        }
+        m_pool.Wait();
+        for (auto candidate: candidates)
+        {
+            candidate->evaluatedSeeds = std::max(candidate->evaluatedSeeds, seeds);
+        }
+    }
+
+    /// every combination of the grid values
+    std::vector<TuneCandidate> Grid(const std::vector<TuneParam>& space, size_t seeds)
+    {
+        std::vector<TuneCandidate> candidates(1);
+        candidates[0].params = json::object();
+        for (const auto& param: space)
+        {
+            std::vector<TuneCandidate> expanded;
+            for (const auto& candidate: candidates)
+            {
+                for (auto value: param.grid)
+                {
+                    expanded.push_back(candidate);
+                    SetParam(expanded.back().params, param, value);
+                }
+            }
+            candidates.swap(expanded);
+        }
+        EvaluateAll(candidates, seeds);
+        return candidates;
+    }
+
+    /// the default config plus samples uniformly drawn from the ranges
+    std::vector<TuneCandidate> Random(const std::vector<TuneParam>& space, size_t samples, size_t seeds,
+            std::mt19937_64& rng)
+    {
+        auto candidates = SampleCandidates(space, samples, rng);
+        EvaluateAll(candidates, seeds);
+        return candidates;
+    }
+
+    /** Successive halving: evaluate all samples on minSeeds seeds per scenario, keep the best 1/eta,
+     *  multiply the seeds by eta and repeat until one candidate is left or maxSeeds is reached.
+     *  Dropped candidates keep the scores of the rung they were dropped at.
+     * */
+    std::vector<TuneCandidate> SuccessiveHalving(const std::vector<TuneParam>& space, size_t samples,
+            size_t minSeeds, size_t maxSeeds, size_t eta, std::mt19937_64& rng)
+    {
+        eta = std::max<size_t>(eta, 2);
+        auto candidates = SampleCandidates(space, samples, rng);
+        std::vector<TuneCandidate*> alive;
+        for (auto& candidate: candidates)
+        {
+            alive.push_back(&candidate);
+        }
+        size_t seeds = std::max<size_t>(minSeeds, 1);
+        while (true)
+        {
+            Evaluate(alive, seeds);
+            if (m_rungCallback)
+            {
+                m_rungCallback(seeds, alive.size(), (*std::max_element(alive.begin(), alive.end(), ByScore()))->MeanScore());
+            }
+            if (alive.size() <= 1 || seeds >= maxSeeds)
+            {
+                break;
+            }
+            std::sort(alive.begin(), alive.end(), [](const TuneCandidate* a, const TuneCandidate* b)
+            {
+                return a->MeanScore() > b->MeanScore();
+            });
+            alive.resize(std::max<size_t>(alive.size() / eta, 1));
+            seeds = std::min(seeds * eta, maxSeeds);
+        }
+        return candidates;
+    }
+
+private:
+    struct ByScore
+    {
+        bool operator()(const TuneCandidate* a, const TuneCandidate* b) const
+        {
+            return a->MeanScore() < b->MeanScore();
+        }
+    };
+
+    static void SetParam(json& params, const TuneParam& param, double value)
+    {
+        if (param.integer)
+        {
+            params[param.name] = uint32_t(std::llround(value));
+        }
+        else
+        {
+            params[param.name] = value;
+        }
+    }
+
+    std::vector<TuneCandidate> SampleCandidates(const std::vector<TuneParam>& space, size_t samples,
+            std::mt19937_64& rng)
+    {
+        // the untouched config is always a candidate, so the report shows what tuning gains
+        std::vector<TuneCandidate> candidates(1);
+        candidates[0].params = json::object();
+        for (size_t i = 0; i < samples; ++i)
+        {
+            TuneCandidate candidate;
+            candidate.params = json::object();
+            for (const auto& param: space)
+            {
+                SetParam(candidate.params, param, param.Sample(rng));
+            }
+            candidates.push_back(candidate);
+        }
+        return candidates;
+    }
+
+    void EvaluateAll(std::vector<TuneCandidate>& candidates, size_t seeds)
+    {
+        std::vector<TuneCandidate*> all;
+        for (auto& candidate: candidates)
+        {
+            all.push_back(&candidate);
+        }
+        Evaluate(all, seeds);
+    }
+
+    std::vector<SimScenario> m_scenarios;
+    WorkStealingPool m_pool;
+    uint64_t m_simulations{ 0 };
+    std::function<void(size_t, size_t, double)> m_rungCallback;
+};
@@ -0,0 +1,185 @@
+// Copyright (c) 2023. ByteDance Inc. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** @brief Fixed size thread pool where every worker owns a task deque.
+ *  A worker pops its own deque from the back and, when it runs dry, steals from the front of the others,
+ *  so long simulations submitted in one batch still spread evenly across the cores.
+ *  Tasks submitted from a worker go to that worker's deque, others are dealt round robin.
+ * */
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(size_t threadNum = std::thread::hardware_concurrency())
+    {
+        threadNum = std::max<size_t>(threadNum, 1);
+        for (size_t i = 0; i < threadNum; ++i)
+        {
+            m_queues.emplace_back(new WorkQueue());
+        }
+        for (size_t i = 0; i < threadNum; ++i)
+        {
+            m_threads.emplace_back([this, i]()
+            {
+                WorkerLoop(i);
+            });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wakeup.notify_all();
+        for (auto& thread: m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    size_t ThreadNum() const
+    {
+        return m_threads.size();
+    }
+
+    void Submit(Task task)
+    {
+        size_t idx = WorkerIndex() == kNotWorker ? m_nextQueue++ % m_queues.size() : WorkerIndex();
+        {
+            // count first, a worker may pick the task up as soon as it is in the deque
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_pending;
+            ++m_queued;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_queues[idx]->mutex);
+            m_queues[idx]->tasks.push_back(std::move(task));
+        }
+        m_wakeup.notify_one();
+    }
+
+    /// block until every submitted task has finished, must not be called from a worker
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]()
+        {
+            return m_pending == 0;
+        });
+    }
+
+    uint64_t StolenTasks() const
+    {
+        return m_stolen;
+    }
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static constexpr size_t kNotWorker = size_t(-1);
+
+    static size_t& WorkerIndex()
+    {
+        static thread_local size_t idx = kNotWorker;
+        return idx;
+    }
+
+    bool PopLocal(size_t idx, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(m_queues[idx]->mutex);
+        if (m_queues[idx]->tasks.empty())
+        {
+            return false;
+        }
+        task = std::move(m_queues[idx]->tasks.back());
+        m_queues[idx]->tasks.pop_back();
+        return true;
+    }
+
+    bool Steal(size_t idx, Task& task)
+    {
+        for (size_t i = 1; i < m_queues.size(); ++i)
+        {
+            auto& victim = *m_queues[(idx + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                ++m_stolen;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkerLoop(size_t idx)
+    {
+        WorkerIndex() = idx;
+        while (true)
+        {
+            Task task;
+            if (PopLocal(idx, task) || Steal(idx, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    --m_queued;
+                }
+                task();
+                bool allDone;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    allDone = --m_pending == 0;
+                }
+                if (allDone)
+                {
+                    m_idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [this]()
+            {
+                return m_stopping || m_queued > 0;
+            });
+            if (m_stopping && m_queued == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_nextQueue{ 0 };
+    std::atomic<uint64_t> m_stolen{ 0 };
+
+    std::mutex m_mutex;/** guards the counters below*/
+    std::condition_variable m_wakeup;
+    std::condition_variable m_idle;
+    size_t m_pending{ 0 };/** submitted but not finished*/
+    size_t m_queued{ 0 };/** submitted but not started*/
+    bool m_stopping{ false };
+};
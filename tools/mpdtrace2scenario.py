@@ -0,0 +1,360 @@
+"""Infer a link model from an MPDTrace_*.txt capture and write a scenario for sim/simharness.
+
+usage: python mpdtrace2scenario.py MPDTrace.txt -o scenario.json [--bitrate 1048576] [--window 2.0]
+
+Every path (the "peer" key of a record, or the whole download if the trace has none) becomes one upnode
+behind one emulated link:
+  base RTT      the 2nd percentile of request -> piece delays
+  bottleneck    pieces of one request leave the upnode back to back, so their arrival spacing is the
+                serialization time at the bottleneck; the rate is the median over those pairs, never below
+                the best windowed goodput
+  queue depth   the 95th percentile of queueing delay (RTT - base RTT) times the goodput of its window,
+                in packets
+  loss          requested pieces never received on that path, minus the ones explained by queue overflow
+                (lost in a run of consecutive losses, or while the queueing delay was above half of its
+                maximum), split between both directions
+  bw_schedule   the bottleneck rate per window, when it moves by more than 20%
+Paths whose queueing delays rise and fall together share a bottleneck: they get one "sharedN" link with
+the rate, queue and schedule, and keep their own link for delay and loss only.
+The inferred values and a Gilbert-Elliott fit of the loss runs are kept under "inferred" for reference.
+"""
+import argparse
+import bisect
+import json
+import math
+import os
+import re
+import sys
+from collections import defaultdict
+
+PIECE_PACKET_BYTES = 1024 + 76  # SimDownloadTask::kPiecePacketBytes
+PIECE_BYTES = 1024
+BURST_GAP_US = 200  # requests sent within this gap are one burst, like OursCongestionControl assumes
+QDELAY_BIN_US = 100000  # queueing delay series resolution for shared bottleneck detection
+SHARED_CORRELATION = 0.6
+
+
+def load_records(path):
+    pair = re.compile(r"([{].*?[}])")
+    records = []
+    with open(path) as file:
+        for line in file:
+            found = pair.search(line)
+            if found is None:
+                continue
+            try:
+                rec = json.loads(found.group(0))
+            except ValueError:
+                continue
+            if rec.get('event') in ('Tx', 'Rx') and 'timestamp' in rec and 'value' in rec:
+                records.append(rec)
+    records.sort(key=lambda r: r['timestamp'])
+    return records
+
+
+def percentile(values, q):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    idx = min(len(values) - 1, max(0, int(math.ceil(q / 100.0 * len(values))) - 1))
+    return values[idx]
+
+
+def median(values):
+    return percentile(values, 50)
+
+
+def match_samples(txs, rxs):
+    """Pair every Rx with its Tx: by seq when the trace has it, else with the latest Tx of the same piece.
+    Returns the samples [(tx_us, rx_us)] and the Tx records that were never answered."""
+    samples = []
+    answered = set()
+    if txs and all('seq' in t for t in txs) and all('seq' in r for r in rxs):
+        by_seq = {t['seq']: i for i, t in enumerate(txs)}
+        for rx in rxs:
+            i = by_seq.get(rx['seq'])
+            if i is not None and i not in answered:
+                answered.add(i)
+                samples.append((txs[i]['timestamp'], rx['timestamp']))
+    else:
+        by_piece = defaultdict(list)
+        for i, tx in enumerate(txs):
+            by_piece[tx['value']].append(i)
+        for rx in rxs:
+            candidates = [i for i in by_piece[rx['value']]
+                          if i not in answered and txs[i]['timestamp'] <= rx['timestamp']]
+            if candidates:
+                i = candidates[-1]
+                answered.add(i)
+                samples.append((txs[i]['timestamp'], rx['timestamp']))
+    lost = [tx for i, tx in enumerate(txs) if i not in answered]
+    return samples, lost
+
+
+def dispersion_rates(samples):
+    """pieces/s from the arrival spacing of pieces requested in the same burst"""
+    rates = []
+    by_burst = defaultdict(list)
+    burst_start = None
+    for tx, rx in sorted(samples):
+        if burst_start is None or tx - burst_start > BURST_GAP_US:
+            burst_start = tx
+        by_burst[burst_start].append(rx)
+    for arrivals in by_burst.values():
+        arrivals.sort()
+        for a, b in zip(arrivals, arrivals[1:]):
+            if b > a:
+                rates.append((a, 1e6 / (b - a)))
+    return rates
+
+
+def windowed_goodput(rx_times, window_us):
+    """pieces/s per window, keyed by the window start"""
+    counts = defaultdict(int)
+    for t in rx_times:
+        counts[t // window_us] += 1
+    return {k * window_us: c * 1e6 / window_us for k, c in counts.items()}
+
+
+def gilbert_elliott(lost_flags):
+    """p: good->bad, r: bad->good, from the loss runs in send order"""
+    good_to_bad = good = bad_to_good = bad = 0
+    for prev, cur in zip(lost_flags, lost_flags[1:]):
+        if prev:
+            bad += 1
+            bad_to_good += not cur
+        else:
+            good += 1
+            good_to_bad += cur
+    p = good_to_bad / good if good else 0.0
+    r = bad_to_good / bad if bad else 1.0
+    return p, r
+
+
+def infer_path(txs, rxs, window_us, trace_start, trace_end):
+    samples, lost = match_samples(txs, rxs)
+    # a request still in flight when the capture stops is not a loss
+    rtts = [rx - tx for tx, rx in samples]
+    if not rtts:
+        return None
+    base_rtt = percentile(rtts, 2)
+    lost = [tx for tx in lost if tx['timestamp'] + 4 * base_rtt < trace_end]
+
+    rates = dispersion_rates(samples)
+    goodput = windowed_goodput([rx for _, rx in samples], window_us)
+    best_goodput = max(goodput.values()) if goodput else 0.0
+    rate = max(median([r for _, r in rates]) if rates else 0.0, best_goodput)
+
+    max_qdelay = max(percentile(rtts, 99) - base_rtt, 0)
+    # the rate of the window the sample arrived in, a queue drained at 2 Mbps is not as deep as at 10 Mbps
+    queued = [(rx - tx - base_rtt) * min(goodput.get(rx // window_us * window_us, rate), rate) / 1e6
+              for tx, rx in samples]
+    queue_pkts = int(math.ceil(percentile(queued, 95)))
+
+    # a drop-tail queue loses the tail of a burst, so losses in a run, or while the queue was more than half
+    # full, are queue overflow that the emulated queue reproduces; isolated losses are random
+    lost_ids = set(id(tx) for tx in lost)
+    lost_flags = [id(tx) in lost_ids for tx in txs]
+    in_run = set()
+    for i, flag in enumerate(lost_flags):
+        if flag and ((i > 0 and lost_flags[i - 1]) or (i + 1 < len(txs) and lost_flags[i + 1])):
+            in_run.add(id(txs[i]))
+    rtt_at = sorted(samples)
+    sent_at = [t for t, _ in rtt_at]
+    congestive = 0
+    for tx in lost:
+        if id(tx) in in_run:
+            congestive += 1
+            continue
+        lo = bisect.bisect_left(sent_at, tx['timestamp'] - base_rtt)
+        hi = bisect.bisect_right(sent_at, tx['timestamp'] + base_rtt)
+        nearby = [rx - t for t, rx in rtt_at[lo:hi]]
+        if nearby and max(nearby) - base_rtt > max_qdelay / 2:
+            congestive += 1
+    random_loss = (len(lost) - congestive) / len(txs) if txs else 0.0
+    # the emulator drops in both directions, a lost request also loses its pieces
+    loss_per_direction = 1 - math.sqrt(max(0.0, 1 - random_loss))
+
+    ge_p, ge_r = gilbert_elliott(lost_flags)
+
+    qdelay_bins = defaultdict(list)
+    for tx, rx in samples:
+        qdelay_bins[rx // QDELAY_BIN_US].append(rx - tx - base_rtt)
+
+    serialization_us = 1e6 / rate if rate > 0 else 0
+    delay_ms = max(base_rtt - serialization_us, 0) / 2 / 1000
+
+    schedule = []
+    last = rate
+    by_window = defaultdict(list)
+    for t, r in rates:
+        by_window[t // window_us].append(r)
+    for k in sorted(by_window):
+        window_rate = max(median(by_window[k]), goodput.get(k * window_us, 0))
+        if abs(window_rate - last) > 0.2 * last:
+            schedule.append([max(k * window_us - trace_start, 0) / 1000.0, window_rate])
+            last = window_rate
+
+    def mbps(pieces_per_sec):
+        return round(pieces_per_sec * PIECE_PACKET_BYTES * 8 / 1e6, 3)
+
+    return {
+        'link': {
+            'bw': mbps(rate),
+            'delay': round(delay_ms, 3),
+            'loss': round(loss_per_direction * 100, 3),
+            'max_queue_size': max(queue_pkts, 10),
+            'bw_schedule': [[round(t, 1), mbps(r)] for t, r in schedule],
+        },
+        'rate': rate,
+        'goodput': goodput,
+        'qdelay': {k: sum(v) / len(v) for k, v in qdelay_bins.items()},
+        'inferred': {
+            'requested': len(txs),
+            'received': len(samples),
+            'lost': len(lost),
+            'congestive_loss': congestive,
+            'base_rtt_ms': round(base_rtt / 1000, 3),
+            'p99_rtt_ms': round(percentile(rtts, 99) / 1000, 3),
+            'dispersion_pairs': len(rates),
+            'best_goodput_mbps': mbps(best_goodput),
+            'gilbert_elliott': {'p': round(ge_p, 5), 'r': round(ge_r, 5)},
+        },
+    }
+
+
+def correlation(a, b):
+    """Pearson correlation of two {bin: value} series over their common bins"""
+    common = sorted(set(a) & set(b))
+    if len(common) < 20:
+        return 0.0
+    xs = [a[k] for k in common]
+    ys = [b[k] for k in common]
+    mx = sum(xs) / len(xs)
+    my = sum(ys) / len(ys)
+    cov = sum((x - mx) * (y - my) for x, y in zip(xs, ys))
+    vx = sum((x - mx) ** 2 for x in xs)
+    vy = sum((y - my) ** 2 for y in ys)
+    return cov / math.sqrt(vx * vy) if vx > 0 and vy > 0 else 0.0
+
+
+def shared_bottlenecks(paths):
+    """group the paths whose queueing delay series are correlated, union-find over all pairs"""
+    parent = list(range(len(paths)))
+
+    def find(i):
+        while parent[i] != i:
+            parent[i] = parent[parent[i]]
+            i = parent[i]
+        return i
+
+    for i in range(len(paths)):
+        for j in range(i + 1, len(paths)):
+            if correlation(paths[i]['qdelay'], paths[j]['qdelay']) > SHARED_CORRELATION:
+                parent[find(j)] = find(i)
+    groups = defaultdict(list)
+    for i in range(len(paths)):
+        groups[find(i)].append(i)
+    return [g for g in groups.values() if len(g) > 1]
+
+
+def make_peer_id(peer, idx):
+    if isinstance(peer, str) and len(peer) == 40:
+        return peer
+    return '00010203040506070809101112131415161718{:02X}'.format(idx)
+
+
+def build_scenario(records, name, bitrate, window_us):
+    by_peer_tx = defaultdict(list)
+    by_peer_rx = defaultdict(list)
+    for rec in records:
+        (by_peer_tx if rec['event'] == 'Tx' else by_peer_rx)[rec.get('peer', '')].append(rec)
+    trace_start = records[0]['timestamp']
+    trace_end = records[-1]['timestamp']
+    unique_pieces = len(set(r['value'] for r in records if r['event'] == 'Rx'))
+    scenario = {
+        'name': name,
+        'seed': 1,
+        'file_length': max(unique_pieces, 1) * PIECE_BYTES,
+        'bitrate': bitrate,
+        'links': [{'name': 'client', 'bw': 1000, 'delay': 0, 'max_queue_size': 1000}],
+        'upnodes': [],
+        'inferred': {},
+    }
+    if '' in by_peer_tx and len(by_peer_tx) == 1:
+        print('trace has no "peer" key, all sessions are modelled as one path', file=sys.stderr)
+    paths = []
+    for idx, peer in enumerate(sorted(by_peer_tx)):
+        path = infer_path(by_peer_tx[peer], by_peer_rx.get(peer, []), window_us, trace_start, trace_end)
+        peer_id = make_peer_id(peer, idx)
+        if path is None:
+            print('peer {} never answered, skipped'.format(peer_id), file=sys.stderr)
+            continue
+        path['link'] = dict(name='path{}'.format(idx), **path['link'])
+        path['peer_id'] = peer_id
+        path['route'] = [path['link']['name'], 'client']
+        paths.append(path)
+
+    shared_links = []
+    for group in shared_bottlenecks(paths):
+        # the paths see the same queue, the fastest one measured the link best; their goodputs add up
+        fastest = max((paths[i] for i in group), key=lambda p: p['rate'])
+        windows = set(k for i in group for k in paths[i]['goodput'])
+        aggregate = max(sum(paths[i]['goodput'].get(k, 0) for i in group) for k in windows)
+        shared = dict(fastest['link'], name='shared{}'.format(len(shared_links)), delay=0, loss=0)
+        shared['bw'] = max(shared['bw'], round(aggregate * PIECE_PACKET_BYTES * 8 / 1e6, 3))
+        shared_links.append(shared)
+        for i in group:
+            link = paths[i]['link']
+            link.update(bw=1000, max_queue_size=1000, bw_schedule=[])
+            paths[i]['route'] = [link['name'], shared['name'], 'client']
+            paths[i]['inferred']['shared_bottleneck'] = shared['name']
+        print('{} share a bottleneck'.format(', '.join(paths[i]['peer_id'] for i in group)), file=sys.stderr)
+
+    for link in [p['link'] for p in paths] + shared_links:
+        if not link['bw_schedule']:
+            del link['bw_schedule']
+        scenario['links'].append(link)
+    for path in paths:
+        scenario['upnodes'].append({'selfpeerID': path['peer_id'], 'path': path['route']})
+        scenario['inferred'][path['peer_id']] = path['inferred']
+    return scenario
+
+
+def main():
+    parser = argparse.ArgumentParser(description='infer a sim/ scenario from an MPDTrace capture')
+    parser.add_argument('trace')
+    parser.add_argument('-o', '--output', help='scenario file, stdout if omitted')
+    parser.add_argument('--name', help='scenario name, defaults to the trace file name')
+    parser.add_argument('--bitrate', type=int, default=1024 * 1024, help='video bitrate in bps')
+    parser.add_argument('--window', type=float, default=2.0, help='bw_schedule window in seconds')
+    args = parser.parse_args()
+
+    records = load_records(args.trace)
+    if not records:
+        print('no Tx/Rx record in {}'.format(args.trace), file=sys.stderr)
+        return 1
+    name = args.name or os.path.splitext(os.path.basename(args.trace))[0]
+    scenario = build_scenario(records, name, args.bitrate, int(args.window * 1e6))
+    if not scenario['upnodes']:
+        print('no path could be inferred', file=sys.stderr)
+        return 1
+    text = json.dumps(scenario, indent=4)
+    if args.output:
+        with open(args.output, 'w') as file:
+            file.write(text + '\n')
+    else:
+        print(text)
+    links = {link['name']: link for link in scenario['links']}
+    for upnode in scenario['upnodes']:
+        info = scenario['inferred'][upnode['selfpeerID']]
+        own = links[upnode['path'][0]]
+        bottleneck = links[upnode['path'][-2]]
+        print('{}: base rtt {} ms, bottleneck {} {} Mbps, queue {}, loss {}%, lost {}/{}'.format(
+            upnode['selfpeerID'], info['base_rtt_ms'], bottleneck['name'], bottleneck['bw'],
+            bottleneck['max_queue_size'], own['loss'], info['lost'], info['requested']), file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())